@@ -35,6 +35,20 @@
 
 #define FUSION_MODE   0x0C // NDOF?
 
+// Serial link, must match the protocol param of serial_driver
+// Binary frames: 0xAA 0x55 | length | sequence | payload | CRC-16/CCITT-FALSE (LSB first) over length, sequence and payload
+#define BINARY_PROTOCOL 1
+#define FRAME_SYNC_1  0xAA
+#define FRAME_SYNC_2  0x55
+#define DATA_LENGTH   13
+
+#if BINARY_PROTOCOL
+#define SERIAL_BAUD   115200
+#define LOOP_PERIOD_US 10000 // Must match the arduino_period param of serial_driver
+#else
+#define SERIAL_BAUD   9600
+#endif
+
 // Globally Store Detected Colours
 int colours[4];
 
@@ -42,7 +56,11 @@ int colours[4];
 // 8 for LSB and MSB of Orientation Quaternion x,y,z and w
 // 2 for LSB and MSB of Linear Acceleration in x
 // 2 for LSB And MSB of Gyro in Z
-byte data[13];
+byte data[DATA_LENGTH];
+
+// Counts sample periods, so the Pi can count dropped frames and work out when each frame was sampled
+byte frame_seq = 0;
+unsigned long next_loop_us;
 
 void setup() 
 {
@@ -61,7 +79,7 @@ void setup()
   digitalWrite(S0,HIGH);
   digitalWrite(S1,LOW);
   
-  Serial.begin(9600);
+  Serial.begin(SERIAL_BAUD);
   Wire.begin(0x07); //Set Arduino up as an I2C slave at address 0x07
   Wire.onRequest(requestEvent); //Prepare to send data
   Wire.onReceive(receiveEvent); //Prepare to recieve data
@@ -70,10 +88,19 @@ void setup()
   delay(20);
   config_BNO055();
   delay(20);
+  next_loop_us = micros();
 }
 
 void loop()
 {  
+#if BINARY_PROTOCOL
+  // Sample at a fixed period. Periods missed by an overrun still advance the sequence number
+  while ((long)(micros() - next_loop_us) < 0);
+  unsigned long missed = (micros() - next_loop_us) / LOOP_PERIOD_US;
+  frame_seq += missed;
+  next_loop_us += (missed + 1) * LOOP_PERIOD_US;
+#endif
+
   // Request the IMU to write the orientation registers
   Wire.beginTransmission(ADDRESS);  
   Wire.write(ORIENTATION);
@@ -121,12 +148,45 @@ void loop()
   
   data[12] = readFlameSensor() ^ readColourSensor();
 
-  for (int i = 0; i < 13; ++i)
+#if BINARY_PROTOCOL
+  sendFrame();
+#else
+  for (int i = 0; i < DATA_LENGTH; ++i)
   {
     Serial.print(data[i]);
     Serial.print(" ");
   }
   Serial.println();
+#endif
+}
+
+uint16_t crc16(const byte* buf, int len, uint16_t crc)
+{
+  for (int i = 0; i < len; ++i)
+  {
+    crc ^= (uint16_t)buf[i] << 8;
+    for (int bit = 0; bit < 8; ++bit)
+    {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+void sendFrame()
+{
+  byte frame[DATA_LENGTH + 6];
+  frame[0] = FRAME_SYNC_1;
+  frame[1] = FRAME_SYNC_2;
+  frame[2] = DATA_LENGTH;
+  frame[3] = frame_seq++;
+  memcpy(&frame[4], data, DATA_LENGTH);
+
+  uint16_t crc = crc16(&frame[2], DATA_LENGTH + 2, 0xFFFF);
+  frame[DATA_LENGTH + 4] = crc & 0xFF;
+  frame[DATA_LENGTH + 5] = crc >> 8;
+
+  Serial.write(frame, sizeof(frame));
 }
 
 void requestEvent()
@@ -147,8 +207,10 @@ void receiveEvent(int numBytes)
     receive_int = c << (8 * count) | receive_int;
     count++;
   }
+#if !BINARY_PROTOCOL
   Serial.print("Received Number: ");
   Serial.println(receive_int);
+#endif
 }
 
 byte readFlameSensor()
@@ -180,7 +242,6 @@ byte readFlameSensor()
   {
     returnVal = returnVal ^ 0x20;
   }
-  Serial.println("");
   
   return returnVal;
 }
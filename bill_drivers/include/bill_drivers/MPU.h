@@ -24,6 +24,8 @@
 
 #include <stdint.h>
 
+#include "imu_batch.hpp"
+
 // One ifdef needed to support delay() cross-platform
 #if defined(ARDUINO)
 #include <Arduino.h>
@@ -81,6 +83,19 @@ class MPUIMU {
 
         void readAccelerometer(float & ax, float & ay, float & az);
 
+        // FIFO streaming: the chip queues every sample at the full rate and readBatch() drains them all in a few
+        // bulk reads, instead of one register read per axis per sample. Returns false, leaving the FIFO off, when
+        // readMPURegisters() can't burst read FIFO_R_W
+        virtual bool startStreaming(void);
+
+        virtual void stopStreaming(void);
+
+        // Decodes every complete packet in the FIFO, nowNs is the CLOCK_MONOTONIC time of the call.
+        // Returns the sample count, 0 after an overflow, which drops the FIFO and starts again
+        int readBatch(ImuSampleBatch & batch, uint64_t nowNs);
+
+        uint32_t fifoOverflows(void);
+
     protected:
 
         const uint8_t MPU_ADDRESS               = 0x68;
@@ -234,4 +249,32 @@ class MPUIMU {
 
         static float getRes(uint8_t scale, float vals[4]);
 
+        static const uint16_t MAX_FIFO_SIZE     = 1024;
+        static const uint8_t  FIFO_ACCEL_GYRO   = 0x78;
+        static const uint8_t  FIFO_SLV0         = 0x01;
+        static const uint8_t  FIFO_IMU_BYTES    = 12;
+
+        // Starts queueing accel, gyro and the given slave sources, with slaveBytes of slave data after each sample
+        void startFifo(uint8_t slaveSources, uint8_t slaveBytes, uint8_t userCtrl);
+
+        // Bytes the FIFO holds, once full the chip overwrites the oldest. 512 on the MPU6500 and MPU9250
+        virtual uint16_t fifoSize(void) { return 512; }
+
+        // Whether readMPURegisters() pops count bytes from FIFO_R_W rather than reading the registers after it
+        virtual bool burstReadsFifo(void) { return true; }
+
+        // Decodes the slave data that follows the gyro in one packet into sample i of the batch
+        virtual void decodeFifoSlaves(const uint8_t * data, ImuSampleBatch & batch, int i) { (void)data; (void)batch; (void)i; }
+
+    private:
+
+        uint8_t  _fifoPacketBytes = 0;
+        uint8_t  _fifoUserCtrl = 0;
+        uint64_t _samplePeriodNs = 0;
+        uint64_t _nextSampleNs = 0;
+        uint32_t _fifoOverflows = 0;
+        uint8_t  _fifoData[MAX_FIFO_SIZE];
+
+        void resetFifo(void);
+
 }; // class MPU
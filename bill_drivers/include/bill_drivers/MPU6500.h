@@ -44,4 +44,6 @@ class MPU6500 : public MPU6x00 {
         static const uint8_t SELF_TEST_Z_GYRO  = 0x02;
 
         virtual void readMPURegisters(uint8_t subAddress, uint8_t count, uint8_t * dest) override;
+
+        virtual uint16_t fifoSize(void) override { return 512; }
 }; 
@@ -33,4 +33,7 @@ class MPU6x00 : public MPU6xx0 {
         Error_t begin(void);
 
         virtual void writeMPURegister(uint8_t subAddress, uint8_t data) override;
+
+        // The MPU6000 has twice the MPU6500's FIFO
+        virtual uint16_t fifoSize(void) override { return 1024; }
 }; 
@@ -63,6 +63,12 @@ class MPU9250 : public MPUIMU {
 
         float readTemperature(void);
 
+        // Also queues the magnetometer, read by the MPU's own I2C master after every sample. Bypass is off while
+        // streaming, so the AK8963 can't be reached directly until stopStreaming()
+        virtual bool startStreaming(void) override;
+
+        virtual void stopStreaming(void) override;
+
     protected:
 
         MPU9250(Ascale_t ascale, Gscale_t gscale, Mscale_t mscale, Mmode_t mmode, uint8_t sampleRateDivisor, bool passthru);
@@ -124,6 +130,8 @@ class MPU9250 : public MPUIMU {
         virtual void writeRegister(uint8_t address, uint8_t subAddress, uint8_t data) = 0;
         virtual void readRegisters(uint8_t address, uint8_t subAddress, uint8_t count, uint8_t * dest) = 0;
 
+        virtual void decodeFifoSlaves(const uint8_t * data, ImuSampleBatch & batch, int i) override;
+
     private:
 
         bool    selfTest(void);
@@ -133,10 +141,14 @@ class MPU9250 : public MPUIMU {
         void    reset(void);
         void    readMagData(int16_t * destination);
         void    initAK8963(Mscale_t mscale, Mmode_t Mmode, float * magCalibration);
+        void    scaleMagnetometer(const int16_t * magCount, float & mx, float & my, float & mz);
 
 
         // These can be overridden by calibrateMagnetometer()
         float _magBias[3] = {0,0,0};
         float _magScale[3] = {1,1,1};
 
+        // Last reading without the overflow bit set, repeated in streamed samples that have it
+        float _streamMag[3] = {0,0,0};
+
 }; // class MPU9250
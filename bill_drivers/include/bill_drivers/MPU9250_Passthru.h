@@ -40,6 +40,8 @@ class MPU9250_Passthru : public MPU9250 {
 
         virtual void readMPURegisters(uint8_t subAddress, uint8_t count, uint8_t * dest) override;
 
+        virtual bool burstReadsFifo(void) override;
+
         virtual void writeRegister(uint8_t address, uint8_t subAddress, uint8_t data) override;
 
         virtual void readRegisters(uint8_t address, uint8_t subAddress, uint8_t count, uint8_t * dest) override;
@@ -0,0 +1,121 @@
+#ifndef ARDUINO_PROTOCOL_HPP
+#define ARDUINO_PROTOCOL_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Binary frame sent by bill_arduino.ino when BINARY_PROTOCOL is enabled:
+//   0xAA 0x55 | length | sequence | payload[length] | crc16 low | crc16 high
+// The crc is CRC-16/CCITT-FALSE over the length, sequence and payload bytes
+const uint8_t FRAME_SYNC_1 = 0xAA;
+const uint8_t FRAME_SYNC_2 = 0x55;
+const int FRAME_MAX_PAYLOAD = 32;
+const int ARDUINO_PAYLOAD_LENGTH = 13;  // Quaternion w,x,y,z, x accel, z gyro (LSB first) and the detection byte
+
+enum ArduinoProtocol
+{
+    PROTOCOL_TEXT,
+    PROTOCOL_BINARY
+};
+
+const int TEXT_BAUD = 9600;
+const int BINARY_BAUD = 115200;
+
+uint16_t crc16Ccitt(const uint8_t* data, size_t length, uint16_t crc = 0xFFFF);
+
+struct ArduinoPacket
+{
+    uint8_t data[ARDUINO_PAYLOAD_LENGTH];
+    uint8_t seq;
+    uint16_t length;  // Bytes the frame took on the wire, used to work out when it started arriving
+};
+
+// Byte at a time state machine over a fixed buffer, nothing is allocated while parsing.
+// Gaps in the sequence counter are counted as dropped frames
+class BinaryFrameParser
+{
+public:
+    BinaryFrameParser();
+    bool push(uint8_t byte, ArduinoPacket& packet);
+    void reset();
+    uint32_t frames() const;
+    uint32_t crcErrors() const;
+    uint32_t droppedFrames() const;
+
+private:
+    enum State
+    {
+        WAIT_SYNC_1,
+        WAIT_SYNC_2,
+        READ_LENGTH,
+        READ_SEQ,
+        READ_PAYLOAD,
+        READ_CRC_LOW,
+        READ_CRC_HIGH
+    };
+
+    bool completeFrame(ArduinoPacket& packet);
+
+    State _state;
+    uint8_t _buffer[FRAME_MAX_PAYLOAD + 2];  // Length and sequence bytes followed by the payload
+    uint8_t _index;
+    uint16_t _rx_crc;
+    bool _have_seq;
+    uint8_t _last_seq;
+    uint32_t _frames;
+    uint32_t _crc_errors;
+    uint32_t _dropped_frames;
+};
+
+// Space separated decimal bytes terminated by \r\n, the original 9600 baud protocol.
+// A malformed token or an overlong line doesn't lose the frame, the last ARDUINO_PAYLOAD_LENGTH valid tokens before
+// the line end are used. Lines with fewer valid tokens are discarded
+class TextFrameParser
+{
+public:
+    TextFrameParser();
+    bool push(uint8_t byte, ArduinoPacket& packet);
+    void reset();
+    uint32_t frames() const;
+    uint32_t resyncs() const;
+    uint32_t discardedLines() const;
+
+private:
+    void endToken();
+    bool endLine(ArduinoPacket& packet);
+
+    uint8_t _tokens[ARDUINO_PAYLOAD_LENGTH];  // Ring of the most recent valid tokens on this line
+    uint32_t _token_count;
+    uint16_t _line_bytes;
+    int _value;
+    int _digits;
+    bool _skip_token;
+    bool _resynced;
+    uint32_t _frames;
+    uint32_t _resyncs;
+    uint32_t _discarded_lines;
+};
+
+// Incremental parser for either protocol. Chunks can split frames anywhere, the bytes are parsed in place
+class ArduinoFrameParser
+{
+public:
+    explicit ArduinoFrameParser(ArduinoProtocol protocol);
+
+    // Consumes bytes until a packet completes or the chunk runs out and returns the number of bytes consumed,
+    // complete is set when packet holds a new frame. Call again with the rest of the chunk
+    size_t parse(const uint8_t* data, size_t length, ArduinoPacket& packet, bool& complete);
+    void reset();
+
+    ArduinoProtocol protocol() const;
+    uint32_t frames() const;
+    uint32_t droppedFrames() const;  // Sequence gaps for binary, discarded lines for text
+    uint32_t errors() const;         // Crc errors for binary, resyncs for text
+
+private:
+    ArduinoProtocol _protocol;
+    BinaryFrameParser _binary;
+    TextFrameParser _text;
+};
+
+#endif
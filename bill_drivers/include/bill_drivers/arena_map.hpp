@@ -0,0 +1,67 @@
+#ifndef ARENA_MAP_HPP
+#define ARENA_MAP_HPP
+
+#include "ros/ros.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+const int ARENA_HEADINGS = 4;  // 0, 90, 180 and 270 degrees, in that order
+
+struct HomeTile
+{
+    int x;
+    int y;
+    int heading;  // Degrees the robot has to start at on this tile
+};
+
+// Tile grid of the course. Connectivity is one byte per tile with a bit for each heading that can be driven out of
+// it, so a 30x30 arena is under 1 kB and stays in cache while planning. Loaded from rosparams, see
+// config/arena_6x6.yaml for the format
+class ArenaMap
+{
+public:
+    // An open grid with only the outer walls
+    ArenaMap(int width = 6, int height = 6, float tile_size = 0.3);
+
+    bool load(const ros::NodeHandle& nh, const std::string& ns = "/arena");
+
+    int width() const;
+    int height() const;
+    int tiles() const;
+    float tileSize() const;      // m
+    float courseWidth() const;   // m between the walls along x
+    float courseHeight() const;  // m between the walls along y
+    const std::vector<HomeTile>& homeTiles() const;
+
+    bool contains(int x, int y) const;
+    int index(int x, int y) const;
+    int tileX(int tile) const;
+    int tileY(int tile) const;
+
+    // The tile next to this one along the heading ignoring walls, -1 off the grid
+    int adjacent(int tile, int heading) const;
+    // As adjacent, but -1 if a wall is in the way
+    int neighbour(int tile, int heading) const;
+    // Heading from a tile to an adjacent one, -1 if they aren't adjacent
+    int headingBetween(int src, int dest) const;
+    bool isOpen(int tile, int heading) const;
+    uint8_t openSides(int tile) const;
+
+    // Opens or closes the edge in both directions
+    void setOpen(int tile, int heading, bool open);
+    void blockTile(int tile);
+
+private:
+    void reset();
+
+    int _width;
+    int _height;
+    float _tile_size;
+    float _course_width;
+    float _course_height;
+    std::vector<uint8_t> _open_sides;
+    std::vector<HomeTile> _home_tiles;
+};
+
+#endif
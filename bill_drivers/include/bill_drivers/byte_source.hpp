@@ -0,0 +1,72 @@
+#ifndef BYTE_SOURCE_HPP
+#define BYTE_SOURCE_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <string>
+
+namespace serial
+{
+class Serial;
+}
+
+// Source of raw bytes from the Arduino link.
+// read blocks for up to timeout_ms and returns the number of bytes read, 0 on timeout and -1 once the source is
+// exhausted or has failed
+class ByteSource
+{
+public:
+    virtual ~ByteSource() {}
+    virtual bool open() = 0;
+    virtual int read(uint8_t* buffer, size_t size, int timeout_ms) = 0;
+};
+
+// The Arduino's usb serial port
+class SerialByteSource : public ByteSource
+{
+public:
+    SerialByteSource(const std::string& port, int baud);
+    ~SerialByteSource();
+    bool open();
+    int read(uint8_t* buffer, size_t size, int timeout_ms);
+
+private:
+    std::string _port;
+    int _baud;
+    int _timeout_ms;
+    std::unique_ptr<serial::Serial> _serial;
+};
+
+// Any readable path, a recording of the link or an existing tty. Ttys are switched to raw mode
+class FdByteSource : public ByteSource
+{
+public:
+    explicit FdByteSource(const std::string& path);
+    ~FdByteSource();
+    bool open();
+    int read(uint8_t* buffer, size_t size, int timeout_ms);
+
+protected:
+    FdByteSource();
+    void close();
+
+    std::string _path;
+    int _fd;
+};
+
+// Creates a pseudo-terminal and reads what is written to its slave side, so recordings or a simulator can be fed
+// through the same code path as the real port, e.g. cat recording > $(slave name)
+class PtyByteSource : public FdByteSource
+{
+public:
+    PtyByteSource();
+    ~PtyByteSource();
+    bool open();
+    const std::string& slaveName() const;
+
+private:
+    int _slave_fd;
+};
+
+#endif
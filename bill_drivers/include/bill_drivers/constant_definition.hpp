@@ -5,6 +5,7 @@
 const int LED_PIN = 19;
 const int BUTTON_PIN = 6;
 const int RELAY_OUTPIN = 26;
+const int MPU_INT_PIN = 24;     // MPU9250 INT, pulses when a sample is ready
 
 // Motors
 const int MOTORA_PWM = 12;      // PWMA
@@ -0,0 +1,29 @@
+#ifndef DRIVER_NODES_HPP
+#define DRIVER_NODES_HPP
+
+#include "ros/ros.h"
+
+// These drivers can run as their own processes or be loaded together into one nodelet manager, where messages
+// published as shared pointers are passed between them without serialization.
+// start sets up publishers, subscribers, timers and threads on the given handles and returns without blocking.
+// stop joins any threads started by start
+
+namespace encoder_driver
+{
+bool start(ros::NodeHandle& nh, ros::NodeHandle& private_nh);
+void stop();
+}
+
+namespace serial_driver
+{
+bool start(ros::NodeHandle& nh, ros::NodeHandle& private_nh);
+void stop();
+}
+
+namespace localization_node
+{
+bool start(ros::NodeHandle& nh, ros::NodeHandle& private_nh);
+void stop();
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef EKF_HPP
+#define EKF_HPP
+
+// Extended Kalman filter over the planar pose [x, y, theta].
+// Odometry increments drive the prediction. Every measurement observes a single state directly, so updates are scalar
+// and need no matrix inverse. Measurements whose normalized innovation squared exceeds the gate are rejected
+class PoseEkf
+{
+public:
+    static const int N = 3;
+    enum State
+    {
+        X = 0,
+        Y = 1,
+        THETA = 2
+    };
+
+    PoseEkf();
+    void reset(double x, double y, double theta, double var_xy, double var_theta);
+
+    // Moves distance along the mean heading of the step and turns by delta_theta
+    void predict(double distance, double delta_theta, double var_distance, double var_theta);
+
+    bool updatePosition(State axis, double z, double variance, double gate);
+    bool updateHeading(double theta, double variance, double gate);
+
+    double x() const;
+    double y() const;
+    double theta() const;
+    double covariance(int row, int col) const;
+
+private:
+    bool update(int index, double innovation, double variance, double gate);
+
+    double _state[N];
+    double _P[N][N];
+};
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef ENCODER_SOURCE_HPP
+#define ENCODER_SOURCE_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include "bill_drivers/gpio_event.hpp"
+
+// Motor A drives the right wheel, motor B the left
+enum EncoderChannel
+{
+    ENCODER_RIGHT = 0,
+    ENCODER_LEFT = 1,
+    ENCODER_CHANNELS = 2
+};
+
+struct EncoderEdge
+{
+    int channel;
+    uint64_t timestamp_ns;
+    bool rising;
+};
+
+// Source of timestamped encoder A channel edges.
+// waitForEdge blocks until an edge is available, it returns false on timeout or once the source is exhausted
+class EncoderSource
+{
+public:
+    virtual ~EncoderSource() {}
+    virtual bool start() = 0;
+    virtual bool waitForEdge(EncoderEdge& edge, int timeout_ms) = 0;
+    // Current time on the clock the edges are stamped with
+    virtual uint64_t nowNs() const
+    {
+        return monotonicNs();
+    }
+    virtual bool finished() const
+    {
+        return false;
+    }
+};
+
+// Blocks on gpio edge interrupts of both encoder lines, no cpu is used while the wheels are stopped
+class GpioEventEncoderSource : public EncoderSource
+{
+public:
+    GpioEventEncoderSource(int right_pin, int left_pin, const std::string& chip = DEFAULT_GPIO_CHIP);
+    bool start();
+    bool waitForEdge(EncoderEdge& edge, int timeout_ms);
+    uint64_t nowNs() const;
+
+private:
+    GpioEventLine _lines[ENCODER_CHANNELS];
+    int _pins[ENCODER_CHANNELS];
+    std::string _chip;
+    int _next_channel;
+};
+
+// Replays edges recorded by EncoderRecorder, one "timestamp_ns channel rising" triple per line.
+// In realtime mode the original spacing between edges is reproduced, otherwise edges are returned back to back
+class ReplayEncoderSource : public EncoderSource
+{
+public:
+    ReplayEncoderSource(const std::string& path, bool realtime = true);
+    ~ReplayEncoderSource();
+    bool start();
+    bool waitForEdge(EncoderEdge& edge, int timeout_ms);
+    bool finished() const;
+
+private:
+    bool readNext();
+
+    std::string _path;
+    bool _realtime;
+    bool _finished;
+    bool _has_pending;
+    FILE* _file;
+    EncoderEdge _pending;
+    uint64_t _first_edge_ns;
+    uint64_t _start_ns;
+};
+
+// Writes edges in the format read by ReplayEncoderSource
+class EncoderRecorder
+{
+public:
+    EncoderRecorder();
+    ~EncoderRecorder();
+    bool open(const std::string& path);
+    void record(const EncoderEdge& edge);
+
+private:
+    FILE* _file;
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef GPIO_EVENT_HPP
+#define GPIO_EVENT_HPP
+
+#include <stdint.h>
+#include <string>
+#include <time.h>
+
+const std::string DEFAULT_GPIO_CHIP = "/dev/gpiochip0";
+
+// Current CLOCK_MONOTONIC time
+uint64_t monotonicNs();
+uint64_t clockNs(clockid_t clock);
+
+// The clock the kernel stamps gpio edges with. The v1 line event API stamps with CLOCK_REALTIME before 5.7 and
+// CLOCK_MONOTONIC from then on, with no way to ask for either, so it is told from the running kernel's version
+clockid_t gpioEdgeClock();
+
+enum GpioEdgeRequest
+{
+    GPIO_EDGE_BOTH = 0,
+    GPIO_EDGE_RISING = 1,
+    GPIO_EDGE_FALLING = 2
+};
+
+struct GpioEdge
+{
+    uint64_t timestamp_ns;  // Kernel timestamp of the interrupt, on gpioEdgeClock()
+    bool rising;
+};
+
+// Single input line requested from the linux gpio character device with edge events enabled.
+// The kernel queues and timestamps every edge, so callers can block on fd() instead of polling the pin.
+// Line offsets on the Pi's gpiochip0 match the BCM numbers used by wiringPiSetupGpio()
+class GpioEventLine
+{
+public:
+    GpioEventLine();
+    ~GpioEventLine();
+    bool open(int line, const std::string& consumer, const std::string& chip = DEFAULT_GPIO_CHIP,
+              GpioEdgeRequest edges = GPIO_EDGE_BOTH);
+    void close();
+    bool isOpen() const;
+    int fd() const;
+    int line() const;
+    int value() const;
+    bool readEdge(GpioEdge& edge);
+    bool waitForEdge(GpioEdge& edge, int timeout_ms);
+    // Current time on the clock the edges are stamped with, for measuring their age
+    uint64_t nowNs() const;
+
+private:
+    GpioEventLine(const GpioEventLine&);
+    GpioEventLine& operator=(const GpioEventLine&);
+
+    int _fd;
+    int _line;
+    clockid_t _clock;
+};
+
+#endif
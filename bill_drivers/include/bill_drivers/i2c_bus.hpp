@@ -0,0 +1,25 @@
+#ifndef I2C_BUS_HPP
+#define I2C_BUS_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+// What the cpi2c_ backends offer beyond the CrossPlatformI2C API. CMake picks the backend with I2C_BACKEND
+
+// Bus transactions since startup or the last reset. A transaction runs from a start to a stop, so a register read with
+// a repeated start is one however many bytes it returns
+uint32_t cpi2c_transactions();
+void cpi2c_resetTransactions();
+
+// True when cpi2c_readRegisters() reads every byte in one transaction, so a FIFO register pops count bytes. WiringPi
+// reads one register per byte at subAddress + i, which walks past a FIFO register instead
+bool cpi2c_burstReads();
+
+// Mock backend only. Each device address has a register file that reads and writes auto increment through, except
+// registers set up as FIFOs, which pop a byte per read like the MPU's FIFO_R_W
+void cpi2c_mockWrite(uint8_t address, uint8_t subAddress, const uint8_t* data, size_t count);
+void cpi2c_mockRead(uint8_t address, uint8_t subAddress, uint8_t* data, size_t count);
+void cpi2c_mockPushFifo(uint8_t address, uint8_t subAddress, const uint8_t* data, size_t count);
+void cpi2c_mockReset();
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef IMU_BATCH_HPP
+#define IMU_BATCH_HPP
+
+#include <stdint.h>
+
+// Samples drained from the IMU's FIFO in one go. One array per axis so a filter over an axis walks contiguous memory,
+// and sized for a full FIFO up front so draining never allocates
+struct ImuSampleBatch
+{
+    // The MPU6000's 1024 byte FIFO of 12 byte accel and gyro packets, the largest FIFO and smallest packet streamed
+    static const int CAPACITY = 85;
+
+    int count = 0;
+    bool has_mag = false;                 // Only the MPU9250 queues its magnetometer behind the gyro
+    uint64_t timestamp_ns[CAPACITY];      // CLOCK_MONOTONIC, reconstructed from the sample rate
+    float ax[CAPACITY];                   // g
+    float ay[CAPACITY];
+    float az[CAPACITY];
+    float gx[CAPACITY];                   // degrees per second
+    float gy[CAPACITY];
+    float gz[CAPACITY];
+    float mx[CAPACITY];                   // milligauss
+    float my[CAPACITY];
+    float mz[CAPACITY];
+};
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef MAGNET_DETECTOR_HPP
+#define MAGNET_DETECTOR_HPP
+
+#include <stddef.h>
+#include <vector>
+
+// Decides whether the magnet is under the robot from a stream of field magnitudes. The level is the median of a short
+// sliding window, so a lone outlier however large can't move it, and is compared against a slow estimate of the
+// ambient field, which the motors and the arena shift by hundreds of mG. The magnet has to raise the field by rise to
+// be detected and is released once it drops back below release, so it doesn't chatter when the sensor sits near the
+// edge of the magnet
+class MagnetDetector
+{
+public:
+    MagnetDetector(float sample_rate, float rise, float release);
+    // Returns true when the state changed
+    bool update(float magnitude);
+    bool present() const;
+    float level() const;
+    float baseline() const;
+    void reset();
+
+private:
+    std::vector<float> _window;
+    std::vector<float> _sorted;
+    size_t _next;
+    size_t _filled;
+    float _level;
+    float _baseline;
+    float _baseline_alpha;
+    bool _has_baseline;
+    float _rise;
+    float _release;
+    bool _present;
+};
+
+#endif
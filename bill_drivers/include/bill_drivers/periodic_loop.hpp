@@ -0,0 +1,40 @@
+#ifndef PERIODIC_LOOP_HPP
+#define PERIODIC_LOOP_HPP
+
+#include <stdint.h>
+#include <time.h>
+#include "bill_drivers/seqlock.hpp"
+
+struct LoopStats
+{
+    uint64_t cycles;
+    uint64_t overruns;          // Wakeups a whole period late, the missed cycles are skipped rather than run back to back
+    uint64_t max_late_ns;
+    double mean_late_ns;
+    double period_jitter_ns;    // Standard deviation of the time between wakeups
+};
+
+// Paces a thread at a fixed rate. Deadlines are absolute CLOCK_MONOTONIC times, so time spent in the loop body
+// doesn't push the next cycle back the way a relative sleep would. Stats can be read from any thread
+class PeriodicLoop
+{
+public:
+    explicit PeriodicLoop(double rate_hz);
+    // Called from the loop's own thread, 0 leaves it on the normal scheduler
+    bool setRealtimePriority(int priority);
+    // Sleeps until the next deadline, returns the seconds since the last wakeup
+    float wait();
+    uint64_t periodNs() const;
+    LoopStats stats() const;
+
+private:
+    uint64_t _period_ns;
+    struct timespec _deadline;
+    uint64_t _last_wake_ns;
+    double _period_mean_ns;
+    double _period_m2;
+    LoopStats _stats;
+    SeqLock<LoopStats> _published;
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef PWM_OUTPUT_HPP
+#define PWM_OUTPUT_HPP
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+const std::string DEFAULT_PWM_CHIP = "/sys/class/pwm/pwmchip0";
+
+// One PWM pin. Duty runs from 0 to 1, a backend rounds it to whatever resolution it has
+class PwmOutput
+{
+public:
+    PwmOutput() : _duty(0) {}
+    virtual ~PwmOutput() {}
+    virtual bool start() = 0;
+    virtual void write(float duty) = 0;
+    float duty() const
+    {
+        return _duty;
+    }
+
+protected:
+    float _duty;
+};
+
+// The BCM PWM peripheral through the kernel's pwm class, enabled with dtoverlay=pwm,pin=12,func=4.
+// Driven entirely in hardware at any frequency with nanosecond duty resolution, no thread or cpu involved
+class SysfsPwmOutput : public PwmOutput
+{
+public:
+    SysfsPwmOutput(int pin, float frequency, const std::string& chip = DEFAULT_PWM_CHIP);
+    ~SysfsPwmOutput();
+    bool start();
+    void write(float duty);
+    // PWM channel the BCM pin can be muxed to, -1 if it has none
+    static int channelForPin(int pin);
+
+private:
+    bool writeAttribute(const std::string& name, uint64_t value);
+
+    int _pin;
+    int _channel;
+    uint64_t _period_ns;
+    uint64_t _duty_ns;
+    std::string _chip;
+    std::string _dir;
+    int _duty_fd;
+};
+
+// WiringPi's softPwm, for pins without a hardware channel. Costs a realtime thread per pin and runs at
+// 10 kHz / range, 100 Hz at a range of 100
+class SoftPwmOutput : public PwmOutput
+{
+public:
+    SoftPwmOutput(int pin, int range);
+    bool start();
+    void write(float duty);
+
+private:
+    int _pin;
+    int _range;
+    int _value;
+};
+
+// Only remembers the duty, for running the motor driver without motors
+class SimPwmOutput : public PwmOutput
+{
+public:
+    bool start();
+    void write(float duty);
+};
+
+// "auto" resolves to sysfs only when every pin has a hardware channel and to soft otherwise, so outputs driven as a
+// set never mix hardware and softPwm frequencies. Other backends are returned as they are
+std::string resolvePwmBackend(const std::string& backend, const std::vector<int>& pins);
+
+// "sysfs", "soft" or "sim". "auto" is resolved for the one pin
+PwmOutput* createPwmOutput(const std::string& backend, int pin, float frequency, int soft_range);
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef SEQLOCK_HPP
+#define SEQLOCK_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <type_traits>
+
+// Sequence lock around a small plain struct. One writer at a time stores whole values, any number of readers load a
+// copy that is never torn and never block the writer. A reader that overlaps a store just copies again.
+// The value is held as relaxed atomic words so the copies racing with a store are still well defined
+template <typename T>
+class SeqLock
+{
+public:
+    SeqLock()
+    {
+        _seq.store(0);
+        store(T());
+    }
+
+    // Writer side, callers serialize their stores if there is more than one writer thread
+    void store(const T& value)
+    {
+        uint32_t words[WORDS] = {};
+        memcpy(words, &value, sizeof(T));
+
+        uint32_t seq = _seq.load(std::memory_order_relaxed);
+        _seq.store(seq + 1, std::memory_order_relaxed);  // Odd while the words are changing
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WORDS; i++)
+        {
+            _words[i].store(words[i], std::memory_order_relaxed);
+        }
+        _seq.store(seq + 2, std::memory_order_release);
+    }
+
+    // Any thread
+    T load() const
+    {
+        uint32_t words[WORDS];
+        uint32_t before;
+        uint32_t after;
+        do
+        {
+            before = _seq.load(std::memory_order_acquire);
+            for (size_t i = 0; i < WORDS; i++)
+            {
+                words[i] = _words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = _seq.load(std::memory_order_relaxed);
+        } while ((before & 1) != 0 || before != after);
+
+        T value;
+        memcpy(&value, words, sizeof(T));
+        return value;
+    }
+
+    // Goes up by two with every store
+    uint32_t sequence() const
+    {
+        return _seq.load(std::memory_order_acquire);
+    }
+
+private:
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock values are copied as raw words");
+    static const size_t WORDS = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+    std::atomic<uint32_t> _seq;
+    std::atomic<uint32_t> _words[WORDS];
+};
+
+#endif
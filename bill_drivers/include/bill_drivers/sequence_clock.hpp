@@ -0,0 +1,44 @@
+#ifndef SEQUENCE_CLOCK_HPP
+#define SEQUENCE_CLOCK_HPP
+
+#include <stdint.h>
+
+// Estimates when a periodic sender sampled each frame from its 8 bit sequence number and the frame arrival times.
+// Frame k is sampled at offset + k * period on our clock. The period is fitted by least squares over a window of
+// recent frames, and the offset is the minimum of (arrival - k * period) over that window, since transport delays can
+// only make a frame late. The estimator restarts when the sender goes quiet long enough to make the sequence ambiguous
+class SequenceClock
+{
+public:
+    static const int WINDOW = 256;
+    static const int MIN_SAMPLES = 32;
+
+    explicit SequenceClock(double nominal_period);
+
+    // Adds a frame and returns its estimated sample time, or the arrival time itself until the estimate has converged
+    double update(uint8_t seq, double arrival);
+    void reset();
+
+    bool converged() const;
+    double period() const;
+    double offset() const;
+
+private:
+    void fit();
+
+    double _nominal_period;
+    double _period;
+    double _offset;
+    bool _have_seq;
+    uint8_t _last_seq;
+    int64_t _index;
+    double _last_arrival;
+    double _epoch;  // First arrival, keeps the fitted values small
+
+    int64_t _indices[WINDOW];
+    double _arrivals[WINDOW];
+    int _count;
+    int _next;
+};
+
+#endif
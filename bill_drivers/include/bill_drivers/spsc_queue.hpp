@@ -0,0 +1,60 @@
+#ifndef SPSC_QUEUE_HPP
+#define SPSC_QUEUE_HPP
+
+#include <stddef.h>
+#include <atomic>
+
+// Bounded lock-free queue between exactly one producer thread and one consumer thread.
+// CAPACITY must be a power of two. Neither side ever blocks, push fails when full and pop fails when empty
+template <typename T, size_t CAPACITY>
+class SpscQueue
+{
+public:
+    SpscQueue()
+    {
+        _head.store(0);
+        _tail.store(0);
+    }
+
+    // Producer side
+    bool push(const T& item)
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head.load(std::memory_order_acquire) == CAPACITY)
+        {
+            return false;
+        }
+        _items[tail & (CAPACITY - 1)] = item;
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side
+    bool pop(T& item)
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        item = _items[head & (CAPACITY - 1)];
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Any thread, only a snapshot
+    size_t size() const
+    {
+        return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+    }
+
+private:
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+    // Keep the indices on separate cache lines so the two threads don't invalidate each other on every operation
+    alignas(64) std::atomic<size_t> _head;
+    alignas(64) std::atomic<size_t> _tail;
+    alignas(64) T _items[CAPACITY];
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+// Latency tracing across nodes. Every sensor sample gets a trace id that is copied into the messages derived from it
+// (Position, MotorCommands and Ranges carry a trace_id field, for standard messages the header stamp in ns is used).
+// Each thread records events into its own fixed buffer without locking, and traceDump writes them as a Chrome trace
+// (chrome://tracing or ui.perfetto.dev). Timestamps are CLOCK_MONOTONIC so files from different nodes line up:
+//   jq -s '{traceEvents: map(.traceEvents) | add}' /tmp/trace/*.json > trace.json
+// Names must be string literals, only the pointer is stored. Recording is a single branch while tracing is off
+
+const size_t TRACE_DEFAULT_EVENTS_PER_THREAD = 1 << 16;
+
+enum TracePhase
+{
+    TRACE_BEGIN = 'B',
+    TRACE_END = 'E',
+    TRACE_INSTANT = 'i',
+    TRACE_FLOW_START = 's',  // Message published
+    TRACE_FLOW_END = 'f'     // Message received
+};
+
+// Starts tracing this process into <directory>/<process_name>.json. Only the first call has an effect, so nodelets
+// sharing a manager can all call it
+bool traceOpen(const std::string& directory, const std::string& process_name,
+               size_t events_per_thread = TRACE_DEFAULT_EVENTS_PER_THREAD);
+// Writes everything recorded so far, can be called again later to rewrite the file with more events
+bool traceDump();
+bool traceEnabled();
+
+uint64_t traceNowNs();
+uint64_t traceNewId();
+
+// timestamp_ns of 0 means now. Events past a thread's buffer capacity are dropped and counted
+void traceRecord(TracePhase phase, const char* name, uint64_t id, uint64_t timestamp_ns = 0);
+
+inline void tracePublish(const char* topic, uint64_t id)
+{
+    traceRecord(TRACE_FLOW_START, topic, id);
+}
+
+inline void traceReceive(const char* topic, uint64_t id)
+{
+    traceRecord(TRACE_FLOW_END, topic, id);
+}
+
+// Records a slice for the lifetime of the scope. Publishes and receives inside it are drawn as arrows to and from it
+class TraceScope
+{
+public:
+    TraceScope(const char* name, uint64_t id);
+    ~TraceScope();
+
+private:
+    const char* _name;
+    uint64_t _id;
+};
+
+#endif
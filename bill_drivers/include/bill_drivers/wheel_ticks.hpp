@@ -0,0 +1,40 @@
+#ifndef WHEEL_TICKS_HPP
+#define WHEEL_TICKS_HPP
+
+#include <stdint.h>
+#include <atomic>
+
+// Tick accumulator for one wheel, shared between the edge thread (single writer) and the odometry loop (single reader).
+// The writer never blocks, the reader takes deltas by remembering the last count instead of zeroing the counter
+class WheelTicks
+{
+public:
+    static const uint32_t HISTORY = 256;  // Must be a power of two
+
+    WheelTicks();
+
+    // Writer side
+    void addEdge(uint64_t timestamp_ns);
+
+    // Any thread
+    void setDirection(int direction);
+    int getDirection() const;
+    int32_t count() const;
+    uint64_t lastEdgeNs() const;  // 0 before the first edge
+
+    // Reader side
+    int32_t takeDelta();
+    // now_ns has to be on the clock the edges were stamped with
+    float ticksPerSecond(uint64_t now_ns, uint64_t window_ns) const;
+
+private:
+    uint32_t recentEdges(uint64_t* stamps, uint32_t max_edges) const;
+
+    std::atomic<int32_t> _count;
+    std::atomic<int> _direction;
+    std::atomic<uint32_t> _head;
+    std::atomic<uint64_t> _stamps[HISTORY];
+    int32_t _count_prev;
+};
+
+#endif
@@ -0,0 +1,123 @@
+#include "bill_drivers/CrossPlatformI2C.h"
+#include "bill_drivers/i2c_bus.hpp"
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+
+// cpi2c_ backend on the kernel's i2c-dev interface. Each read is a single I2C_RDWR transfer, the register address
+// write and the data read joined by a repeated start, so a burst costs one transaction instead of one per byte
+
+static const uint8_t INVALID_DEVICE = 0xFF;
+static const int MAX_DEVICES = 8;
+
+struct I2CDevice
+{
+    int fd;
+    uint16_t address;
+};
+
+static I2CDevice devices[MAX_DEVICES];
+static int open_devices = 0;
+static std::atomic<uint32_t> transactions(0);
+
+// Handles are indices into devices, the callers pass them back as the address
+uint8_t cpi2c_open(uint8_t address, uint8_t bus)
+{
+    if (open_devices == MAX_DEVICES)
+    {
+        return INVALID_DEVICE;
+    }
+
+    char path[32];
+    snprintf(path, sizeof(path), "/dev/i2c-%u", bus);
+    int fd = open(path, O_RDWR);
+    if (fd < 0)
+    {
+        return INVALID_DEVICE;
+    }
+
+    devices[open_devices].fd = fd;
+    devices[open_devices].address = address;
+    return open_devices++;
+}
+
+static bool transfer(uint8_t device, struct i2c_msg* msgs, int count)
+{
+    if (device >= open_devices)
+    {
+        return false;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        msgs[i].addr = devices[device].address;
+    }
+
+    struct i2c_rdwr_ioctl_data data;
+    data.msgs = msgs;
+    data.nmsgs = count;
+    transactions++;
+    return ioctl(devices[device].fd, I2C_RDWR, &data) == count;
+}
+
+void cpi2c_readRegisters(uint8_t address, uint8_t subAddress, uint8_t count, uint8_t * dest)
+{
+    struct i2c_msg msgs[2];
+    msgs[0].flags = 0;
+    msgs[0].len = 1;
+    msgs[0].buf = &subAddress;
+    msgs[1].flags = I2C_M_RD;
+    msgs[1].len = count;
+    msgs[1].buf = dest;
+    if (!transfer(address, msgs, 2))
+    {
+        memset(dest, 0, count);
+    }
+}
+
+bool cpi2c_writeRegister(uint8_t address, uint8_t subAddress, uint8_t data)
+{
+    uint8_t buf[2] = {subAddress, data};
+    struct i2c_msg msg;
+    msg.flags = 0;
+    msg.len = sizeof(buf);
+    msg.buf = buf;
+    return transfer(address, &msg, 1);
+}
+
+// Low byte first, as the SMBus word read of the WiringPi backend
+uint16_t cpi2c_readRegister_8_16(uint8_t address, uint8_t subAddress)
+{
+    uint8_t data[2];
+    cpi2c_readRegisters(address, subAddress, 2, data);
+    return data[0] | (uint16_t)data[1] << 8;
+}
+
+bool cpi2c_writeRegister_16_8(uint8_t address, uint16_t subAddress, uint8_t data)
+{
+    uint8_t buf[3] = {(uint8_t)(subAddress >> 8), (uint8_t)subAddress, data};
+    struct i2c_msg msg;
+    msg.flags = 0;
+    msg.len = sizeof(buf);
+    msg.buf = buf;
+    return transfer(address, &msg, 1);
+}
+
+bool cpi2c_burstReads()
+{
+    return true;
+}
+
+uint32_t cpi2c_transactions()
+{
+    return transactions;
+}
+
+void cpi2c_resetTransactions()
+{
+    transactions = 0;
+}
@@ -233,3 +233,95 @@ bool MPUIMU::checkNewData(void)
 {
     return (bool)(readMPURegister(INT_STATUS) & 0x01);
 }
+
+bool MPUIMU::startStreaming(void)
+{
+    if (!burstReadsFifo()) return false;
+
+    startFifo(0x00, 0, 0x00);
+    return true;
+}
+
+void MPUIMU::stopStreaming(void)
+{
+    writeMPURegister(FIFO_EN, 0x00);       // Stop queueing samples
+    writeMPURegister(USER_CTRL, 0x04);     // Disable and reset the FIFO, I2C master off
+    _fifoPacketBytes = 0;
+}
+
+void MPUIMU::startFifo(uint8_t slaveSources, uint8_t slaveBytes, uint8_t userCtrl)
+{
+    // Samples are queued at the gyro output rate/(1 + SMPLRT_DIV), the output rate is 8 kHz with the DLPF bypassed
+    uint8_t dlpf = readMPURegister(CONFIG) & 0x07;
+    uint64_t outputRate = (dlpf == 0 || dlpf == 7) ? 8000 : 1000;
+    _samplePeriodNs = (1 + readMPURegister(SMPLRT_DIV)) * 1000000000ULL / outputRate;
+
+    _fifoPacketBytes = FIFO_IMU_BYTES + slaveBytes;
+    _fifoUserCtrl = userCtrl;
+    resetFifo();
+    writeMPURegister(FIFO_EN, FIFO_ACCEL_GYRO | slaveSources);  // Accel, then gyro, then slave data in each packet
+}
+
+void MPUIMU::resetFifo(void)
+{
+    writeMPURegister(USER_CTRL, _fifoUserCtrl | 0x04);  // Reset FIFO
+    writeMPURegister(USER_CTRL, _fifoUserCtrl | 0x40);  // Enable FIFO
+    _nextSampleNs = 0;
+}
+
+int MPUIMU::readBatch(ImuSampleBatch & batch, uint64_t nowNs)
+{
+    batch.count = 0;
+    batch.has_mag = _fifoPacketBytes > FIFO_IMU_BYTES;
+    if (_fifoPacketBytes == 0) return 0;
+
+    uint8_t data[2];
+    readMPURegisters(FIFO_COUNTH, 2, &data[0]);
+    uint16_t fifo_count = ((uint16_t)(data[0] & 0x1F) << 8) | data[1];
+
+    // Packets don't divide the FIFO evenly, so a full one has overwritten its oldest bytes and lost its alignment
+    if (fifo_count >= fifoSize()) {
+        _fifoOverflows++;
+        resetFifo();
+        return 0;
+    }
+
+    int queued = fifo_count / _fifoPacketBytes;
+    int packets = queued < ImuSampleBatch::CAPACITY ? queued : ImuSampleBatch::CAPACITY;
+
+    // Whole packets per read, the count is a byte
+    int chunk = (255 / _fifoPacketBytes) * _fifoPacketBytes;
+    int bytes = packets * _fifoPacketBytes;
+    for (int k = 0; k < bytes; k += chunk) {
+        int count = bytes - k < chunk ? bytes - k : chunk;
+        readMPURegisters(FIFO_R_W, (uint8_t)count, &_fifoData[k]);
+    }
+
+    // The newest queued sample was taken about now. Samples are evenly spaced, so carry on from the last batch
+    // unless the clocks have drifted apart by more than a sample
+    uint64_t first = nowNs - (uint64_t)(queued - 1) * _samplePeriodNs;
+    int64_t drift = (int64_t)(first - _nextSampleNs);
+    if (_nextSampleNs != 0 && drift < (int64_t)_samplePeriodNs && drift > -(int64_t)_samplePeriodNs) {
+        first = _nextSampleNs;
+    }
+    _nextSampleNs = first + (uint64_t)packets * _samplePeriodNs;
+
+    for (int i = 0; i < packets; i++) {
+        const uint8_t * p = &_fifoData[i * _fifoPacketBytes];
+        batch.timestamp_ns[i] = first + (uint64_t)i * _samplePeriodNs;
+        batch.ax[i] = (float)(int16_t)(((uint16_t)p[0] << 8) | p[1]) * _aRes - _accelBias[0];
+        batch.ay[i] = (float)(int16_t)(((uint16_t)p[2] << 8) | p[3]) * _aRes - _accelBias[1];
+        batch.az[i] = (float)(int16_t)(((uint16_t)p[4] << 8) | p[5]) * _aRes - _accelBias[2];
+        batch.gx[i] = (float)(int16_t)(((uint16_t)p[6] << 8) | p[7]) * _gRes;
+        batch.gy[i] = (float)(int16_t)(((uint16_t)p[8] << 8) | p[9]) * _gRes;
+        batch.gz[i] = (float)(int16_t)(((uint16_t)p[10] << 8) | p[11]) * _gRes;
+        decodeFifoSlaves(p + FIFO_IMU_BYTES, batch, i);
+    }
+    batch.count = packets;
+    return packets;
+}
+
+uint32_t MPUIMU::fifoOverflows(void)
+{
+    return _fifoOverflows;
+}
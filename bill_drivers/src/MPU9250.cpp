@@ -420,7 +420,11 @@ void MPU9250::readMagnetometer(float & mx, float & my, float & mz)
 {
     int16_t magCount[3];
     readMagData(magCount);
+    scaleMagnetometer(magCount, mx, my, mz);
+}
 
+void MPU9250::scaleMagnetometer(const int16_t * magCount, float & mx, float & my, float & mz)
+{
     // Calculate the magnetometer values in milliGauss
     // Include factory calibration per data sheet and user environmental corrections
     // Get actual magnetometer value, this depends on scale being set
@@ -432,6 +436,46 @@ void MPU9250::readMagnetometer(float & mx, float & my, float & mz)
     mz *= _magScale[2]; 
 }
 
+bool MPU9250::startStreaming(void)
+{
+    if (!burstReadsFifo()) return false;
+
+    writeMPURegister(INT_PIN_CFG, 0x10);    // Bypass off, the I2C master owns the magnetometer now
+    writeMPURegister(I2C_MST_CTRL, 0x0D);   // 400 kHz master clock
+    writeMPURegister(I2C_SLV0_ADDR, AK8963_ADDRESS | I2C_READ_FLAG);
+    writeMPURegister(I2C_SLV0_REG, AK8963_XOUT_L);
+    writeMPURegister(I2C_SLV0_CTRL, I2C_SLV0_EN | 7);  // Six data bytes and ST2, the ST2 read releases the next sample
+    startFifo(FIFO_SLV0, 7, I2C_MST_EN);
+    return true;
+}
+
+void MPU9250::stopStreaming(void)
+{
+    MPUIMU::stopStreaming();
+    writeMPURegister(I2C_SLV0_CTRL, 0x00);
+
+    if (_passthru) {
+        writeMPURegister(INT_PIN_CFG, 0x12);  // Bypass back on for readAK8963Registers()
+    }
+    else {
+        writeMPURegister(USER_CTRL, I2C_MST_EN);
+    }
+}
+
+void MPU9250::decodeFifoSlaves(const uint8_t * data, ImuSampleBatch & batch, int i)
+{
+    if (!(data[6] & 0x08)) { // Same overflow check as readMagData()
+        int16_t magCount[3];
+        magCount[0] = ((int16_t)data[1] << 8) | data[0];  // Data stored as little Endian
+        magCount[1] = ((int16_t)data[3] << 8) | data[2];
+        magCount[2] = ((int16_t)data[5] << 8) | data[4];
+        scaleMagnetometer(magCount, _streamMag[0], _streamMag[1], _streamMag[2]);
+    }
+    batch.mx[i] = _streamMag[0];
+    batch.my[i] = _streamMag[1];
+    batch.mz[i] = _streamMag[2];
+}
+
 void MPU9250::readMagData(int16_t * destination)
 {
     uint8_t rawData[7];  // x/y/z gyro register data, ST2 register stored here, must read ST2 at end of data acquisition
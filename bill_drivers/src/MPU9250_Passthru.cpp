@@ -23,6 +23,7 @@
 #include "bill_drivers/MPU9250_Passthru.h"
 
 #include "bill_drivers/CrossPlatformI2C.h"
+#include "bill_drivers/i2c_bus.hpp"
 
 MPU9250_Passthru::MPU9250_Passthru(Ascale_t ascale, Gscale_t gscale, Mscale_t mscale, Mmode_t mmode, uint8_t sampleRateDivisor) :
     MPU9250(ascale, gscale, mscale, mmode, sampleRateDivisor, true)
@@ -87,4 +88,9 @@ void MPU9250_Passthru::readMPURegisters(uint8_t subAddress, uint8_t count, uint8
     cpi2c_readRegisters(_i2c, subAddress, count, dest);
 }
 
+bool MPU9250_Passthru::burstReadsFifo(void)
+{
+    return cpi2c_burstReads();
+}
+
 
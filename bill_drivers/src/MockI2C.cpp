@@ -0,0 +1,117 @@
+#include "bill_drivers/CrossPlatformI2C.h"
+#include "bill_drivers/i2c_bus.hpp"
+#include <atomic>
+#include <deque>
+#include <map>
+#include <vector>
+
+// cpi2c_ backend with no hardware behind it, for running the drivers against register contents set up by a test.
+// Counts transactions the same way as the i2c-dev backend
+
+struct MockDevice
+{
+    MockDevice() : registers(256, 0) {}
+    std::vector<uint8_t> registers;
+    std::map<uint8_t, std::deque<uint8_t>> fifos;
+};
+
+static std::map<uint8_t, MockDevice> mock_devices;
+static std::vector<uint8_t> handles;
+static std::atomic<uint32_t> transactions(0);
+
+static uint8_t deviceAddress(uint8_t handle)
+{
+    return handle < handles.size() ? handles[handle] : 0xFF;
+}
+
+uint8_t cpi2c_open(uint8_t address, uint8_t bus)
+{
+    (void)bus;
+    handles.push_back(address);
+    return handles.size() - 1;
+}
+
+void cpi2c_readRegisters(uint8_t address, uint8_t subAddress, uint8_t count, uint8_t * dest)
+{
+    transactions++;
+    cpi2c_mockRead(deviceAddress(address), subAddress, dest, count);
+}
+
+bool cpi2c_writeRegister(uint8_t address, uint8_t subAddress, uint8_t data)
+{
+    transactions++;
+    cpi2c_mockWrite(deviceAddress(address), subAddress, &data, 1);
+    return true;
+}
+
+uint16_t cpi2c_readRegister_8_16(uint8_t address, uint8_t subAddress)
+{
+    uint8_t data[2];
+    cpi2c_readRegisters(address, subAddress, 2, data);
+    return data[0] | (uint16_t)data[1] << 8;
+}
+
+bool cpi2c_writeRegister_16_8(uint8_t address, uint16_t subAddress, uint8_t data)
+{
+    transactions++;
+    cpi2c_mockWrite(deviceAddress(address), (uint8_t)subAddress, &data, 1);
+    return true;
+}
+
+void cpi2c_mockWrite(uint8_t address, uint8_t subAddress, const uint8_t* data, size_t count)
+{
+    MockDevice& device = mock_devices[address];
+    for (size_t i = 0; i < count; i++)
+    {
+        device.registers[(subAddress + i) & 0xFF] = data[i];
+    }
+}
+
+void cpi2c_mockRead(uint8_t address, uint8_t subAddress, uint8_t* data, size_t count)
+{
+    MockDevice& device = mock_devices[address];
+    std::map<uint8_t, std::deque<uint8_t>>::iterator fifo = device.fifos.find(subAddress);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (fifo == device.fifos.end())
+        {
+            data[i] = device.registers[(subAddress + i) & 0xFF];
+        }
+        else if (fifo->second.empty())
+        {
+            data[i] = 0;
+        }
+        else
+        {
+            data[i] = fifo->second.front();
+            fifo->second.pop_front();
+        }
+    }
+}
+
+void cpi2c_mockPushFifo(uint8_t address, uint8_t subAddress, const uint8_t* data, size_t count)
+{
+    std::deque<uint8_t>& fifo = mock_devices[address].fifos[subAddress];
+    fifo.insert(fifo.end(), data, data + count);
+}
+
+void cpi2c_mockReset()
+{
+    mock_devices.clear();
+    transactions = 0;
+}
+
+bool cpi2c_burstReads()
+{
+    return true;
+}
+
+uint32_t cpi2c_transactions()
+{
+    return transactions;
+}
+
+void cpi2c_resetTransactions()
+{
+    transactions = 0;
+}
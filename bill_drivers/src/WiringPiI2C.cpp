@@ -17,9 +17,13 @@
 */
 
 #include "bill_drivers/CrossPlatformI2C.h"
+#include "bill_drivers/i2c_bus.hpp"
 
 #include <wiringPi.h>
 #include <wiringPiI2C.h>
+#include <atomic>
+
+static std::atomic<uint32_t> transactions(0);
 
 uint8_t cpi2c_open(uint8_t address, uint8_t bus)
 {
@@ -29,22 +33,42 @@ uint8_t cpi2c_open(uint8_t address, uint8_t bus)
 
 bool cpi2c_writeRegister(uint8_t address, uint8_t subAddress, uint8_t data)
 {
+    transactions++;
 	return wiringPiI2CWriteReg8(address, subAddress, data) == 0;
 }
 
 uint16_t cpi2c_readRegister_8_16(uint8_t address, uint8_t subAddress)
 {
+    transactions++;
     return wiringPiI2CReadReg16 (address, subAddress);
 }
 
 void cpi2c_readRegisters(uint8_t address, uint8_t subAddress, uint8_t count, uint8_t * dest)
 {
+    // One SMBus byte read per register, see LinuxI2C.cpp for a burst
     for (uint8_t i=0; i<count; ++i) {
+        transactions++;
         dest[i] = wiringPiI2CReadReg8(address, subAddress+i);
     }
 }
 
 bool cpi2c_writeRegister_16_8(uint8_t address, uint16_t subAddress, uint8_t data)
 {
+    transactions++;
     return wiringPiI2CWriteReg8 (address, subAddress, data) > 0;
 }
+
+bool cpi2c_burstReads()
+{
+    return false;
+}
+
+uint32_t cpi2c_transactions()
+{
+    return transactions;
+}
+
+void cpi2c_resetTransactions()
+{
+    transactions = 0;
+}
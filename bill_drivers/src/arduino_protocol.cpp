@@ -0,0 +1,312 @@
+#include "bill_drivers/arduino_protocol.hpp"
+#include <string.h>
+
+struct Crc16Table
+{
+    uint16_t entries[256];
+
+    Crc16Table()
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            uint16_t crc = (uint16_t)(i << 8);
+            for (int bit = 0; bit < 8; bit++)
+            {
+                crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+            }
+            entries[i] = crc;
+        }
+    }
+};
+
+static const Crc16Table crc16_table;
+
+uint16_t crc16Ccitt(const uint8_t* data, size_t length, uint16_t crc)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        crc = (uint16_t)(crc << 8) ^ crc16_table.entries[(crc >> 8) ^ data[i]];
+    }
+    return crc;
+}
+
+BinaryFrameParser::BinaryFrameParser()
+{
+    _frames = 0;
+    _crc_errors = 0;
+    _dropped_frames = 0;
+    _have_seq = false;
+    _last_seq = 0;
+    reset();
+}
+
+void BinaryFrameParser::reset()
+{
+    _state = WAIT_SYNC_1;
+    _index = 0;
+    _rx_crc = 0;
+}
+
+bool BinaryFrameParser::push(uint8_t byte, ArduinoPacket& packet)
+{
+    switch (_state)
+    {
+        case WAIT_SYNC_1:
+            if (byte == FRAME_SYNC_1)
+            {
+                _state = WAIT_SYNC_2;
+            }
+            break;
+        case WAIT_SYNC_2:
+            if (byte == FRAME_SYNC_2)
+            {
+                _state = READ_LENGTH;
+            }
+            else if (byte != FRAME_SYNC_1)
+            {
+                _state = WAIT_SYNC_1;
+            }
+            break;
+        case READ_LENGTH:
+            // Only the sensor payload is defined, anything else means we synced on payload bytes
+            if (byte != ARDUINO_PAYLOAD_LENGTH)
+            {
+                reset();
+                break;
+            }
+            _buffer[0] = byte;
+            _state = READ_SEQ;
+            break;
+        case READ_SEQ:
+            _buffer[1] = byte;
+            _index = 2;
+            _state = READ_PAYLOAD;
+            break;
+        case READ_PAYLOAD:
+            _buffer[_index++] = byte;
+            if (_index == _buffer[0] + 2)
+            {
+                _state = READ_CRC_LOW;
+            }
+            break;
+        case READ_CRC_LOW:
+            _rx_crc = byte;
+            _state = READ_CRC_HIGH;
+            break;
+        case READ_CRC_HIGH:
+            _rx_crc |= (uint16_t)byte << 8;
+            return completeFrame(packet);
+    }
+    return false;
+}
+
+bool BinaryFrameParser::completeFrame(ArduinoPacket& packet)
+{
+    uint8_t length = _buffer[0];
+    bool valid = crc16Ccitt(_buffer, length + 2) == _rx_crc;
+    reset();
+
+    if (!valid)
+    {
+        _crc_errors++;
+        return false;
+    }
+
+    uint8_t seq = _buffer[1];
+    if (_have_seq)
+    {
+        _dropped_frames += (uint8_t)(seq - _last_seq - 1);
+    }
+    _have_seq = true;
+    _last_seq = seq;
+    _frames++;
+
+    memcpy(packet.data, &_buffer[2], ARDUINO_PAYLOAD_LENGTH);
+    packet.seq = seq;
+    packet.length = length + 6;
+    return true;
+}
+
+uint32_t BinaryFrameParser::frames() const
+{
+    return _frames;
+}
+
+uint32_t BinaryFrameParser::crcErrors() const
+{
+    return _crc_errors;
+}
+
+uint32_t BinaryFrameParser::droppedFrames() const
+{
+    return _dropped_frames;
+}
+
+TextFrameParser::TextFrameParser()
+{
+    _frames = 0;
+    _resyncs = 0;
+    _discarded_lines = 0;
+    reset();
+}
+
+void TextFrameParser::reset()
+{
+    _token_count = 0;
+    _line_bytes = 0;
+    _value = 0;
+    _digits = 0;
+    _skip_token = false;
+    _resynced = false;
+}
+
+bool TextFrameParser::push(uint8_t byte, ArduinoPacket& packet)
+{
+    if (_line_bytes < UINT16_MAX)
+    {
+        _line_bytes++;
+    }
+    if (byte >= '0' && byte <= '9')
+    {
+        if (!_skip_token)
+        {
+            _value = _value * 10 + (byte - '0');
+            _digits++;
+            if (_value > 255)
+            {
+                _skip_token = true;
+            }
+        }
+    }
+    else if (byte == ' ')
+    {
+        endToken();
+    }
+    else if (byte == '\n')
+    {
+        return endLine(packet);
+    }
+    else if (byte != '\r')
+    {
+        // Anything else makes the current token invalid, parsing picks up again at the next delimiter
+        _skip_token = true;
+    }
+    return false;
+}
+
+void TextFrameParser::endToken()
+{
+    if (_skip_token)
+    {
+        _resynced = true;
+    }
+    else if (_digits > 0)
+    {
+        if (_token_count >= (uint32_t)ARDUINO_PAYLOAD_LENGTH)
+        {
+            _resynced = true;
+        }
+        _tokens[_token_count % ARDUINO_PAYLOAD_LENGTH] = (uint8_t)_value;
+        _token_count++;
+    }
+    _value = 0;
+    _digits = 0;
+    _skip_token = false;
+}
+
+bool TextFrameParser::endLine(ArduinoPacket& packet)
+{
+    endToken();
+
+    bool complete = _token_count >= (uint32_t)ARDUINO_PAYLOAD_LENGTH;
+    if (complete)
+    {
+        // The oldest of the last ARDUINO_PAYLOAD_LENGTH tokens sits right after the newest one in the ring
+        uint32_t start = _token_count % ARDUINO_PAYLOAD_LENGTH;
+        for (int i = 0; i < ARDUINO_PAYLOAD_LENGTH; i++)
+        {
+            packet.data[i] = _tokens[(start + i) % ARDUINO_PAYLOAD_LENGTH];
+        }
+        packet.seq = (uint8_t)_frames;
+        packet.length = _line_bytes;
+        _frames++;
+        if (_resynced)
+        {
+            _resyncs++;
+        }
+    }
+    else if (_token_count > 0 || _resynced)
+    {
+        _discarded_lines++;
+    }
+
+    reset();
+    return complete;
+}
+
+uint32_t TextFrameParser::frames() const
+{
+    return _frames;
+}
+
+uint32_t TextFrameParser::resyncs() const
+{
+    return _resyncs;
+}
+
+uint32_t TextFrameParser::discardedLines() const
+{
+    return _discarded_lines;
+}
+
+ArduinoFrameParser::ArduinoFrameParser(ArduinoProtocol protocol)
+{
+    _protocol = protocol;
+}
+
+size_t ArduinoFrameParser::parse(const uint8_t* data, size_t length, ArduinoPacket& packet, bool& complete)
+{
+    complete = false;
+    size_t i = 0;
+    if (_protocol == PROTOCOL_BINARY)
+    {
+        while (i < length && !complete)
+        {
+            complete = _binary.push(data[i++], packet);
+        }
+    }
+    else
+    {
+        while (i < length && !complete)
+        {
+            complete = _text.push(data[i++], packet);
+        }
+    }
+    return i;
+}
+
+void ArduinoFrameParser::reset()
+{
+    _binary.reset();
+    _text.reset();
+}
+
+ArduinoProtocol ArduinoFrameParser::protocol() const
+{
+    return _protocol;
+}
+
+uint32_t ArduinoFrameParser::frames() const
+{
+    return _protocol == PROTOCOL_BINARY ? _binary.frames() : _text.frames();
+}
+
+uint32_t ArduinoFrameParser::droppedFrames() const
+{
+    return _protocol == PROTOCOL_BINARY ? _binary.droppedFrames() : _text.discardedLines();
+}
+
+uint32_t ArduinoFrameParser::errors() const
+{
+    return _protocol == PROTOCOL_BINARY ? _binary.crcErrors() : _text.resyncs();
+}
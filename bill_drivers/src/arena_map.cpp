@@ -0,0 +1,208 @@
+#include "bill_drivers/arena_map.hpp"
+
+static const int HEADING_DX[ARENA_HEADINGS] = {1, 0, -1, 0};
+static const int HEADING_DY[ARENA_HEADINGS] = {0, 1, 0, -1};
+
+ArenaMap::ArenaMap(int width, int height, float tile_size)
+{
+    _width = width;
+    _height = height;
+    _tile_size = tile_size;
+    _course_width = width * tile_size;
+    _course_height = height * tile_size;
+    reset();
+}
+
+void ArenaMap::reset()
+{
+    _open_sides.assign(_width * _height, 0);
+    for (int tile = 0; tile < tiles(); tile++)
+    {
+        for (int h = 0; h < ARENA_HEADINGS; h++)
+        {
+            if (adjacent(tile, h) >= 0)
+            {
+                _open_sides[tile] |= (1 << h);
+            }
+        }
+    }
+}
+
+bool ArenaMap::load(const ros::NodeHandle& nh, const std::string& ns)
+{
+    if (!nh.getParam(ns + "/width", _width) || !nh.getParam(ns + "/height", _height) || _width <= 0 || _height <= 0)
+    {
+        ROS_ERROR("No valid arena size in %s", ns.c_str());
+        return false;
+    }
+    nh.getParam(ns + "/tile_size", _tile_size);
+    _course_width = _width * _tile_size;
+    _course_height = _height * _tile_size;
+    nh.getParam(ns + "/course_width", _course_width);
+    nh.getParam(ns + "/course_height", _course_height);
+    reset();
+
+    std::vector<int> blocked_tiles;
+    nh.getParam(ns + "/blocked_tiles", blocked_tiles);
+    for (size_t i = 0; i + 1 < blocked_tiles.size(); i += 2)
+    {
+        if (!contains(blocked_tiles[i], blocked_tiles[i + 1]))
+        {
+            ROS_WARN("Blocked tile %i, %i is off the arena", blocked_tiles[i], blocked_tiles[i + 1]);
+            continue;
+        }
+        blockTile(index(blocked_tiles[i], blocked_tiles[i + 1]));
+    }
+
+    std::vector<int> blocked_edges;
+    nh.getParam(ns + "/blocked_edges", blocked_edges);
+    for (size_t i = 0; i + 3 < blocked_edges.size(); i += 4)
+    {
+        int heading = -1;
+        if (contains(blocked_edges[i], blocked_edges[i + 1]) && contains(blocked_edges[i + 2], blocked_edges[i + 3]))
+        {
+            heading = headingBetween(index(blocked_edges[i], blocked_edges[i + 1]),
+                                     index(blocked_edges[i + 2], blocked_edges[i + 3]));
+        }
+        if (heading < 0)
+        {
+            ROS_WARN("Blocked edge %i, %i to %i, %i is not between neighbouring tiles", blocked_edges[i],
+                     blocked_edges[i + 1], blocked_edges[i + 2], blocked_edges[i + 3]);
+            continue;
+        }
+        setOpen(index(blocked_edges[i], blocked_edges[i + 1]), heading, false);
+    }
+
+    std::vector<int> home_tiles;
+    nh.getParam(ns + "/home_tiles", home_tiles);
+    _home_tiles.clear();
+    for (size_t i = 0; i + 2 < home_tiles.size(); i += 3)
+    {
+        HomeTile home = {home_tiles[i], home_tiles[i + 1], home_tiles[i + 2]};
+        _home_tiles.push_back(home);
+    }
+
+    ROS_INFO("Loaded a %ix%i arena of %.2f m tiles", _width, _height, _tile_size);
+    return true;
+}
+
+int ArenaMap::width() const
+{
+    return _width;
+}
+
+int ArenaMap::height() const
+{
+    return _height;
+}
+
+int ArenaMap::tiles() const
+{
+    return _width * _height;
+}
+
+float ArenaMap::tileSize() const
+{
+    return _tile_size;
+}
+
+float ArenaMap::courseWidth() const
+{
+    return _course_width;
+}
+
+float ArenaMap::courseHeight() const
+{
+    return _course_height;
+}
+
+const std::vector<HomeTile>& ArenaMap::homeTiles() const
+{
+    return _home_tiles;
+}
+
+bool ArenaMap::contains(int x, int y) const
+{
+    return x >= 0 && x < _width && y >= 0 && y < _height;
+}
+
+int ArenaMap::index(int x, int y) const
+{
+    return y * _width + x;
+}
+
+int ArenaMap::tileX(int tile) const
+{
+    return tile % _width;
+}
+
+int ArenaMap::tileY(int tile) const
+{
+    return tile / _width;
+}
+
+int ArenaMap::adjacent(int tile, int heading) const
+{
+    int x = tileX(tile) + HEADING_DX[heading];
+    int y = tileY(tile) + HEADING_DY[heading];
+    return contains(x, y) ? index(x, y) : -1;
+}
+
+int ArenaMap::neighbour(int tile, int heading) const
+{
+    return isOpen(tile, heading) ? adjacent(tile, heading) : -1;
+}
+
+int ArenaMap::headingBetween(int src, int dest) const
+{
+    if (src < 0 || src >= tiles())
+    {
+        return -1;
+    }
+    for (int h = 0; h < ARENA_HEADINGS; h++)
+    {
+        if (adjacent(src, h) == dest)
+        {
+            return h;
+        }
+    }
+    return -1;
+}
+
+bool ArenaMap::isOpen(int tile, int heading) const
+{
+    return (_open_sides[tile] & (1 << heading)) != 0;
+}
+
+uint8_t ArenaMap::openSides(int tile) const
+{
+    return _open_sides[tile];
+}
+
+void ArenaMap::setOpen(int tile, int heading, bool open)
+{
+    int other = adjacent(tile, heading);
+    if (other < 0)
+    {
+        return;
+    }
+    int back = (heading + 2) % ARENA_HEADINGS;
+    if (open)
+    {
+        _open_sides[tile] |= (1 << heading);
+        _open_sides[other] |= (1 << back);
+    }
+    else
+    {
+        _open_sides[tile] &= ~(1 << heading);
+        _open_sides[other] &= ~(1 << back);
+    }
+}
+
+void ArenaMap::blockTile(int tile)
+{
+    for (int h = 0; h < ARENA_HEADINGS; h++)
+    {
+        setOpen(tile, h, false);
+    }
+}
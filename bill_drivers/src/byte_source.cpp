@@ -0,0 +1,188 @@
+#include "bill_drivers/byte_source.hpp"
+#include "serial/serial.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+
+static void makeRaw(int fd)
+{
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+}
+
+SerialByteSource::SerialByteSource(const std::string& port, int baud)
+{
+    _port = port;
+    _baud = baud;
+    _timeout_ms = -1;
+}
+
+SerialByteSource::~SerialByteSource()
+{
+}
+
+bool SerialByteSource::open()
+{
+    try
+    {
+        _serial.reset(new serial::Serial(_port, _baud, serial::Timeout::simpleTimeout(1000)));
+    }
+    catch (const std::exception& e)
+    {
+        _serial.reset();
+        return false;
+    }
+    return _serial->isOpen();
+}
+
+int SerialByteSource::read(uint8_t* buffer, size_t size, int timeout_ms)
+{
+    try
+    {
+        if (timeout_ms != _timeout_ms)
+        {
+            _serial->setTimeout(serial::Timeout::simpleTimeout(timeout_ms));
+            _timeout_ms = timeout_ms;
+        }
+
+        // Take whatever is buffered, or block for the first byte when nothing is
+        size_t available = _serial->available();
+        return (int)_serial->read(buffer, available == 0 ? 1 : std::min(available, size));
+    }
+    catch (const std::exception& e)
+    {
+        return -1;
+    }
+}
+
+FdByteSource::FdByteSource(const std::string& path)
+{
+    _path = path;
+    _fd = -1;
+}
+
+FdByteSource::FdByteSource()
+{
+    _fd = -1;
+}
+
+FdByteSource::~FdByteSource()
+{
+    close();
+}
+
+bool FdByteSource::open()
+{
+    close();
+    _fd = ::open(_path.c_str(), O_RDONLY | O_NOCTTY | O_CLOEXEC);
+    if (_fd < 0)
+    {
+        return false;
+    }
+    if (isatty(_fd))
+    {
+        makeRaw(_fd);
+    }
+    return true;
+}
+
+void FdByteSource::close()
+{
+    if (_fd >= 0)
+    {
+        ::close(_fd);
+    }
+    _fd = -1;
+}
+
+int FdByteSource::read(uint8_t* buffer, size_t size, int timeout_ms)
+{
+    if (_fd < 0)
+    {
+        return -1;
+    }
+
+    struct pollfd pfd;
+    pfd.fd = _fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    int ret;
+    do
+    {
+        ret = poll(&pfd, 1, timeout_ms);
+    } while (ret < 0 && errno == EINTR);
+
+    if (ret < 0)
+    {
+        return -1;
+    }
+    if (ret == 0)
+    {
+        return 0;
+    }
+
+    ssize_t n;
+    do
+    {
+        n = ::read(_fd, buffer, size);
+    } while (n < 0 && errno == EINTR);
+
+    // End of file or a hung up tty
+    return n > 0 ? (int)n : -1;
+}
+
+PtyByteSource::PtyByteSource()
+{
+    _slave_fd = -1;
+}
+
+PtyByteSource::~PtyByteSource()
+{
+    if (_slave_fd >= 0)
+    {
+        ::close(_slave_fd);
+    }
+}
+
+bool PtyByteSource::open()
+{
+    close();
+    _fd = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (_fd < 0 || grantpt(_fd) < 0 || unlockpt(_fd) < 0)
+    {
+        close();
+        return false;
+    }
+
+    const char* name = ptsname(_fd);
+    if (name == NULL)
+    {
+        close();
+        return false;
+    }
+    _path = name;
+
+    // Keep the slave side open ourselves, otherwise the master reports a hang up every time a writer closes it
+    _slave_fd = ::open(name, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (_slave_fd < 0)
+    {
+        close();
+        return false;
+    }
+    makeRaw(_slave_fd);
+    return true;
+}
+
+const std::string& PtyByteSource::slaveName() const
+{
+    return _path;
+}
@@ -0,0 +1,66 @@
+#include "nodelet/nodelet.h"
+#include "pluginlib/class_list_macros.h"
+#include "bill_drivers/driver_nodes.hpp"
+
+// Nodelet wrappers so the drivers can share one process, see launch/drivers_nodelet.launch
+
+namespace bill_drivers
+{
+class EncoderDriverNodelet : public nodelet::Nodelet
+{
+public:
+    ~EncoderDriverNodelet()
+    {
+        encoder_driver::stop();
+    }
+
+private:
+    virtual void onInit()
+    {
+        if (!encoder_driver::start(getNodeHandle(), getPrivateNodeHandle()))
+        {
+            NODELET_ERROR("Encoder driver failed to start");
+        }
+    }
+};
+
+class SerialDriverNodelet : public nodelet::Nodelet
+{
+public:
+    ~SerialDriverNodelet()
+    {
+        serial_driver::stop();
+    }
+
+private:
+    virtual void onInit()
+    {
+        if (!serial_driver::start(getNodeHandle(), getPrivateNodeHandle()))
+        {
+            NODELET_ERROR("Serial driver failed to start");
+        }
+    }
+};
+
+class LocalizationNodelet : public nodelet::Nodelet
+{
+public:
+    ~LocalizationNodelet()
+    {
+        localization_node::stop();
+    }
+
+private:
+    virtual void onInit()
+    {
+        if (!localization_node::start(getNodeHandle(), getPrivateNodeHandle()))
+        {
+            NODELET_ERROR("Localization node failed to start");
+        }
+    }
+};
+}  // namespace bill_drivers
+
+PLUGINLIB_EXPORT_CLASS(bill_drivers::EncoderDriverNodelet, nodelet::Nodelet)
+PLUGINLIB_EXPORT_CLASS(bill_drivers::SerialDriverNodelet, nodelet::Nodelet)
+PLUGINLIB_EXPORT_CLASS(bill_drivers::LocalizationNodelet, nodelet::Nodelet)
@@ -0,0 +1,140 @@
+#include "bill_drivers/ekf.hpp"
+#include <cmath>
+
+static double wrapAngle(double angle)
+{
+    return std::atan2(std::sin(angle), std::cos(angle));
+}
+
+PoseEkf::PoseEkf()
+{
+    reset(0, 0, 0, 0, 0);
+}
+
+void PoseEkf::reset(double x, double y, double theta, double var_xy, double var_theta)
+{
+    _state[X] = x;
+    _state[Y] = y;
+    _state[THETA] = wrapAngle(theta);
+    for (int r = 0; r < N; r++)
+    {
+        for (int c = 0; c < N; c++)
+        {
+            _P[r][c] = 0;
+        }
+    }
+    _P[X][X] = var_xy;
+    _P[Y][Y] = var_xy;
+    _P[THETA][THETA] = var_theta;
+}
+
+void PoseEkf::predict(double distance, double delta_theta, double var_distance, double var_theta)
+{
+    double heading = _state[THETA] + delta_theta / 2.0;
+    double c = std::cos(heading);
+    double s = std::sin(heading);
+
+    _state[X] += distance * c;
+    _state[Y] += distance * s;
+    _state[THETA] = wrapAngle(_state[THETA] + delta_theta);
+
+    // F = I except for the position's dependence on heading
+    double F[N][N] = {{1, 0, -distance * s}, {0, 1, distance * c}, {0, 0, 1}};
+    // G maps the (distance, delta_theta) noise into the state
+    double G[N][2] = {{c, -distance * s / 2.0}, {s, distance * c / 2.0}, {0, 1}};
+
+    double FP[N][N];
+    for (int r = 0; r < N; r++)
+    {
+        for (int col = 0; col < N; col++)
+        {
+            FP[r][col] = 0;
+            for (int k = 0; k < N; k++)
+            {
+                FP[r][col] += F[r][k] * _P[k][col];
+            }
+        }
+    }
+
+    for (int r = 0; r < N; r++)
+    {
+        for (int col = 0; col < N; col++)
+        {
+            double value = G[r][0] * var_distance * G[col][0] + G[r][1] * var_theta * G[col][1];
+            for (int k = 0; k < N; k++)
+            {
+                value += FP[r][k] * F[col][k];
+            }
+            _P[r][col] = value;
+        }
+    }
+}
+
+bool PoseEkf::updatePosition(State axis, double z, double variance, double gate)
+{
+    return update(axis, z - _state[axis], variance, gate);
+}
+
+bool PoseEkf::updateHeading(double theta, double variance, double gate)
+{
+    return update(THETA, wrapAngle(theta - _state[THETA]), variance, gate);
+}
+
+bool PoseEkf::update(int index, double innovation, double variance, double gate)
+{
+    double S = _P[index][index] + variance;
+    if (S <= 0 || innovation * innovation / S > gate)
+    {
+        return false;
+    }
+
+    double K[N];
+    double row[N];
+    for (int i = 0; i < N; i++)
+    {
+        K[i] = _P[i][index] / S;
+        row[i] = _P[index][i];
+    }
+
+    for (int i = 0; i < N; i++)
+    {
+        _state[i] += K[i] * innovation;
+        for (int j = 0; j < N; j++)
+        {
+            _P[i][j] -= K[i] * row[j];
+        }
+    }
+    _state[THETA] = wrapAngle(_state[THETA]);
+
+    // Keep P symmetric against rounding
+    for (int i = 0; i < N; i++)
+    {
+        for (int j = i + 1; j < N; j++)
+        {
+            double mean = (_P[i][j] + _P[j][i]) / 2.0;
+            _P[i][j] = mean;
+            _P[j][i] = mean;
+        }
+    }
+    return true;
+}
+
+double PoseEkf::x() const
+{
+    return _state[X];
+}
+
+double PoseEkf::y() const
+{
+    return _state[Y];
+}
+
+double PoseEkf::theta() const
+{
+    return _state[THETA];
+}
+
+double PoseEkf::covariance(int row, int col) const
+{
+    return _P[row][col];
+}
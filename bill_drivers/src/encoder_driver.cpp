@@ -1,113 +1,113 @@
 #include "nav_msgs/Odometry.h"
 #include "ros/ros.h"
 #include "tf/transform_datatypes.h"
-#include "wiringPi.h"
 #include "angles/angles.h"
 #include "bill_drivers/constant_definition.hpp"
+#include "bill_drivers/encoder_source.hpp"
+#include "bill_drivers/wheel_ticks.hpp"
+#include "bill_drivers/driver_nodes.hpp"
+#include "bill_drivers/trace.hpp"
 #include "bill_msgs/MotorDirection.h"
 #include "bill_msgs/Position.h"
 #include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <errno.h>
+#include <string.h>
 
+namespace encoder_driver
+{
 // TODO: Get an accurate measurement of the wheel's diameter and wheel base
 const float DIST_PER_TICK = (M_PI * 4.0 * 0.0254 / (20 * 125));  // pi * diameter * meters_to_inches / counts per rev
 const float WHEEL_BASE = 7 * 0.0254;
-const int MOTORA_COUNTER_KEY = 0;
-const int MOTORB_COUNTER_KEY = 1;
 const float slip_ratio = 0.6879;
 
-int motorA_stateA_prev;
-int motorB_stateA_prev;
-int motorA_stateA;
-int motorB_stateA;
-int motorA_counter = 0;
-int motorB_counter = 0;
-int motorA_Acounter = 0;
-int motorB_Acounter = 0;
-int motorA_counter_prev = 0;
-int motorB_counter_prev = 0;
-int direction_right = 1;
-int direction_left = 1;
+const int EDGE_TIMEOUT_MS = 100;
+
+WheelTicks right_ticks;
+WheelTicks left_ticks;
+uint64_t last_odom_ns = 0;
 float theta = M_PI_2;  // In radians
 float x = 1.05;      // m 
 float y = 0.13;      // m
 
-void setup()
-{
-    wiringPiSetupGpio();
-    pinMode(MOTORA_ENCA_PIN, INPUT);
-    pinMode(MOTORB_ENCA_PIN, INPUT);
+std::unique_ptr<EncoderSource> encoder_source;
+EncoderRecorder edge_recorder;
+std::thread edge_thread;
+std::atomic<bool> running(false);
 
-    motorA_stateA_prev = digitalRead(MOTORA_ENCA_PIN);
-    motorB_stateA_prev = digitalRead(MOTORB_ENCA_PIN);
-}
+ros::Publisher odom_pub;
+ros::Subscriber motor_sub;
+ros::Subscriber position_sub;
+ros::Timer odom_timer;
+uint64_t last_traced_edge_ns = 0;
 
-PI_THREAD(motorA_encoder)
+bool setup(const ros::NodeHandle& private_nh)
 {
-    ROS_INFO("Thread A started!");
-    while (1)
+    std::string source_type = "gpio";
+    std::string gpio_chip = DEFAULT_GPIO_CHIP;
+    std::string replay_file;
+    std::string record_file;
+    private_nh.getParam("source", source_type);
+    private_nh.getParam("gpio_chip", gpio_chip);
+    private_nh.getParam("replay_file", replay_file);
+    private_nh.getParam("record_file", record_file);
+
+    if (source_type == "replay")
     {
-        motorA_stateA = digitalRead(MOTORA_ENCA_PIN);
+        ROS_INFO("Replaying encoder edges from %s", replay_file.c_str());
+        encoder_source.reset(new ReplayEncoderSource(replay_file));
+    }
+    else
+    {
+        encoder_source.reset(new GpioEventEncoderSource(MOTORA_ENCA_PIN, MOTORB_ENCA_PIN, gpio_chip));
+    }
 
-        // Check if a state change has occurred
-        if (motorA_stateA != motorA_stateA_prev)
-        {
-            piLock(MOTORA_COUNTER_KEY);
-            motorA_Acounter += direction_right;
-            // If the states are different then the encoder is rotating clockwise
-            /*if (digitalRead(MOTORA_ENCB_PIN) != motorA_stateA)
-            {
-                motorA_counter++;
-            }
-            else
-            {
-                motorA_counter--;
-            }*/
-            piUnlock(MOTORA_COUNTER_KEY);
-            motorA_stateA_prev = motorA_stateA;
-        }
+    if (!encoder_source->start())
+    {
+        ROS_ERROR("Could not start encoder source: %s", strerror(errno));
+        return false;
+    }
 
-        delayMicroseconds(30);  // To soften the load on the processor
+    if (!record_file.empty() && !edge_recorder.open(record_file))
+    {
+        ROS_ERROR("Could not open encoder record file %s", record_file.c_str());
     }
+    return true;
 }
 
-PI_THREAD(motorB_encoder)
+// Blocks on edge events from both wheels, so the thread sleeps while the wheels are stopped
+void encoderEdgeThread()
 {
-    ROS_INFO("Thread B started!");
-
-    while (1)
+    ROS_INFO("Encoder edge thread started!");
+    EncoderEdge edge;
+    while (running.load() && ros::ok() && !encoder_source->finished())
     {
-        motorB_stateA = digitalRead(MOTORB_ENCA_PIN);
-
-        // Check if a state change has occurred
-        if (motorB_stateA != motorB_stateA_prev)
+        if (!encoder_source->waitForEdge(edge, EDGE_TIMEOUT_MS))
         {
-            piLock(MOTORB_COUNTER_KEY);
-            motorB_Acounter += direction_left;
-            // If the states are different then the encoder is rotating clockwise
-           /* if (digitalRead(MOTORB_ENCB_PIN) != motorB_stateA)
-            {
-                motorB_counter++;
-            }
-            else
-            {
-                motorB_counter--;
-            }*/
-            piUnlock(MOTORB_COUNTER_KEY);
-            motorB_stateA_prev = motorB_stateA;
+            continue;
         }
 
-        delayMicroseconds(30);  // To soften the load on the processor
+        edge_recorder.record(edge);
+
+        if (edge.channel == ENCODER_RIGHT)
+        {
+            right_ticks.addEdge(edge.timestamp_ns);
+        }
+        else
+        {
+            left_ticks.addEdge(edge.timestamp_ns);
+        }
     }
+    ROS_INFO("Encoder edge thread stopped");
 }
 
 void motorCallback(const bill_msgs::MotorDirection::ConstPtr& msg)
 {
-    piLock(MOTORA_COUNTER_KEY);
-    piLock(MOTORB_COUNTER_KEY);
-    direction_left = msg->left_motor;
-    direction_right = msg->right_motor;
-    piUnlock(MOTORA_COUNTER_KEY);
-    piUnlock(MOTORB_COUNTER_KEY);
+    left_ticks.setDirection(msg->left_motor);
+    right_ticks.setDirection(msg->right_motor);
 }
 
 void positionCallback(const bill_msgs::Position::ConstPtr& msg)
@@ -115,52 +115,52 @@ void positionCallback(const bill_msgs::Position::ConstPtr& msg)
     theta = angles::from_degrees(msg->heading);
 }
 
-nav_msgs::Odometry calculateOdometry(float dt)
+nav_msgs::OdometryPtr calculateOdometry(uint64_t now_ns)
 {
     // TODO: Account and determine slip coeff, radius inequalities and wheelbase errors
-    piLock(MOTORA_COUNTER_KEY);
-    piLock(MOTORB_COUNTER_KEY);
-    int delta_right = motorA_Acounter - motorA_counter_prev;
-    int delta_left = motorB_Acounter - motorB_counter_prev;
+    int delta_right = right_ticks.takeDelta();
+    int delta_left = left_ticks.takeDelta();
     ROS_INFO("Delta Right: %i, Delta Left: %i", delta_right, delta_left);
-    motorA_Acounter = 0;
-    motorB_Acounter = 0;
-    motorA_counter_prev = motorA_Acounter;
-    motorB_counter_prev = motorB_Acounter;
-    piUnlock(MOTORA_COUNTER_KEY);
-    piUnlock(MOTORB_COUNTER_KEY);
 
-    float v_right = (delta_right * DIST_PER_TICK / dt) / slip_ratio;
-    float v_left = (delta_left * DIST_PER_TICK / dt) / slip_ratio;
+    // Velocities come from the edge stamps over the time actually elapsed, not the nominal loop period
+    uint64_t window_ns = last_odom_ns > 0 && now_ns > last_odom_ns ? now_ns - last_odom_ns : 0;
+    last_odom_ns = now_ns;
+    float v_right = (right_ticks.ticksPerSecond(now_ns, window_ns) * DIST_PER_TICK) / slip_ratio;
+    float v_left = (left_ticks.ticksPerSecond(now_ns, window_ns) * DIST_PER_TICK) / slip_ratio;
 
     float v_robot = (v_right + v_left) / 2.0;
     float v_th = (v_right - v_left) / WHEEL_BASE;  // rad/s
 
+    // Position is integrated from the exact tick counts, so it doesn't depend on the velocity estimate
+    float d_right = (delta_right * DIST_PER_TICK) / slip_ratio;
+    float d_left = (delta_left * DIST_PER_TICK) / slip_ratio;
+    float d_robot = (d_right + d_left) / 2.0;
+
     float delta_x = 0;
     float delta_y = 0;
 
     if (M_PI_4 < theta && theta <= 3*M_PI_4) // Facing positive y
     {
-        delta_x = v_robot * sin(M_PI_2 - theta) * dt;
-        delta_y = v_robot * cos(M_PI_2 - theta) * dt;
+        delta_x = d_robot * sin(M_PI_2 - theta);
+        delta_y = d_robot * cos(M_PI_2 - theta);
     }
     else if (3*M_PI_4 < theta && theta <= 5*M_PI_4) // Facing negative x
     {
-        delta_x = -v_robot * cos(theta - M_PI) * dt;
-        delta_y = v_robot * sin(theta - M_PI) * dt;
+        delta_x = -d_robot * cos(theta - M_PI);
+        delta_y = d_robot * sin(theta - M_PI);
     }
     else if (5*M_PI_4 < theta && theta <= 7*M_PI_4) // Facing negative y
     {
-        delta_x = v_robot * sin(3*M_PI_2 - theta) * dt;
-        delta_y = -v_robot * cos(3*M_PI_2 - theta) * dt;
+        delta_x = d_robot * sin(3*M_PI_2 - theta);
+        delta_y = -d_robot * cos(3*M_PI_2 - theta);
     }
     else // Facing positive x
     {
-        delta_x = v_robot * cos(theta) * dt;
-        delta_y = v_robot * sin(theta) * dt;
+        delta_x = d_robot * cos(theta);
+        delta_y = d_robot * sin(theta);
     }
 
-    float delta_th = v_th * dt;
+    float delta_th = (d_right - d_left) / WHEEL_BASE;
 
     x += delta_x;
     y += delta_y;
@@ -175,45 +175,56 @@ nav_msgs::Odometry calculateOdometry(float dt)
         theta += 2 * M_PI;
     }*/
 
-    nav_msgs::Odometry msg;
-    msg.header.frame_id = "odom";
-    msg.header.stamp = ros::Time::now();
-    msg.pose.pose.position.x = x;
-    msg.pose.pose.position.y = y;
-    msg.pose.pose.position.z = 0;
-    msg.pose.pose.orientation = tf::createQuaternionMsgFromYaw(theta);
-    msg.pose.covariance = {0.3, 0, 0, 0, 0, 0,
-                           0, 0.3, 0, 0, 0, 0,
-                           0, 0, -1, 0, 0, 0,
-                           0, 0, 0, -1, 0, 0,
-                           0, 0, 0, 0, -1, 0,
-                           0, 0, 0, 0, 0, 0.1};
-    msg.child_frame_id  = "base_link";
-    msg.twist.twist.linear.x = v_robot;
-    msg.twist.twist.linear.y = 0;
-    msg.twist.twist.linear.z = 0;
-    msg.twist.twist.angular.z = v_th;
-    msg.twist.covariance = {0.02, 0, 0, 0, 0, 0,
-                           0, -1, 0, 0, 0, 0,
-                           0, 0, -1, 0, 0, 0,
-                           0, 0, 0, -1, 0, 0,
-                           0, 0, 0, 0, -1, 0,
-                           0, 0, 0, 0, 0, 0.01};
+    // Published as a shared pointer so subscribers in the same nodelet manager get it without a copy
+    nav_msgs::OdometryPtr msg(new nav_msgs::Odometry());
+    msg->header.frame_id = "odom";
+    msg->header.stamp = ros::Time::now();
+    msg->pose.pose.position.x = x;
+    msg->pose.pose.position.y = y;
+    msg->pose.pose.position.z = 0;
+    msg->pose.pose.orientation = tf::createQuaternionMsgFromYaw(theta);
+    msg->pose.covariance = {0.3, 0, 0, 0, 0, 0,
+                            0, 0.3, 0, 0, 0, 0,
+                            0, 0, -1, 0, 0, 0,
+                            0, 0, 0, -1, 0, 0,
+                            0, 0, 0, 0, -1, 0,
+                            0, 0, 0, 0, 0, 0.1};
+    msg->child_frame_id  = "base_link";
+    msg->twist.twist.linear.x = v_robot;
+    msg->twist.twist.linear.y = 0;
+    msg->twist.twist.linear.z = 0;
+    msg->twist.twist.angular.z = v_th;
+    msg->twist.covariance = {0.02, 0, 0, 0, 0, 0,
+                             0, -1, 0, 0, 0, 0,
+                             0, 0, -1, 0, 0, 0,
+                             0, 0, 0, -1, 0, 0,
+                             0, 0, 0, 0, -1, 0,
+                             0, 0, 0, 0, 0, 0.01};
 
     ROS_INFO("Heading: %f", angles::to_degrees(theta));
 
     return msg;
 }
 
-int main(int argc, char** argv)
+void odomTimerCallback(const ros::TimerEvent&)
 {
-    ros::init(argc, argv, "encoder_driver");
-    ros::NodeHandle nh;
-    ros::Publisher odom_pub = nh.advertise<nav_msgs::Odometry>("odometry", 100);
-    ros::Rate loop_rate(LOOP_RATE_ENCODER);
-    ros::Subscriber motor_sub = nh.subscribe("motor_dir", 1, motorCallback);
-    ros::Subscriber position_sub = nh.subscribe("position", 1, positionCallback);
+    nav_msgs::OdometryPtr msg = calculateOdometry(encoder_source->nowNs());
+
+    // Odometry has no trace id field, its stamp is used instead. The newest edge marks when the sample started
+    uint64_t trace_id = msg->header.stamp.toNSec();
+    uint64_t edge_ns = std::max(left_ticks.lastEdgeNs(), right_ticks.lastEdgeNs());
+    if (edge_ns != last_traced_edge_ns)
+    {
+        traceRecord(TRACE_INSTANT, "encoder_edge", trace_id, edge_ns);
+        last_traced_edge_ns = edge_ns;
+    }
+    TraceScope scope("encoder_odometry", trace_id);
+    tracePublish("odometry", trace_id);
+    odom_pub.publish(msg);
+}
 
+bool start(ros::NodeHandle& nh, ros::NodeHandle& private_nh)
+{
     nh.getParam("/bill/starting_params/x", x);
     nh.getParam("/bill/starting_params/y", y);
     float temp_theta;
@@ -222,29 +233,37 @@ int main(int argc, char** argv)
     ROS_INFO("Starting values: x= %f, y=%f, theta=%f, temp_theta=%f", x, y, theta, temp_theta);
 
     // Call sensor setup
-    setup();
-
-    // Setup encoder polling threads
-    int threadA = piThreadCreate(motorA_encoder);
-    if (threadA != 0)
+    if (!setup(private_nh))
     {
-        ROS_ERROR("Thread A did not start!");
+        return false;
     }
 
-    int threadB = piThreadCreate(motorB_encoder);
-    if (threadB != 0)
+    std::string trace_dir;
+    if (nh.getParam("/trace_dir", trace_dir) && !traceOpen(trace_dir, ros::this_node::getName()))
     {
-        ROS_ERROR("Thread B did not start!");
+        ROS_WARN("Could not open a trace file in %s", trace_dir.c_str());
     }
 
-    while (ros::ok())
-    {
-        nav_msgs::Odometry msg = calculateOdometry(loop_rate.expectedCycleTime().toSec());
+    odom_pub = nh.advertise<nav_msgs::Odometry>("odometry", 100);
+    motor_sub = nh.subscribe("motor_dir", 1, motorCallback);
+    position_sub = nh.subscribe("position", 1, positionCallback);
+
+    // Setup encoder edge thread
+    running.store(true);
+    edge_thread = std::thread(encoderEdgeThread);
 
-        // Publish message, and spin thread
-        odom_pub.publish(msg);
-        ros::spinOnce();
-        loop_rate.sleep();
+    odom_timer = nh.createTimer(ros::Duration(1.0 / LOOP_RATE_ENCODER), odomTimerCallback);
+    return true;
+}
+
+void stop()
+{
+    odom_timer.stop();
+    running.store(false);
+    if (edge_thread.joinable())
+    {
+        edge_thread.join();
     }
-    return 0;
+    traceDump();
 }
+}  // namespace encoder_driver
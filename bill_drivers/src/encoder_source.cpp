@@ -0,0 +1,188 @@
+#include "bill_drivers/encoder_source.hpp"
+#include <poll.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <time.h>
+
+GpioEventEncoderSource::GpioEventEncoderSource(int right_pin, int left_pin, const std::string& chip)
+{
+    _pins[ENCODER_RIGHT] = right_pin;
+    _pins[ENCODER_LEFT] = left_pin;
+    _chip = chip;
+    _next_channel = 0;
+}
+
+bool GpioEventEncoderSource::start()
+{
+    return _lines[ENCODER_RIGHT].open(_pins[ENCODER_RIGHT], "encoder_right", _chip) &&
+           _lines[ENCODER_LEFT].open(_pins[ENCODER_LEFT], "encoder_left", _chip);
+}
+
+bool GpioEventEncoderSource::waitForEdge(EncoderEdge& edge, int timeout_ms)
+{
+    struct pollfd pfds[ENCODER_CHANNELS];
+    for (int i = 0; i < ENCODER_CHANNELS; i++)
+    {
+        pfds[i].fd = _lines[i].fd();
+        pfds[i].events = POLLIN | POLLPRI;
+        pfds[i].revents = 0;
+    }
+
+    int ret;
+    do
+    {
+        ret = poll(pfds, ENCODER_CHANNELS, timeout_ms);
+    } while (ret < 0 && errno == EINTR);
+
+    if (ret <= 0)
+    {
+        return false;
+    }
+
+    // Alternate which wheel is serviced first so a fast wheel can't starve the other one's queue
+    for (int i = 0; i < ENCODER_CHANNELS; i++)
+    {
+        int channel = (_next_channel + i) % ENCODER_CHANNELS;
+        GpioEdge gpio_edge;
+        if ((pfds[channel].revents & (POLLIN | POLLPRI)) && _lines[channel].readEdge(gpio_edge))
+        {
+            edge.channel = channel;
+            edge.timestamp_ns = gpio_edge.timestamp_ns;
+            edge.rising = gpio_edge.rising;
+            _next_channel = (channel + 1) % ENCODER_CHANNELS;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t GpioEventEncoderSource::nowNs() const
+{
+    return _lines[ENCODER_RIGHT].nowNs();
+}
+
+ReplayEncoderSource::ReplayEncoderSource(const std::string& path, bool realtime)
+{
+    _path = path;
+    _realtime = realtime;
+    _finished = false;
+    _has_pending = false;
+    _file = NULL;
+    _first_edge_ns = 0;
+    _start_ns = 0;
+}
+
+ReplayEncoderSource::~ReplayEncoderSource()
+{
+    if (_file != NULL)
+    {
+        fclose(_file);
+    }
+}
+
+bool ReplayEncoderSource::start()
+{
+    _file = fopen(_path.c_str(), "r");
+    if (_file == NULL)
+    {
+        return false;
+    }
+
+    _start_ns = monotonicNs();
+    if (readNext())
+    {
+        _first_edge_ns = _pending.timestamp_ns;
+    }
+    return true;
+}
+
+bool ReplayEncoderSource::readNext()
+{
+    uint64_t timestamp;
+    int channel;
+    int rising;
+    while (fscanf(_file, "%" SCNu64 " %i %i", &timestamp, &channel, &rising) == 3)
+    {
+        if (channel < 0 || channel >= ENCODER_CHANNELS)
+        {
+            continue;
+        }
+        _pending.timestamp_ns = timestamp;
+        _pending.channel = channel;
+        _pending.rising = rising != 0;
+        _has_pending = true;
+        return true;
+    }
+
+    _has_pending = false;
+    _finished = true;
+    return false;
+}
+
+bool ReplayEncoderSource::waitForEdge(EncoderEdge& edge, int timeout_ms)
+{
+    if (!_has_pending)
+    {
+        return false;
+    }
+
+    if (_realtime)
+    {
+        // Shift the recording onto our clock so stamps look like they came from the kernel
+        uint64_t due_ns = _start_ns + (_pending.timestamp_ns - _first_edge_ns);
+        uint64_t now_ns = monotonicNs();
+        if (due_ns > now_ns)
+        {
+            uint64_t wait_ns = due_ns - now_ns;
+            if (timeout_ms >= 0 && wait_ns > (uint64_t)timeout_ms * 1000000ull)
+            {
+                struct timespec ts = { timeout_ms / 1000, (timeout_ms % 1000) * 1000000L };
+                nanosleep(&ts, NULL);
+                return false;
+            }
+            struct timespec ts = { (time_t)(wait_ns / 1000000000ull), (long)(wait_ns % 1000000000ull) };
+            nanosleep(&ts, NULL);
+        }
+        edge = _pending;
+        edge.timestamp_ns = due_ns;
+    }
+    else
+    {
+        edge = _pending;
+    }
+
+    readNext();
+    return true;
+}
+
+bool ReplayEncoderSource::finished() const
+{
+    return _finished;
+}
+
+EncoderRecorder::EncoderRecorder()
+{
+    _file = NULL;
+}
+
+EncoderRecorder::~EncoderRecorder()
+{
+    if (_file != NULL)
+    {
+        fclose(_file);
+    }
+}
+
+bool EncoderRecorder::open(const std::string& path)
+{
+    _file = fopen(path.c_str(), "w");
+    return _file != NULL;
+}
+
+void EncoderRecorder::record(const EncoderEdge& edge)
+{
+    if (_file != NULL)
+    {
+        fprintf(_file, "%" PRIu64 " %i %i\n", edge.timestamp_ns, edge.channel, edge.rising ? 1 : 0);
+    }
+}
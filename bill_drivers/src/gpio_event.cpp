@@ -0,0 +1,155 @@
+#include "bill_drivers/gpio_event.hpp"
+#include <linux/gpio.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <sys/utsname.h>
+#include <time.h>
+
+uint64_t monotonicNs()
+{
+    return clockNs(CLOCK_MONOTONIC);
+}
+
+uint64_t clockNs(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+clockid_t gpioEdgeClock()
+{
+    struct utsname name;
+    int major = 0;
+    int minor = 0;
+    if (uname(&name) != 0 || sscanf(name.release, "%i.%i", &major, &minor) != 2)
+    {
+        return CLOCK_MONOTONIC;
+    }
+    return major > 5 || (major == 5 && minor >= 7) ? CLOCK_MONOTONIC : CLOCK_REALTIME;
+}
+
+GpioEventLine::GpioEventLine()
+{
+    _fd = -1;
+    _line = -1;
+    _clock = CLOCK_MONOTONIC;
+}
+
+GpioEventLine::~GpioEventLine()
+{
+    close();
+}
+
+bool GpioEventLine::open(int line, const std::string& consumer, const std::string& chip, GpioEdgeRequest edges)
+{
+    close();
+
+    int chip_fd = ::open(chip.c_str(), O_RDONLY | O_CLOEXEC);
+    if (chip_fd < 0)
+    {
+        return false;
+    }
+
+    struct gpioevent_request req;
+    memset(&req, 0, sizeof(req));
+    req.lineoffset = line;
+    req.handleflags = GPIOHANDLE_REQUEST_INPUT;
+    req.eventflags = edges == GPIO_EDGE_RISING ? GPIOEVENT_REQUEST_RISING_EDGE
+                     : edges == GPIO_EDGE_FALLING ? GPIOEVENT_REQUEST_FALLING_EDGE : GPIOEVENT_REQUEST_BOTH_EDGES;
+    strncpy(req.consumer_label, consumer.c_str(), sizeof(req.consumer_label) - 1);
+
+    int ret = ioctl(chip_fd, GPIO_GET_LINEEVENT_IOCTL, &req);
+    int saved_errno = errno;
+    ::close(chip_fd);
+    if (ret < 0)
+    {
+        errno = saved_errno;
+        return false;
+    }
+
+    _fd = req.fd;
+    _line = line;
+    _clock = gpioEdgeClock();
+    return true;
+}
+
+void GpioEventLine::close()
+{
+    if (_fd >= 0)
+    {
+        ::close(_fd);
+    }
+    _fd = -1;
+    _line = -1;
+}
+
+bool GpioEventLine::isOpen() const
+{
+    return _fd >= 0;
+}
+
+int GpioEventLine::fd() const
+{
+    return _fd;
+}
+
+int GpioEventLine::line() const
+{
+    return _line;
+}
+
+int GpioEventLine::value() const
+{
+    struct gpiohandle_data data;
+    memset(&data, 0, sizeof(data));
+    if (_fd < 0 || ioctl(_fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data) < 0)
+    {
+        return -1;
+    }
+    return data.values[0];
+}
+
+uint64_t GpioEventLine::nowNs() const
+{
+    return clockNs(_clock);
+}
+
+bool GpioEventLine::readEdge(GpioEdge& edge)
+{
+    struct gpioevent_data event;
+    ssize_t n = read(_fd, &event, sizeof(event));
+    if (n != sizeof(event))
+    {
+        return false;
+    }
+
+    edge.timestamp_ns = event.timestamp;
+    edge.rising = (event.id == GPIOEVENT_EVENT_RISING_EDGE);
+    return true;
+}
+
+bool GpioEventLine::waitForEdge(GpioEdge& edge, int timeout_ms)
+{
+    struct pollfd pfd;
+    pfd.fd = _fd;
+    pfd.events = POLLIN | POLLPRI;
+    pfd.revents = 0;
+
+    int ret;
+    do
+    {
+        ret = poll(&pfd, 1, timeout_ms);
+    } while (ret < 0 && errno == EINTR);
+
+    if (ret <= 0)
+    {
+        return false;
+    }
+    return readEdge(edge);
+}
@@ -1,354 +1,269 @@
 #include "ros/ros.h"
-#include "std_msgs/Float32.h"
 #include "nav_msgs/Odometry.h"
+#include "sensor_msgs/Imu.h"
 #include "bill_msgs/MotorCommands.h"
 #include "bill_msgs/Position.h"
+#include "bill_msgs/Ranges.h"
 #include "tf/transform_datatypes.h"
 #include "angles/angles.h"
 #include "bill_drivers/constant_definition.hpp"
-#include "bill_drivers/filters.hpp"
+#include "bill_drivers/ekf.hpp"
+#include "bill_drivers/driver_nodes.hpp"
+#include "bill_drivers/trace.hpp"
+#include "bill_drivers/arena_map.hpp"
 #include <limits>
-#include <chrono>
 #include <math.h>
 
+// Fuses encoder odometry, IMU yaw and the side ultrasonics in one EKF, updated as each sensor's message arrives
+
+namespace localization_node
+{
 const float TOL = 0.05; // TODO: Determine appropriate range
-const float COURSE_DIM = 1.85;
 const float ROBOT_WIDTH = 7.0 * 0.0254;
-const float ROBOT_LENGTH = 0.26;
-const int buffer_size = 5;
 
-struct Position
-{
-    Position(float xin, float yin): x(xin), y(yin){};
-    float x;
-    float y;
-};
+// Wall to wall, m. Read from the arena map
+float course_width = 1.85;
+float course_height = 1.85;
+
+// Noise model, overridable by private params
+double odom_distance_noise = 0.01;  // Variance per metre travelled, m^2/m
+double odom_heading_noise = 0.05;   // Variance per radian turned, rad^2/rad
+double odom_min_variance = 1e-6;    // Floor per step so a stopped robot still gets a little process noise
+double imu_yaw_variance = 0.001;    // Used when the imu message doesn't carry a yaw variance
+double side_variance = 0.0004;      // 2 cm standard deviation
+double gate = 9.0;                  // Chi square, 1 dof, 3 sigma
 
-//float front_dist = 0;
-//float prev_front_dist = -1;
 float right_dist = 0;
 float left_dist = 0;
 
-//auto last_comp_msg = std::chrono::high_resolution_clock::now();
-//bool first_comp_msg = true;
-
-Position odom_pos(1.05, 0.15);
-Position odom_pos_prev(1.05, 0.15);
-Position ultra_pos(1.05, 0.15);
-float side_buffer[buffer_size] = {0};
-int buffer_counter = 0;
+PoseEkf ekf;
 int current_heading = 90;
 bool turning = false;
-//ComplementaryFilter comp_filter_x(2.0); // TODO: figure out frequency
-//ComplementaryFilter comp_filter_y(2.0); // TODO: figure out frequency
+bool have_odom = false;
+nav_msgs::Odometry last_odom;
 ros::Publisher position_pub;
-//ros::Publisher odom_ultra_pub;
+ros::Publisher fused_odom_pub;
+ros::Subscriber sub_ranges;
+ros::Subscriber sub_imu;
+ros::Subscriber sub_motors;
+ros::Subscriber sub_encoders;
 
 float cosDegrees(int angle)
 {
     return std::cos(angles::from_degrees(angle));
 }
 
-void publishPosition()
+// The trace id of the measurement that caused the update is passed on, so later stages can be tied back to it
+void publishPosition(const ros::Time& stamp, uint64_t trace_id)
 {
-    bill_msgs::Position msg;
-    msg.heading = current_heading;
-    msg.x = ultra_pos.x;
-    msg.y = ultra_pos.y;
-    position_pub.publish(msg);
-/*
-    nav_msgs::Odometry msg_odom;
-    msg_odom.header.stamp = ros::Time::now();
-    msg_odom.header.frame_id = "odom";
-    msg_odom.pose.pose.position.x = ultra_pos.x;
-    msg_odom.pose.pose.position.y = ultra_pos.y;
-    if ((45 < current_heading && current_heading <= 135) || (225 < current_heading && current_heading <= 315)) // Facing y
-    {
-        msg_odom.pose.covariance = {0.02, 0, 0, 0, 0, 0,
-                                    0, 0.05, 0, 0, 0, 0,
-                                    0, 0, -1, 0, 0, 0,
-                                    0, 0, 0, -1, 0, 0,
-                                    0, 0, 0, 0, -1, 0,
-                                    0, 0, 0, 0, 0, -1};
-    }
-    else
+    current_heading = (int)round(angles::to_degrees(ekf.theta()));
+    if (current_heading < 0)
     {
-        msg_odom.pose.covariance = {0.05, 0, 0, 0, 0, 0,
-                                    0, 0.02, 0, 0, 0, 0,
-                                    0, 0, -1, 0, 0, 0,
-                                    0, 0, 0, -1, 0, 0,
-                                    0, 0, 0, 0, -1, 0,
-                                    0, 0, 0, 0, 0, -1};
+        current_heading += 360;
     }
-    odom_ultra_pub.publish(msg_odom);
-    */
-}
 
-void updatePosition()
-{
-/*
-    auto time_now = std::chrono::high_resolution_clock::now();
-    if (!first_comp_msg)
-    {
-        comp_filter_x.setSamplingTime(std::chrono::duration<float>(time_now - last_comp_msg).count());
-        comp_filter_y.setSamplingTime(std::chrono::duration<float>(time_now - last_comp_msg).count());
-        //ultra_pos.x = comp_filter_x.update(odom_pos.x, ultra_pos.x);
-        //ultra_pos.y = comp_filter_y.update(odom_pos.y, ultra_pos.y);
-        // TODO: re-update ultra pos with filtered values?
-        //ROS_INFO("Current filtered position x: %f, y: %f", x, y);
-    }
-    else
-    {
-        comp_filter_x.setPrevOutput(odom_pos.x, ultra_pos.x); // Reset filter to maintain continuity
-        comp_filter_y.setPrevOutput(odom_pos.y, ultra_pos.y);
-        first_comp_msg = false;
-    }
+    // Published as shared pointers so subscribers in the same nodelet manager get them without a copy
+    bill_msgs::PositionPtr msg(new bill_msgs::Position());
+    msg->heading = current_heading;
+    msg->x = ekf.x();
+    msg->y = ekf.y();
+    msg->trace_id = trace_id;
+    tracePublish("position", trace_id);
+    position_pub.publish(msg);
 
-    last_comp_msg = time_now;
-*/
-    // Check if an update in side position can be performed
-    // Average the buffer
-    if(!turning)
+    nav_msgs::OdometryPtr msg_odom(new nav_msgs::Odometry());
+    msg_odom->header.stamp = stamp;
+    msg_odom->header.frame_id = "odom";
+    msg_odom->child_frame_id = "base_link";
+    msg_odom->pose.pose.position.x = ekf.x();
+    msg_odom->pose.pose.position.y = ekf.y();
+    msg_odom->pose.pose.orientation = tf::createQuaternionMsgFromYaw(ekf.theta());
+    const int index[PoseEkf::N] = {0, 1, 5};  // x, y and yaw in the 6x6 pose covariance
+    for (int r = 0; r < PoseEkf::N; r++)
     {
-        float sum = 0;
-        for (int i = 0; i < buffer_size; i++)
-        {
-            sum += side_buffer[i];
-        }
-        float average = sum / buffer_size;
-
-        // Check the max variance, if it exceeds a certain threshold, get don't update the estimate
-        bool side_update = true;
-        for (int i = 0; i < buffer_size; i++) {
-            if (std::abs(average - side_buffer[i]) > TOL || side_buffer[i] == 0) {
-                side_update = false;
-                break;
-            }
-        }
-
-        if ((45 < current_heading && current_heading <= 135) ||
-            (225 < current_heading && current_heading <= 315)) // Facing y
+        for (int c = 0; c < PoseEkf::N; c++)
         {
-            ultra_pos.y += odom_pos.y - odom_pos_prev.y;
-            odom_pos_prev.y = odom_pos.y; // Set to current so next time this loop is called the delta will be zero if no new data
-            if (side_update && ultra_pos.x != average) {
-                ROS_INFO("Ultrasonic side update X position from %f, to %f", ultra_pos.x, average);
-                ultra_pos.x = average;
-            }
-        } else {
-            ultra_pos.x += odom_pos.x - odom_pos_prev.x;
-            odom_pos_prev.x = odom_pos.x; // Set to current so next time this loop is called the delta will be zero if no new data
-            if (side_update && ultra_pos.y != average) {
-                ROS_INFO("Ultrasonic side update Y position from %f, to %f", ultra_pos.y, average);
-                ultra_pos.y = average;
-            }
+            msg_odom->pose.covariance[index[r] * 6 + index[c]] = ekf.covariance(r, c);
         }
-    } else {
-        // If we are turning, update all axis' using odometry
-        ultra_pos.y += odom_pos.y - odom_pos_prev.y;
-        ultra_pos.x += odom_pos.x - odom_pos_prev.x;
     }
-    ROS_INFO("Current ultrasonic position x: %f, y: %f, Heading: %i, Turning: %i", ultra_pos.x, ultra_pos.y, current_heading, turning);
-    publishPosition();
+    fused_odom_pub.publish(msg_odom);
 }
 
-void updateSideDist()
+// Turns the left and right wall distances into a measurement of the position across the corridor.
+// Returns false if the pair doesn't add up to the course width, i.e. one side is seeing an obstacle
+bool sideMeasurement(PoseEkf::State& axis, float& position)
 {
     if (45 < current_heading && current_heading <= 135) // Facing positive y
     {
-        float expected_dist = COURSE_DIM / cosDegrees(90 - current_heading) - ROBOT_WIDTH;
-        if (std::abs(expected_dist - (right_dist + left_dist)) < 2*TOL) // Distance is valid, update pos
-        {
-            side_buffer[buffer_counter] = (left_dist * cosDegrees(90 - current_heading) + (COURSE_DIM - right_dist * cosDegrees(90 - current_heading))) / 2.0; // Average * cos(theta)
-            buffer_counter = (buffer_counter + 1) % buffer_size;
-        }
+        float expected_dist = course_width / cosDegrees(90 - current_heading) - ROBOT_WIDTH;
+        axis = PoseEkf::X;
+        position = (left_dist * cosDegrees(90 - current_heading) + (course_width - right_dist * cosDegrees(90 - current_heading))) / 2.0; // Average * cos(theta)
+        return std::abs(expected_dist - (right_dist + left_dist)) < 2*TOL;
     }
     else if (135 < current_heading && current_heading <= 225) // Facing negative x
     {
-        float expected_dist = COURSE_DIM / cosDegrees(current_heading - 180) - ROBOT_WIDTH;
-        if (std::abs(expected_dist - (right_dist + left_dist)) < 2*TOL) // Distance is valid, update pos
-        {
-            side_buffer[buffer_counter] = (left_dist * cosDegrees(current_heading - 180) + (COURSE_DIM - right_dist * cosDegrees(current_heading - 180))) / 2.0; // Average * cos(theta)
-            buffer_counter = (buffer_counter + 1) % buffer_size;
-        }
+        float expected_dist = course_height / cosDegrees(current_heading - 180) - ROBOT_WIDTH;
+        axis = PoseEkf::Y;
+        position = (left_dist * cosDegrees(current_heading - 180) + (course_height - right_dist * cosDegrees(current_heading - 180))) / 2.0; // Average * cos(theta)
+        return std::abs(expected_dist - (right_dist + left_dist)) < 2*TOL;
     }
     else if (225 < current_heading && current_heading <= 315) // Facing negative y
     {
-        float expected_dist = COURSE_DIM / cosDegrees(270 - current_heading) - ROBOT_WIDTH;
-        if (std::abs(expected_dist - (right_dist + left_dist)) < 2*TOL) // Distance is valid, update pos
-        {
-            side_buffer[buffer_counter] = ((COURSE_DIM - left_dist * cosDegrees(270 - current_heading)) + right_dist * cosDegrees(270 - current_heading)) / 2.0; // Average * cos*(theta)
-            buffer_counter = (buffer_counter + 1) % buffer_size;
-        }
+        float expected_dist = course_width / cosDegrees(270 - current_heading) - ROBOT_WIDTH;
+        axis = PoseEkf::X;
+        position = ((course_width - left_dist * cosDegrees(270 - current_heading)) + right_dist * cosDegrees(270 - current_heading)) / 2.0; // Average * cos*(theta)
+        return std::abs(expected_dist - (right_dist + left_dist)) < 2*TOL;
     }
     else // Facing positive x
     {
-        float expected_dist = COURSE_DIM / cosDegrees(current_heading) - ROBOT_WIDTH;
-        if (std::abs(expected_dist - (right_dist + left_dist)) < 2*TOL) // Distance is valid, update pos
-        {
-            side_buffer[buffer_counter] = ((COURSE_DIM - left_dist * cosDegrees(current_heading)) + right_dist * cosDegrees(current_heading)) / 2.0; // Average * cos*(theta)
-            buffer_counter = (buffer_counter + 1) % buffer_size;
-        }
+        float expected_dist = course_height / cosDegrees(current_heading) - ROBOT_WIDTH;
+        axis = PoseEkf::Y;
+        position = ((course_height - left_dist * cosDegrees(current_heading)) + right_dist * cosDegrees(current_heading)) / 2.0; // Average * cos*(theta)
+        return std::abs(expected_dist - (right_dist + left_dist)) < 2*TOL;
     }
-
-    // We could say that if there is an obstacle then we add the delta position in whichever direction from the encoders
-    // But since we are always travelling parallel to the walls it should not make a huge difference.
-
-    updatePosition();
 }
-/*
-void updateFrontDist()
+
+// Left and right are read in the same ultrasonic cycle and interpolated to the same time, so each pair is fused once
+void rangesCallback(const bill_msgs::Ranges::ConstPtr& msg)
 {
-    // If current_ultra_pos + front_dist == expected_vale +- TOL then use absolute positioning
-    // y = 1.8 - front_pos - robot_length/2.0;
-    // else then use relative positioning (could find a datum or something) but currently do this
-    // y = ultra_pos + (last_front_dist - front_dist)
+    TraceScope scope("localization_ranges", msg->trace_id);
+    traceReceive("ultra_ranges", msg->trace_id);
+    if (turning)
+    {
+        return;
+    }
 
-    if (45 < current_heading && current_heading <= 135) // Facing positive y
+    float left = std::numeric_limits<float>::quiet_NaN();
+    float right = std::numeric_limits<float>::quiet_NaN();
+    for (size_t i = 0; i < msg->names.size() && i < msg->ranges.size(); i++)
     {
-        float expected_dist = (COURSE_DIM - ultra_pos.y) / cosDegrees(90 - current_heading) - ROBOT_LENGTH / 2.0;
-        if (std::abs(expected_dist - front_dist) < TOL) // If expected, use absolute positioning
+        if (msg->names[i] == "left")
         {
-            ultra_pos.y = COURSE_DIM - front_dist * cosDegrees(90 - current_heading) - ROBOT_LENGTH / 2.0;
+            left = msg->ranges[i];
         }
-        else if (prev_front_dist > 0)// Use relative positioning, if we have previous measurement
+        else if (msg->names[i] == "right")
         {
-            ultra_pos.y += (prev_front_dist - front_dist) * cosDegrees(90 - current_heading);
+            right = msg->ranges[i];
         }
     }
-    else if (135 < current_heading && current_heading <= 225) // Facing negative x
+
+    if (std::isnan(left) || std::isnan(right))
     {
-        float expected_dist = ultra_pos.x / cosDegrees(current_heading - 180) - ROBOT_LENGTH / 2.0;
-        if (std::abs(expected_dist - front_dist) < TOL) // If expected, use absolute positioning
-        {
-            ultra_pos.x = front_dist * cosDegrees(current_heading - 180) + ROBOT_LENGTH / 2.0;
-        }
-        else if (prev_front_dist > 0)// Use relative positioning, if we have previous measurement
-        {
-            ultra_pos.x -= (prev_front_dist - front_dist) * cosDegrees(current_heading - 180);
-        }
+        return;
     }
-    else if (225 < current_heading && current_heading <= 315) // Facing negative y
+    left_dist = left / 100.0;
+    right_dist = right / 100.0;
+
+    PoseEkf::State axis;
+    float position;
+    if (!sideMeasurement(axis, position))
     {
-        float expected_dist = ultra_pos.y / cosDegrees(270 - current_heading) - ROBOT_LENGTH / 2.0;
-        if (std::abs(expected_dist - front_dist) < TOL) // If expected, use absolute positioning
-        {
-            ultra_pos.y = front_dist * cosDegrees(270 - current_heading) + ROBOT_LENGTH / 2.0;
-        }
-        else if (prev_front_dist > 0)// Use relative positioning, if we have previous measurement
-        {
-            ultra_pos.y -= (prev_front_dist - front_dist) * cosDegrees(270 - current_heading);
-        }
+        return;
     }
-    else // Facing positive x
+    if (!ekf.updatePosition(axis, position, side_variance, gate))
     {
-        float expected_dist = (COURSE_DIM - ultra_pos.x) / cosDegrees(current_heading) - ROBOT_LENGTH / 2.0;
-        if (std::abs(expected_dist - front_dist) < TOL) // If expected, use absolute positioning
-        {
-            ultra_pos.x = COURSE_DIM - front_dist * cosDegrees(current_heading) - ROBOT_LENGTH / 2.0;
-        }
-        else if (prev_front_dist > 0)// Use relative positioning, if we have previous measurement
-        {
-            ultra_pos.x += (prev_front_dist - front_dist) * cosDegrees(current_heading);
-        }
+        ROS_WARN("Rejected ultrasonic side update of %c to %f", axis == PoseEkf::X ? 'x' : 'y', position);
+        return;
     }
-
-    prev_front_dist = front_dist;
-    updatePosition();
+    publishPosition(msg->header.stamp, msg->trace_id);
 }
 
-void frontUltrasonicCallback(const std_msgs::Float32::ConstPtr& msg)
-{
-    front_dist = msg->data / 100.0;
-    if (!turning)
-        updateFrontDist();
-}
-*/
-void leftUltrasonicCallback(const std_msgs::Float32::ConstPtr& msg)
+void imuCallback(const sensor_msgs::Imu::ConstPtr& msg)
 {
-    if (!turning)
+    uint64_t trace_id = msg->header.stamp.toNSec();
+    TraceScope scope("localization_imu", trace_id);
+    traceReceive("imu", trace_id);
+    double variance = msg->orientation_covariance[8] > 0 ? msg->orientation_covariance[8] : imu_yaw_variance;
+    if (ekf.updateHeading(tf::getYaw(msg->orientation), variance, gate))
     {
-        left_dist = msg->data / 100.0;
-        updateSideDist();
+        publishPosition(msg->header.stamp, trace_id);
     }
 }
 
-void rightUltrasonicCallback(const std_msgs::Float32::ConstPtr& msg)
+// The encoder driver integrates position with the heading we publish, so only the distance travelled is taken from
+// it. The turn comes from the wheel speed difference
+void odometryCallback(const nav_msgs::Odometry::ConstPtr& msg)
 {
-    if (!turning)
+    uint64_t trace_id = msg->header.stamp.toNSec();
+    TraceScope scope("localization_odometry", trace_id);
+    traceReceive("odometry", trace_id);
+    if (!have_odom)
     {
-        right_dist = msg->data / 100.0;
-        updateSideDist();
+        last_odom = *msg;
+        have_odom = true;
+        return;
     }
-}
 
-void fusedOdometryCallback(const nav_msgs::Odometry::ConstPtr& msg)
-{
-    current_heading = (int)round(angles::to_degrees(tf::getYaw(msg->pose.pose.orientation)));
-    if(current_heading < 0)
+    double dx = msg->pose.pose.position.x - last_odom.pose.pose.position.x;
+    double dy = msg->pose.pose.position.y - last_odom.pose.pose.position.y;
+    double dt = (msg->header.stamp - last_odom.header.stamp).toSec();
+    last_odom = *msg;
+    if (dt <= 0)
     {
-        current_heading += 360;
+        return;
     }
-    updatePosition();
-}
 
-void odometryCallback(const nav_msgs::Odometry::ConstPtr& msg)
-{
-    if (!turning)
+    double distance = std::sqrt(dx * dx + dy * dy);
+    if (msg->twist.twist.linear.x < 0)
     {
-        odom_pos_prev.x = odom_pos.x;
-        odom_pos_prev.y = odom_pos.y;
-        odom_pos.x = msg->pose.pose.position.x;
-        odom_pos.y = msg->pose.pose.position.y;
-        updatePosition();
+        distance = -distance;
     }
+    double delta_theta = msg->twist.twist.angular.z * dt;
+
+    ekf.predict(distance, delta_theta, odom_min_variance + odom_distance_noise * std::abs(distance),
+                odom_min_variance + odom_heading_noise * std::abs(delta_theta));
+    publishPosition(msg->header.stamp, trace_id);
 }
 
 void motorCallback(const bill_msgs::MotorCommands::ConstPtr& msg)
 {
     ROS_INFO("Received motor cmd");
-    if (msg->command == bill_msgs::MotorCommands::TURN)
+    turning = (msg->command == bill_msgs::MotorCommands::TURN);
+}
+
+bool start(ros::NodeHandle& nh, ros::NodeHandle& private_nh)
+{
+    private_nh.getParam("odom_distance_noise", odom_distance_noise);
+    private_nh.getParam("odom_heading_noise", odom_heading_noise);
+    private_nh.getParam("imu_yaw_variance", imu_yaw_variance);
+    private_nh.getParam("side_variance", side_variance);
+    private_nh.getParam("gate", gate);
+
+    float start_x = 1.05;
+    float start_y = 0.15;
+    nh.getParam("/bill/starting_params/x", start_x);
+    nh.getParam("/bill/starting_params/y", start_y);
+    nh.getParam("/bill/starting_params/theta", current_heading);
+
+    ArenaMap arena;
+    if (arena.load(nh))
     {
-        turning = true;
+        course_width = arena.courseWidth();
+        course_height = arena.courseHeight();
     }
-    else
+    std::string trace_dir;
+    if (nh.getParam("/trace_dir", trace_dir) && !traceOpen(trace_dir, ros::this_node::getName()))
     {
-        if (turning) // Was just turning but has now stopped, then reset the filters and clear previous distances
-        {
-            //first_comp_msg = true;
-            for (int i = 0; i < buffer_size; i++)
-            {
-                side_buffer[i] = 0;
-            }
-            buffer_counter = 0;
-            //prev_front_dist = -1;
-
-        }
-        turning = false;
+        ROS_WARN("Could not open a trace file in %s", trace_dir.c_str());
     }
-}
 
-int main(int argc, char** argv)
-{
-    ros::init(argc, argv, "localization_node");
-    ros::NodeHandle nh;
-    //ros::Subscriber sub_front = nh.subscribe("ultra_front", 10, frontUltrasonicCallback);
-    ros::Subscriber sub_left = nh.subscribe("ultra_left", 10, leftUltrasonicCallback);
-    ros::Subscriber sub_right = nh.subscribe("ultra_right", 10, rightUltrasonicCallback);
-    ros::Subscriber sub_odom = nh.subscribe("fused_odometry", 10, fusedOdometryCallback);
-    ros::Subscriber sub_motors = nh.subscribe("motor_cmd", 10, motorCallback);
-    ros::Subscriber sub_encoders = nh.subscribe("odometry", 1, odometryCallback);
-    position_pub = nh.advertise<bill_msgs::Position>("position", 100);
-    //odom_ultra_pub = nh.advertise<nav_msgs::Odometry>("odometry_ultra", 100);
+    ekf.reset(start_x, start_y, angles::from_degrees(current_heading), side_variance, imu_yaw_variance);
 
-    nh.getParam("/bill/starting_params/x", ultra_pos.x);
-    nh.getParam("/bill/starting_params/y", ultra_pos.y);
-    nh.getParam("/bill/starting_params/theta", current_heading);
-    odom_pos.x = ultra_pos.x;
-    odom_pos.y = ultra_pos.y;
-    odom_pos_prev.x = ultra_pos.x;
-    odom_pos_prev.y = ultra_pos.y;
+    sub_ranges = nh.subscribe("ultra_ranges", 10, rangesCallback);
+    sub_imu = nh.subscribe("imu", 10, imuCallback);
+    sub_motors = nh.subscribe("motor_cmd", 10, motorCallback);
+    sub_encoders = nh.subscribe("odometry", 10, odometryCallback);
+    position_pub = nh.advertise<bill_msgs::Position>("position", 100);
+    fused_odom_pub = nh.advertise<nav_msgs::Odometry>("fused_odometry", 100);
+    return true;
+}
 
-    ros::spin();
-    return 0;
+void stop()
+{
+    sub_ranges.shutdown();
+    sub_imu.shutdown();
+    sub_motors.shutdown();
+    sub_encoders.shutdown();
+    traceDump();
 }
+}  // namespace localization_node
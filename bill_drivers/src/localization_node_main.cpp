@@ -0,0 +1,17 @@
+#include "ros/ros.h"
+#include "bill_drivers/driver_nodes.hpp"
+
+int main(int argc, char** argv)
+{
+    ros::init(argc, argv, "localization_node");
+    ros::NodeHandle nh;
+    ros::NodeHandle private_nh("~");
+
+    if (!localization_node::start(nh, private_nh))
+    {
+        return 1;
+    }
+    ros::spin();
+    localization_node::stop();
+    return 0;
+}
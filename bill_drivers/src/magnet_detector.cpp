@@ -0,0 +1,86 @@
+#include "bill_drivers/magnet_detector.hpp"
+#include <algorithm>
+
+// Long enough to outvote single noisy samples, short enough to catch the magnet while driving over it
+static const float WINDOW_SECONDS = 0.02;
+// An odd window with a real middle, and at least one sample each side of it at low rates
+static const int MIN_WINDOW = 3;
+// Time constant of the ambient field estimate
+static const float BASELINE_SECONDS = 2.0;
+
+MagnetDetector::MagnetDetector(float sample_rate, float rise, float release)
+    : _window(std::max(MIN_WINDOW, (int)(WINDOW_SECONDS * sample_rate + 0.5f)) | 1),
+      _sorted(_window.size()),
+      _baseline_alpha(std::min(1.0f, 1.0f / (BASELINE_SECONDS * sample_rate))),
+      _rise(rise),
+      _release(release)
+{
+    reset();
+}
+
+bool MagnetDetector::update(float magnitude)
+{
+    _window[_next] = magnitude;
+    _next = (_next + 1) % _window.size();
+    _filled = std::min(_filled + 1, _window.size());
+
+    // A step shows once it fills half the window plus one, 3 samples (15 ms) at 200 Hz
+    std::copy(_window.begin(), _window.begin() + _filled, _sorted.begin());
+    std::vector<float>::iterator middle = _sorted.begin() + _filled / 2;
+    std::nth_element(_sorted.begin(), middle, _sorted.begin() + _filled);
+    _level = *middle;
+
+    if (_filled < _window.size())
+    {
+        return false;
+    }
+    if (!_has_baseline)
+    {
+        _baseline = _level;
+        _has_baseline = true;
+        return false;
+    }
+
+    bool was_present = _present;
+    if (_present)
+    {
+        _present = _level - _baseline >= _release;
+    }
+    else
+    {
+        _present = _level - _baseline >= _rise;
+    }
+
+    // The ambient estimate holds while the magnet is there, or it would soak the magnet up
+    if (!_present)
+    {
+        _baseline += _baseline_alpha * (_level - _baseline);
+    }
+    return _present != was_present;
+}
+
+bool MagnetDetector::present() const
+{
+    return _present;
+}
+
+float MagnetDetector::level() const
+{
+    return _level;
+}
+
+float MagnetDetector::baseline() const
+{
+    return _baseline;
+}
+
+void MagnetDetector::reset()
+{
+    std::fill(_window.begin(), _window.end(), 0.0f);
+    _next = 0;
+    _filled = 0;
+    _level = 0;
+    _baseline = 0;
+    _has_baseline = false;
+    _present = false;
+}
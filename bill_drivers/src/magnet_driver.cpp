@@ -1,10 +1,16 @@
 #include "bill_drivers/MPU9250_Passthru.h"
 #include "ros/ros.h"
 #include "bill_drivers/constant_definition.hpp"
+#include "bill_drivers/gpio_event.hpp"
+#include "bill_drivers/magnet_detector.hpp"
 #include "std_msgs/Bool.h"
 #include <wiringPi.h>
 #include <stdio.h>
+#include <atomic>
 #include <cmath>
+#include <memory>
+#include <string>
+#include <thread>
 
 static const MPUIMU::Gscale_t  GSCALE    = MPUIMU::GFS_250DPS;
 static const MPUIMU::Ascale_t  ASCALE    = MPUIMU::AFS_2G;
@@ -14,11 +20,23 @@ static const uint8_t SAMPLE_RATE_DIVISOR = 0x04;
 
 static MPU9250_Passthru imu(ASCALE, GSCALE, MSCALE, MMODE, SAMPLE_RATE_DIVISOR);
 
-bool prev_magnet_state = false;
-bool magnet_state = false;
-float mag_threshold;
+// Samples per second queued by the MPU, 1 kHz/(1 + SAMPLE_RATE_DIVISOR)
+static const float SAMPLE_RATE = 1000.0 / (1 + SAMPLE_RATE_DIVISOR);
+// Data ready pulses once per sample, a timeout only happens if one is missed
+static const int INT_TIMEOUT_MS = 100;
 
-void setup()
+// event: a thread woken by the INT pin drains the FIFO as each sample lands
+// stream: drains the FIFO at LOOP_RATE_MAGNET
+// poll: reads the magnetometer registers at LOOP_RATE_MAGNET
+std::string mode = "event";
+std::unique_ptr<MagnetDetector> detector;
+static ImuSampleBatch batch;
+GpioEventLine int_line;
+std::thread acquisition_thread;
+std::atomic<bool> running(false);
+ros::Publisher food_pub;
+
+void setup(const ros::NodeHandle& private_nh)
 {
     // Setup WiringPi
     wiringPiSetupGpio();
@@ -44,45 +62,105 @@ void setup()
     // Comment out if using pre-measured, pre-stored offset magnetometer biases
     //printf("Mag Calibration: Wave device in a figure eight until done!\n");
     //imu.calibrateMagnetometer();
+
+    if (mode == "poll")
+    {
+        return;
+    }
+    if (!imu.startStreaming())
+    {
+        ROS_WARN("The I2C backend can't burst read the MPU FIFO, polling the magnetometer instead");
+        mode = "poll";
+        return;
+    }
+
+    std::string gpio_chip = DEFAULT_GPIO_CHIP;
+    private_nh.getParam("gpio_chip", gpio_chip);
+    if (mode == "event" && !int_line.open(MPU_INT_PIN, "mpu_int", gpio_chip, GPIO_EDGE_RISING))
+    {
+        ROS_WARN("Could not request MPU INT pin %i, streaming at the loop rate instead", MPU_INT_PIN);
+        mode = "stream";
+    }
 }
 
-std_msgs::Bool isMagnetPresent() {
-    // Detect magnet
+void updateDetector(float mx, float my, float mz)
+{
+    if (!detector->update(sqrt(mx*mx + my*my + mz*mz)))
+    {
+        return;
+    }
+    //  Only publish a state change
+    ROS_INFO("Magnet %s, field %f over ambient %f", detector->present() ? "found" : "lost", detector->level(),
+             detector->baseline());
     std_msgs::Bool msg;
-    msg.data = false;
-    float mx, my, mz, mtotal;
-    if (imu.checkNewMagData()) 
+    msg.data = detector->present();
+    food_pub.publish(msg);
+}
+
+void readSamples()
+{
+    if (mode == "poll")
     {
-        imu.readMagnetometer(mx, my, mz);
-        mtotal = sqrt(mx*mx + my*my + mz*mz);
-        ROS_INFO("New Mag Data: X: %f Y: %f Z: %f, Total: %f", mx, my, mz, mtotal);
-        msg.data = (mtotal >= mag_threshold);
+        float mx, my, mz;
+        if (imu.checkNewMagData())
+        {
+            imu.readMagnetometer(mx, my, mz);
+            updateDetector(mx, my, mz);
+        }
+        return;
+    }
+
+    imu.readBatch(batch, monotonicNs());
+    for (int i = 0; i < batch.count; i++)
+    {
+        updateDetector(batch.mx[i], batch.my[i], batch.mz[i]);
     }
-    magnet_state = msg.data;
-    return msg;
 }
 
+void acquisitionThread()
+{
+    ROS_INFO("Magnet acquisition thread started!");
+    GpioEdge edge;
+    while (running.load() && ros::ok())
+    {
+        int_line.waitForEdge(edge, INT_TIMEOUT_MS);
+        readSamples();
+    }
+    ROS_INFO("Magnet acquisition thread stopped");
+}
 int main(int argc, char** argv)
 {
     ros::init(argc, argv, "magnet_driver");
     ros::NodeHandle nh;
-    ros::Publisher food_pub = nh.advertise<std_msgs::Bool>("food", 100, true);
-    ros::Rate loop_rate(LOOP_RATE_MAGNET);
-    nh.getParam("/bill/thresholds/magnet", mag_threshold);
+    ros::NodeHandle private_nh("~");
+    food_pub = nh.advertise<std_msgs::Bool>("food", 100, true);
+
+    float rise = 2000;
+    float release = 1000;
+    nh.getParam("/bill/thresholds/magnet_rise", rise);
+    nh.getParam("/bill/thresholds/magnet_release", release);
+    private_nh.getParam("mode", mode);
+    ROS_INFO("Magnet rise: %f, release: %f", rise, release);
+
     // Call sensor setup
-    ROS_INFO("Mag threshold: %f", mag_threshold);
-    setup();
+    setup(private_nh);
+    detector.reset(new MagnetDetector(mode == "poll" ? LOOP_RATE_MAGNET : SAMPLE_RATE, rise, release));
+
+    if (mode == "event")
+    {
+        running = true;
+        acquisition_thread = std::thread(acquisitionThread);
+        ros::spin();
+        running = false;
+        acquisition_thread.join();
+        return 0;
+    }
 
+    ros::Rate loop_rate(LOOP_RATE_MAGNET);
     while (ros::ok())
     {
-        std_msgs::Bool msg = isMagnetPresent();
-        if (magnet_state != prev_magnet_state)
-        {
-            //  Only publish a state change
-            food_pub.publish(msg);
-            ros::spinOnce();
-            prev_magnet_state = magnet_state;
-        }
+        readSamples();
+        ros::spinOnce();
         loop_rate.sleep();
     }
     return 0;
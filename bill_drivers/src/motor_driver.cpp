@@ -5,12 +5,20 @@
 #include "bill_msgs/Position.h"
 #include "bill_msgs/MotorDirection.h"
 #include "wiringPi.h"
-#include <softPwm.h>
 #include "bill_drivers/constant_definition.hpp"
-#include <chrono>
+#include "bill_drivers/periodic_loop.hpp"
+#include "bill_drivers/pwm_output.hpp"
+#include "bill_drivers/seqlock.hpp"
+#include "bill_drivers/trace.hpp"
+#include <atomic>
+#include <memory>
+#include <thread>
 #include <signal.h>
 
 const int PWM_RANGE = 100;  // Max pwm value
+const float PWM_FREQUENCY = 20000;  // Hz, above hearing for the hardware channel
+const double CONTROL_RATE = 200;    // Hz
+const double STATS_PERIOD = 10;     // Seconds between control loop timing reports
 const int MAX_TURN_SPEED = 60;
 const float INT_CLAMP = 5.0;
 const float MAX_VEL = 0.4;
@@ -19,9 +27,23 @@ float KI_TURNING;
 float KP_DRIVE;
 float KI_DRIVE;
 
-auto last_msg_time = std::chrono::high_resolution_clock::now();
-bill_msgs::MotorCommands last_command_msg;
-int last_heading = 90;
+// Latest command, handed from the ROS callbacks to the control thread
+struct ControlCommand
+{
+    uint32_t command;
+    int heading;
+    float speed;
+    uint64_t trace_id;
+};
+
+SeqLock<ControlCommand> command_mailbox;
+SeqLock<int> heading_mailbox;
+std::unique_ptr<PeriodicLoop> control_loop;
+std::thread control_thread;
+std::atomic<bool> running(false);
+
+// Only touched by the control thread
+ControlCommand last_command_msg;
 float heading_error_drive_sum = 0;
 float heading_error_turn_sum = 0;
 ros::Publisher direction_pub;
@@ -29,6 +51,8 @@ int right_direction = 0;
 int left_direction = 0;
 int right_dir_prev = 0;
 int left_dir_prev = 0;
+std::unique_ptr<PwmOutput> left_pwm;   // Motor A
+std::unique_ptr<PwmOutput> right_pwm;  // Motor B
 
 enum Direction
 {
@@ -53,13 +77,13 @@ void publishDirections()
 void stop()
 {
     ROS_INFO("Stop");
-    softPwmWrite(MOTORA_PWM, 0);
-    softPwmWrite(MOTORB_PWM, 0);
+    left_pwm->write(0);
+    right_pwm->write(0);
 }
 
 void drive(const int left_cmd, const int right_cmd)
 {
-    ROS_INFO("Drive: Left = %i, Right = %i", left_cmd, right_cmd);
+    ROS_DEBUG("Drive: Left = %i, Right = %i", left_cmd, right_cmd);
 
     if (right_cmd >= 0)
     {
@@ -85,8 +109,8 @@ void drive(const int left_cmd, const int right_cmd)
 
     }
     publishDirections();
-    softPwmWrite(MOTORA_PWM, std::abs(left_cmd));
-    softPwmWrite(MOTORB_PWM, std::abs(right_cmd));
+    left_pwm->write(std::abs(left_cmd) / (float)PWM_RANGE);
+    right_pwm->write(std::abs(right_cmd) / (float)PWM_RANGE);
 
 }
 
@@ -94,7 +118,7 @@ void turn(const Direction dir, const unsigned int speed)
 {
     if (dir == CW)
     {
-        ROS_INFO("Turning CW: Speed = %i", speed);
+        ROS_DEBUG("Turning CW: Speed = %i", speed);
         digitalWrite(MOTORA_FORWARD, LOW);
         digitalWrite(MOTORB_FORWARD, HIGH);
         right_direction = bill_msgs::MotorDirection::BACKWARD;
@@ -103,7 +127,7 @@ void turn(const Direction dir, const unsigned int speed)
     }
     else
     {
-        ROS_INFO("Turning CCW: Speed = %i", speed);
+        ROS_DEBUG("Turning CCW: Speed = %i", speed);
         digitalWrite(MOTORA_FORWARD, HIGH);
         digitalWrite(MOTORB_FORWARD, LOW);
         right_direction = bill_msgs::MotorDirection::FORWARD;
@@ -111,8 +135,8 @@ void turn(const Direction dir, const unsigned int speed)
 
     }
     publishDirections();
-    softPwmWrite(MOTORA_PWM, speed);
-    softPwmWrite(MOTORB_PWM, speed);
+    left_pwm->write(speed / (float)PWM_RANGE);
+    right_pwm->write(speed / (float)PWM_RANGE);
 }
 
 void drivePI(int heading, float dt)
@@ -134,7 +158,7 @@ void drivePI(int heading, float dt)
     }
 
     float heading_command = heading_error * KP_DRIVE + heading_error_drive_sum * KI_DRIVE;
-    ROS_INFO("Heading: %i, Com Heading: %i, heading_error: %i, heading_command: %f", heading, last_command_msg.heading, heading_error, heading_command);
+    ROS_DEBUG("Heading: %i, Com Heading: %i, heading_error: %i, heading_command: %f", heading, last_command_msg.heading, heading_error, heading_command);
     // Note: this PI calculation assumes forward motion, since the robot should never have to reverse
     // Except for construction check, but the errors will be 0 for said check
 
@@ -203,53 +227,84 @@ void turningCallback(int heading, float dt)
 
 void positionCallback(const bill_msgs::Position::ConstPtr& msg)
 {
-    int heading = msg->heading;
-    last_heading = heading;
-    auto time_now = std::chrono::high_resolution_clock::now();
+    TraceScope scope("motor_position", msg->trace_id);
+    traceReceive("position", msg->trace_id);
+    heading_mailbox.store(msg->heading);
+}
 
-    if (last_command_msg.command == bill_msgs::MotorCommands::TURN)
+void motorCallback(const bill_msgs::MotorCommands::ConstPtr& msg)
+{
+    TraceScope scope("motor_command", msg->trace_id);
+    traceReceive("motor_cmd", msg->trace_id);
+    ROS_INFO("Command %u, heading %u, speed %f", msg->command, msg->heading, msg->speed);
+
+    ControlCommand command;
+    command.command = msg->command;
+    command.heading = msg->heading;
+    command.speed = msg->speed;
+    command.trace_id = msg->trace_id;
+    command_mailbox.store(command);
+}
+
+// Runs the controllers at a fixed rate on the latest heading, however irregularly positions arrive. The motors are
+// only ever written from here
+void controlThread(int priority)
+{
+    if (!control_loop->setRealtimePriority(priority))
     {
-        turningCallback(heading, std::chrono::duration<float>(time_now - last_msg_time).count());
+        ROS_WARN("Could not run the control loop at SCHED_FIFO priority %i", priority);
     }
-    else if (last_command_msg.command == bill_msgs::MotorCommands::DRIVE)
+
+    uint32_t previous = bill_msgs::MotorCommands::STOP;
+    while (running.load() && ros::ok())
     {
-        drivePI(heading, std::chrono::duration<float>(time_now - last_msg_time).count());
-    }
+        float dt = control_loop->wait();
+        last_command_msg = command_mailbox.load();
+        int heading = heading_mailbox.load();
 
-    last_msg_time = time_now;
+        // A new action starts without a time step, as the callbacks used to start it
+        if (last_command_msg.command != previous)
+        {
+            dt = 0;
+        }
 
+        if (last_command_msg.command == bill_msgs::MotorCommands::STOP)
+        {
+            if (previous != bill_msgs::MotorCommands::STOP)
+            {
+                stop();
+                traceRecord(TRACE_INSTANT, "motor_stopped", last_command_msg.trace_id);
+            }
+        }
+        else if (last_command_msg.command == bill_msgs::MotorCommands::TURN)
+        {
+            turningCallback(heading, dt);
+        }
+        else
+        {
+            drivePI(heading, dt);
+        }
+        previous = last_command_msg.command;
+    }
 }
 
-void motorCallback(const bill_msgs::MotorCommands::ConstPtr& msg)
+void statsCallback(const ros::TimerEvent& event)
 {
-    last_command_msg.command = msg->command;
-    last_command_msg.heading = msg->heading;
-    last_command_msg.speed = msg->speed;
+    LoopStats stats = control_loop->stats();
+    ROS_INFO("Control loop: %llu cycles, %llu overruns, late by %.0f us on average and %.0f us at most, "
+             "%.0f us period jitter", (unsigned long long)stats.cycles, (unsigned long long)stats.overruns,
+             stats.mean_late_ns / 1000, stats.max_late_ns / 1000.0, stats.period_jitter_ns / 1000);
+}
 
-    if (msg->command == bill_msgs::MotorCommands::STOP)
-    {
-        ROS_INFO("Calling Stop");
-        stop();
-    }
-    else if (msg->command == bill_msgs::MotorCommands::TURN)
-    {
-        ROS_INFO("Calling Turn");
-        // Call these here to start a robots action, callback from odom continues the action until completion
-        last_msg_time = std::chrono::high_resolution_clock::now();
-        turningCallback(last_heading, 0);
-    }
-    else
-    {
-        ROS_INFO("Calling Drive");
-        // Call these here to start a robots action, callback from odom continues the action until completion
-        last_msg_time = std::chrono::high_resolution_clock::now();
-        drivePI(last_heading, 0);
-    }
+bool startPwm(const std::string& backend, float frequency)
+{
+    left_pwm.reset(createPwmOutput(backend, MOTORA_PWM, frequency, PWM_RANGE));
+    right_pwm.reset(createPwmOutput(backend, MOTORB_PWM, frequency, PWM_RANGE));
+    return left_pwm->start() && right_pwm->start();
 }
 
 void sigIntHandler(int sig)
 {
-    stop();
     ros::shutdown();
 }
 
@@ -259,12 +314,29 @@ int main(int argc, char** argv)
     wiringPiSetupGpio();
     pinMode(MOTORA_FORWARD, OUTPUT);
     pinMode(MOTORB_FORWARD, OUTPUT);
-    pinMode(MOTORA_PWM, OUTPUT);
-    pinMode(MOTORB_PWM, OUTPUT);
-    softPwmCreate(MOTORA_PWM, 0, PWM_RANGE);
-    softPwmCreate(MOTORB_PWM, 0, PWM_RANGE);
 
     ros::NodeHandle nh;
+    ros::NodeHandle private_nh("~");
+
+    // Both motors share a backend so they run at the same frequency. GPIO10 has no hardware channel, so by default
+    // both stay on softPwm
+    std::string pwm_backend = "auto";
+    float pwm_frequency = PWM_FREQUENCY;
+    private_nh.getParam("pwm_backend", pwm_backend);
+    private_nh.getParam("pwm_frequency", pwm_frequency);
+    std::string backend = resolvePwmBackend(pwm_backend, {MOTORA_PWM, MOTORB_PWM});
+    bool started = startPwm(backend, pwm_frequency);
+    if (!started && pwm_backend == "auto" && backend == "sysfs")
+    {
+        // Without the pwm overlay there is no pwm chip to export the channels from
+        ROS_WARN("No hardware PWM, falling back to softPwm");
+        started = startPwm("soft", pwm_frequency);
+    }
+    if (!started)
+    {
+        ROS_ERROR("Could not start the %s motor PWM outputs", pwm_backend.c_str());
+        return 1;
+    }
     ros::Subscriber sub_motor = nh.subscribe("motor_cmd", 1, motorCallback);
     ros::Subscriber sub_odom = nh.subscribe("position", 1, positionCallback);
     direction_pub = nh.advertise<bill_msgs::MotorDirection>("motor_dir", 100);
@@ -274,9 +346,32 @@ int main(int argc, char** argv)
     nh.getParam("/bill/motor_params/ki_turning", KI_TURNING);
     nh.getParam("/bill/motor_params/kp_drive", KP_DRIVE);
     nh.getParam("/bill/motor_params/ki_drive", KI_DRIVE);
-    last_command_msg.command = bill_msgs::MotorCommands::STOP;
     signal(SIGINT, sigIntHandler);
 
+    std::string trace_dir;
+    if (nh.getParam("/trace_dir", trace_dir) && !traceOpen(trace_dir, ros::this_node::getName()))
+    {
+        ROS_WARN("Could not open a trace file in %s", trace_dir.c_str());
+    }
+
+    double control_rate = CONTROL_RATE;
+    int realtime_priority = 0;
+    private_nh.getParam("control_rate", control_rate);
+    private_nh.getParam("realtime_priority", realtime_priority);
+
+    ControlCommand command = ControlCommand();
+    command.command = bill_msgs::MotorCommands::STOP;
+    command_mailbox.store(command);
+    heading_mailbox.store(90);
+    control_loop.reset(new PeriodicLoop(control_rate));
+    running = true;
+    control_thread = std::thread(controlThread, realtime_priority);
+    ros::Timer stats_timer = nh.createTimer(ros::Duration(STATS_PERIOD), statsCallback);
+
     ros::spin();
+    running = false;
+    control_thread.join();
+    stop();
+    traceDump();
     return 0;
 }
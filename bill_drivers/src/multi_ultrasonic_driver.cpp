@@ -0,0 +1,303 @@
+#include "ros/ros.h"
+#include "std_msgs/Float32.h"
+#include "sensor_msgs/Range.h"
+#include "wiringPi.h"
+#include "bill_drivers/constant_definition.hpp"
+#include "bill_drivers/filters.hpp"
+#include "bill_drivers/gpio_event.hpp"
+#include "bill_drivers/trace.hpp"
+#include "bill_msgs/MotorCommands.h"
+#include "bill_msgs/Ranges.h"
+#include <limits>  // for NaN
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+// All sensors are driven from one node. Only one sensor is pinging at a time so they can't hear each other's echoes,
+// and each gets an equal slot of the LOOP_RATE_ULTRA cycle. Echo pulses are timed from gpio edge interrupts, so the
+// thread sleeps while waiting instead of spinning on digitalRead. After every full cycle all readings are interpolated
+// to the time of the cycle's first reading and published together, so consumers never pair readings of different ages
+
+const static int ECHO_RECEIVE_TIMEOUT_MS = 5;
+const static uint64_t ECHO_READ_TIMEOUT_NS = 15000000ull;
+const static float DISTANCE_SCALE_CM = 57.0;
+const static float MIN_RANGE_M = 0.02;
+const static float FIELD_OF_VIEW = 0.26;  // About 15 degrees
+const static float MAX_INTERPOLATION_CYCLES = 2.5;  // Longer gaps between readings fall back to the latest one
+
+struct UltrasonicChannel
+{
+    std::string name;
+    int trig_pin;
+    int echo_pin;
+    GpioEventLine echo;
+    LowPassFilter lp_filter;
+    bool first_msg;
+    ros::Time last_msg_time;
+    float distance;  // Filtered, cm
+    float prev_distance;
+    ros::Time prev_msg_time;
+    bool has_prev;
+    bool fresh;  // A valid reading was taken this cycle
+    ros::Publisher distance_pub;
+    ros::Publisher range_pub;
+};
+
+std::vector<std::unique_ptr<UltrasonicChannel>> channels;
+ros::Publisher ranges_pub;
+bool turning = false;
+
+bool setup(ros::NodeHandle& nh)
+{
+    std::vector<std::string> names;
+    std::string gpio_chip = DEFAULT_GPIO_CHIP;
+    nh.getParam("channels", names);
+    nh.getParam("gpio_chip", gpio_chip);
+    if (names.empty())
+    {
+        ROS_ERROR("No ultrasonic channels configured");
+        return false;
+    }
+
+    // Init GPIO, wiringPi only drives the triggers
+    wiringPiSetupGpio();
+
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        std::unique_ptr<UltrasonicChannel> channel(new UltrasonicChannel());
+        std::string topic;
+        float freq = 0;
+        channel->name = names[i];
+        nh.getParam(names[i] + "/trigger_pin", channel->trig_pin);
+        nh.getParam(names[i] + "/echo_pin", channel->echo_pin);
+        nh.getParam(names[i] + "/topic", topic);
+        nh.getParam(names[i] + "/filter_freq", freq);
+        channel->lp_filter.setFrequency(freq);
+        channel->first_msg = true;
+        channel->has_prev = false;
+        channel->fresh = false;
+
+        pinMode(channel->trig_pin, OUTPUT);
+        digitalWrite(channel->trig_pin, LOW);
+        if (!channel->echo.open(channel->echo_pin, "ultrasonic_" + names[i], gpio_chip))
+        {
+            ROS_ERROR("Could not request echo pin %i for the %s ultrasonic", channel->echo_pin, names[i].c_str());
+            return false;
+        }
+        ROS_INFO("%s ultrasonic: trigger pin %i, echo pin %i", names[i].c_str(), channel->trig_pin, channel->echo_pin);
+
+        channel->distance_pub = nh.advertise<std_msgs::Float32>(topic, 100);
+        channel->range_pub = nh.advertise<sensor_msgs::Range>(topic + "_range", 100);
+        channels.push_back(std::move(channel));
+    }
+
+    std::string ranges_topic = "/ultra_ranges";
+    nh.getParam("ranges_topic", ranges_topic);
+    ranges_pub = nh.advertise<bill_msgs::Ranges>(ranges_topic, 100);
+    return true;
+}
+
+// Triggers one sensor and times its echo pulse from the kernel's edge timestamps. Returns the distance in cm, or NaN
+float readDistance(UltrasonicChannel& channel, ros::Time& stamp, uint64_t trace_id)
+{
+    // Drop edges left over from a previous timed out echo
+    GpioEdge edge;
+    while (channel.echo.waitForEdge(edge, 0))
+    {
+    }
+
+    // Send pulse of 10 microseconds
+    stamp = ros::Time::now();
+    digitalWrite(channel.trig_pin, HIGH);
+    // Note this delay MUST be longer than 10 microseconds
+    delayMicroseconds(10);
+    digitalWrite(channel.trig_pin, LOW);
+
+    GpioEdge rising;
+    do
+    {
+        if (!channel.echo.waitForEdge(rising, ECHO_RECEIVE_TIMEOUT_MS))
+        {
+            ROS_WARN("%s ultrasonic sensor never received echo", channel.name.c_str());
+            return std::numeric_limits<float>::quiet_NaN();
+        }
+    } while (!rising.rising);
+
+    GpioEdge falling;
+    do
+    {
+        if (!channel.echo.waitForEdge(falling, ECHO_READ_TIMEOUT_NS / 1000000))
+        {
+            ROS_WARN("%s ultrasonic sensor timed out while reading echo", channel.name.c_str());
+            return std::numeric_limits<float>::quiet_NaN();
+        }
+    } while (falling.rising);
+
+    uint64_t echo_ns = falling.timestamp_ns - rising.timestamp_ns;
+    traceRecord(TRACE_INSTANT, "ultrasonic_echo", trace_id, falling.timestamp_ns);
+    if (echo_ns > ECHO_READ_TIMEOUT_NS)
+    {
+        ROS_WARN("%s ultrasonic sensor timed out while reading echo", channel.name.c_str());
+        return std::numeric_limits<float>::quiet_NaN();
+    }
+
+    // The sound reached the wall half way through the echo
+    stamp = stamp + ros::Duration(echo_ns * 0.5e-9);
+    return (echo_ns / 1000.0) / DISTANCE_SCALE_CM;
+}
+
+// Returns the trigger time, or the reading time if the reading is valid
+ros::Time read(UltrasonicChannel& channel, uint64_t trace_id)
+{
+    TraceScope scope("ultrasonic_read", trace_id);
+    ros::Time stamp;
+    float distance = readDistance(channel, stamp, trace_id);
+    channel.fresh = false;
+
+    if (std::isnan(distance) || turning)
+    {
+        return stamp;
+    }
+
+    if (!channel.first_msg)
+    {
+        channel.lp_filter.setSamplingTime((stamp - channel.last_msg_time).toSec());
+        distance = channel.lp_filter.update(distance);
+        channel.has_prev = true;
+    }
+    else
+    {
+        channel.lp_filter.setPrevOutput(distance);
+        channel.first_msg = false;
+        channel.has_prev = false;
+    }
+
+    channel.prev_distance = channel.distance;
+    channel.prev_msg_time = channel.last_msg_time;
+    channel.distance = distance;
+    channel.last_msg_time = stamp;
+    channel.fresh = true;
+
+    std_msgs::Float32 msg;
+    msg.data = distance;
+    channel.distance_pub.publish(msg);
+
+    sensor_msgs::Range range_msg;
+    range_msg.header.stamp = stamp;
+    range_msg.header.frame_id = "ultra_" + channel.name;
+    range_msg.radiation_type = sensor_msgs::Range::ULTRASOUND;
+    range_msg.field_of_view = FIELD_OF_VIEW;
+    range_msg.min_range = MIN_RANGE_M;
+    range_msg.max_range = (ECHO_READ_TIMEOUT_NS / 1000.0) / DISTANCE_SCALE_CM / 100.0;
+    range_msg.range = distance / 100.0;
+    channel.range_pub.publish(range_msg);
+    return stamp;
+}
+
+// Linear interpolation between the channel's last two readings, which bracket the cycle's first reading
+float interpolate(const UltrasonicChannel& channel, const ros::Time& stamp, double cycle_period)
+{
+    if (!channel.fresh)
+    {
+        return std::numeric_limits<float>::quiet_NaN();
+    }
+
+    double span = (channel.last_msg_time - channel.prev_msg_time).toSec();
+    if (!channel.has_prev || span <= 0 || span > MAX_INTERPOLATION_CYCLES * cycle_period)
+    {
+        return channel.distance;
+    }
+
+    double alpha = (stamp - channel.prev_msg_time).toSec() / span;
+    alpha = std::max(0.0, std::min(1.0, alpha));
+    return channel.prev_distance + alpha * (channel.distance - channel.prev_distance);
+}
+
+void publishRanges(const ros::Time& cycle_stamp, double cycle_period, uint64_t trace_id)
+{
+    if (turning)
+    {
+        return;
+    }
+
+    TraceScope scope("ultrasonic_publish", trace_id);
+    bill_msgs::Ranges msg;
+    msg.header.stamp = cycle_stamp;
+    msg.trace_id = trace_id;
+    for (size_t i = 0; i < channels.size(); i++)
+    {
+        msg.names.push_back(channels[i]->name);
+        msg.ranges.push_back(interpolate(*channels[i], cycle_stamp, cycle_period));
+        msg.stamps.push_back(channels[i]->last_msg_time);
+    }
+    tracePublish("ultra_ranges", trace_id);
+    ranges_pub.publish(msg);
+}
+
+void motorCallback(const bill_msgs::MotorCommands::ConstPtr& msg)
+{
+    if (msg->command == bill_msgs::MotorCommands::TURN)
+    {
+        turning = true;
+    }
+    else
+    {
+        if (turning)  // Was just turning but has now stopped, then reset the filters
+        {
+            for (size_t i = 0; i < channels.size(); i++)
+            {
+                channels[i]->first_msg = true;
+                channels[i]->fresh = false;
+            }
+        }
+        turning = false;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    ros::init(argc, argv, "multi_ultrasonic_driver");
+    ros::NodeHandle nh("~");
+
+    if (!setup(nh))
+    {
+        return 1;
+    }
+
+    std::string trace_dir;
+    if (nh.getParam("/trace_dir", trace_dir) && !traceOpen(trace_dir, ros::this_node::getName()))
+    {
+        ROS_WARN("Could not open a trace file in %s", trace_dir.c_str());
+    }
+
+    ros::Subscriber motor_sub = nh.subscribe("/motor_cmd", 1, motorCallback);
+    ros::Rate slot_rate(LOOP_RATE_ULTRA * channels.size());
+
+    double cycle_period = 1.0 / LOOP_RATE_ULTRA;
+    ros::Time cycle_stamp;
+    uint64_t cycle_trace_id = 0;
+    size_t next = 0;
+    while (ros::ok())
+    {
+        if (next == 0)
+        {
+            cycle_trace_id = traceNewId();
+        }
+        ros::Time stamp = read(*channels[next], cycle_trace_id);
+        if (next == 0)
+        {
+            cycle_stamp = stamp;
+        }
+
+        next = (next + 1) % channels.size();
+        if (next == 0)
+        {
+            publishRanges(cycle_stamp, cycle_period, cycle_trace_id);
+        }
+
+        ros::spinOnce();
+        slot_rate.sleep();
+    }
+    traceDump();
+    return 0;
+}
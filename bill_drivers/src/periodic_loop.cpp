@@ -0,0 +1,95 @@
+#include "bill_drivers/periodic_loop.hpp"
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+
+static const uint64_t NS_PER_SECOND = 1000000000ull;
+
+static uint64_t toNs(const struct timespec& ts)
+{
+    return (uint64_t)ts.tv_sec * NS_PER_SECOND + ts.tv_nsec;
+}
+
+static void addNs(struct timespec& ts, uint64_t ns)
+{
+    uint64_t total = toNs(ts) + ns;
+    ts.tv_sec = total / NS_PER_SECOND;
+    ts.tv_nsec = total % NS_PER_SECOND;
+}
+
+PeriodicLoop::PeriodicLoop(double rate_hz)
+{
+    _period_ns = (uint64_t)(NS_PER_SECOND / rate_hz);
+    _deadline.tv_sec = 0;
+    _deadline.tv_nsec = 0;
+    _last_wake_ns = 0;
+    _period_mean_ns = 0;
+    _period_m2 = 0;
+    _stats = LoopStats();
+    _published.store(_stats);
+}
+
+bool PeriodicLoop::setRealtimePriority(int priority)
+{
+    if (priority <= 0)
+    {
+        return true;
+    }
+    struct sched_param param;
+    param.sched_priority = priority;
+    return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+}
+
+float PeriodicLoop::wait()
+{
+    if (_last_wake_ns == 0)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &_deadline);
+    }
+    addNs(_deadline, _period_ns);
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &_deadline, NULL) == EINTR)
+    {
+    }
+
+    struct timespec now_ts;
+    clock_gettime(CLOCK_MONOTONIC, &now_ts);
+    uint64_t now = toNs(now_ts);
+    uint64_t late = now > toNs(_deadline) ? now - toNs(_deadline) : 0;
+
+    if (late >= _period_ns)
+    {
+        _stats.overruns++;
+        addNs(_deadline, (late / _period_ns) * _period_ns);
+    }
+
+    _stats.cycles++;
+    _stats.max_late_ns = late > _stats.max_late_ns ? late : _stats.max_late_ns;
+    _stats.mean_late_ns += (late - _stats.mean_late_ns) / _stats.cycles;
+
+    float dt = _period_ns / (float)NS_PER_SECOND;
+    if (_last_wake_ns != 0)
+    {
+        // Welford's running variance of the wakeup spacing
+        double period = now - _last_wake_ns;
+        double delta = period - _period_mean_ns;
+        _period_mean_ns += delta / (_stats.cycles - 1);
+        _period_m2 += delta * (period - _period_mean_ns);
+        _stats.period_jitter_ns = _stats.cycles > 2 ? sqrt(_period_m2 / (_stats.cycles - 2)) : 0;
+        dt = period / NS_PER_SECOND;
+    }
+    _last_wake_ns = now;
+    _published.store(_stats);
+    return dt;
+}
+
+uint64_t PeriodicLoop::periodNs() const
+{
+    return _period_ns;
+}
+
+LoopStats PeriodicLoop::stats() const
+{
+    return _published.load();
+}
@@ -0,0 +1,181 @@
+#include "bill_drivers/pwm_output.hpp"
+#include <softPwm.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// udev needs a moment to hand a newly exported channel's attributes over
+static const int EXPORT_RETRIES = 20;
+static const long EXPORT_RETRY_NS = 10000000;
+
+static float clampDuty(float duty)
+{
+    return duty < 0 ? 0 : (duty > 1 ? 1 : duty);
+}
+
+SysfsPwmOutput::SysfsPwmOutput(int pin, float frequency, const std::string& chip)
+{
+    _pin = pin;
+    _channel = channelForPin(pin);
+    _period_ns = (uint64_t)(1e9 / frequency);
+    _duty_ns = 0;
+    _chip = chip;
+    _dir = chip + "/pwm" + std::to_string(_channel);
+    _duty_fd = -1;
+}
+
+SysfsPwmOutput::~SysfsPwmOutput()
+{
+    if (_duty_fd >= 0)
+    {
+        write(0);
+        writeAttribute("enable", 0);
+        close(_duty_fd);
+    }
+}
+
+int SysfsPwmOutput::channelForPin(int pin)
+{
+    switch (pin)
+    {
+        case 12:
+        case 18:
+            return 0;
+        case 13:
+        case 19:
+            return 1;
+        default:
+            return -1;
+    }
+}
+
+bool SysfsPwmOutput::start()
+{
+    if (_channel < 0)
+    {
+        return false;
+    }
+
+    if (access(_dir.c_str(), F_OK) != 0)
+    {
+        FILE* file = fopen((_chip + "/export").c_str(), "w");
+        if (file == NULL)
+        {
+            return false;
+        }
+        fprintf(file, "%i", _channel);
+        fclose(file);
+    }
+
+    struct timespec retry = {0, EXPORT_RETRY_NS};
+    for (int i = 0; i < EXPORT_RETRIES && access((_dir + "/duty_cycle").c_str(), W_OK) != 0; i++)
+    {
+        nanosleep(&retry, NULL);
+    }
+
+    // The duty can't exceed the period, so clear it before a shorter period goes in
+    if (!writeAttribute("duty_cycle", 0) || !writeAttribute("period", _period_ns) || !writeAttribute("enable", 1))
+    {
+        return false;
+    }
+
+    // Kept open, every motor update is a single write
+    _duty_fd = open((_dir + "/duty_cycle").c_str(), O_WRONLY | O_CLOEXEC);
+    _duty_ns = 0;
+    _duty = 0;
+    return _duty_fd >= 0;
+}
+
+void SysfsPwmOutput::write(float duty)
+{
+    _duty = clampDuty(duty);
+    uint64_t duty_ns = (uint64_t)(_duty * _period_ns + 0.5f);
+    if (_duty_fd < 0 || duty_ns == _duty_ns)
+    {
+        return;
+    }
+
+    char buffer[24];
+    int length = snprintf(buffer, sizeof(buffer), "%" PRIu64, duty_ns);
+    if (pwrite(_duty_fd, buffer, length, 0) == length)
+    {
+        _duty_ns = duty_ns;
+    }
+}
+
+bool SysfsPwmOutput::writeAttribute(const std::string& name, uint64_t value)
+{
+    FILE* file = fopen((_dir + "/" + name).c_str(), "w");
+    if (file == NULL)
+    {
+        return false;
+    }
+    bool ok = fprintf(file, "%" PRIu64, value) > 0;
+    return fclose(file) == 0 && ok;
+}
+
+SoftPwmOutput::SoftPwmOutput(int pin, int range)
+{
+    _pin = pin;
+    _range = range;
+    _value = 0;
+}
+
+bool SoftPwmOutput::start()
+{
+    return softPwmCreate(_pin, 0, _range) == 0;
+}
+
+void SoftPwmOutput::write(float duty)
+{
+    _duty = clampDuty(duty);
+    int value = (int)(_duty * _range + 0.5f);
+    if (value != _value)
+    {
+        softPwmWrite(_pin, value);
+        _value = value;
+    }
+}
+
+bool SimPwmOutput::start()
+{
+    return true;
+}
+
+void SimPwmOutput::write(float duty)
+{
+    _duty = clampDuty(duty);
+}
+
+std::string resolvePwmBackend(const std::string& backend, const std::vector<int>& pins)
+{
+    if (backend != "auto")
+    {
+        return backend;
+    }
+    for (size_t i = 0; i < pins.size(); i++)
+    {
+        if (SysfsPwmOutput::channelForPin(pins[i]) < 0)
+        {
+            return "soft";
+        }
+    }
+    return "sysfs";
+}
+
+PwmOutput* createPwmOutput(const std::string& backend, int pin, float frequency, int soft_range)
+{
+    std::string resolved = resolvePwmBackend(backend, std::vector<int>(1, pin));
+    if (resolved == "sim")
+    {
+        return new SimPwmOutput();
+    }
+    if (resolved == "sysfs")
+    {
+        return new SysfsPwmOutput(pin, frequency);
+    }
+    return new SoftPwmOutput(pin, soft_range);
+}
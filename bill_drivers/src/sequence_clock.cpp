@@ -0,0 +1,121 @@
+#include "bill_drivers/sequence_clock.hpp"
+#include <cmath>
+
+// A gap this many periods long could hide a full wrap of the sequence counter
+const double MAX_GAP_PERIODS = 100;
+// Fitted periods further than this from the nominal period mean the sender isn't running at a fixed rate
+const double MAX_PERIOD_ERROR = 0.1;
+
+SequenceClock::SequenceClock(double nominal_period)
+{
+    _nominal_period = nominal_period;
+    reset();
+}
+
+void SequenceClock::reset()
+{
+    _period = _nominal_period;
+    _offset = 0;
+    _have_seq = false;
+    _last_seq = 0;
+    _index = 0;
+    _last_arrival = 0;
+    _epoch = 0;
+    _count = 0;
+    _next = 0;
+}
+
+double SequenceClock::update(uint8_t seq, double arrival)
+{
+    if (_have_seq && arrival - _last_arrival > MAX_GAP_PERIODS * _nominal_period)
+    {
+        reset();
+    }
+
+    if (!_have_seq)
+    {
+        _epoch = arrival;
+        _index = 0;
+    }
+    else
+    {
+        _index += (uint8_t)(seq - _last_seq);
+    }
+    _have_seq = true;
+    _last_seq = seq;
+    _last_arrival = arrival;
+
+    _indices[_next] = _index;
+    _arrivals[_next] = arrival - _epoch;
+    _next = (_next + 1) % WINDOW;
+    if (_count < WINDOW)
+    {
+        _count++;
+    }
+
+    if (_count < MIN_SAMPLES)
+    {
+        return arrival;
+    }
+    fit();
+    if (!converged())
+    {
+        return arrival;
+    }
+    return _epoch + _offset + _index * _period;
+}
+
+void SequenceClock::fit()
+{
+    // Least squares slope of arrival against index, centred on the means for precision
+    double mean_index = 0;
+    double mean_arrival = 0;
+    for (int i = 0; i < _count; i++)
+    {
+        mean_index += _indices[i];
+        mean_arrival += _arrivals[i];
+    }
+    mean_index /= _count;
+    mean_arrival /= _count;
+
+    double sxy = 0;
+    double sxx = 0;
+    for (int i = 0; i < _count; i++)
+    {
+        double dx = _indices[i] - mean_index;
+        sxy += dx * (_arrivals[i] - mean_arrival);
+        sxx += dx * dx;
+    }
+    if (sxx <= 0)
+    {
+        return;
+    }
+    _period = sxy / sxx;
+
+    // Lower envelope of the arrivals, the least delayed frame in the window
+    double offset = _arrivals[0] - _indices[0] * _period;
+    for (int i = 1; i < _count; i++)
+    {
+        double candidate = _arrivals[i] - _indices[i] * _period;
+        if (candidate < offset)
+        {
+            offset = candidate;
+        }
+    }
+    _offset = offset;
+}
+
+bool SequenceClock::converged() const
+{
+    return _count >= MIN_SAMPLES && std::fabs(_period - _nominal_period) < MAX_PERIOD_ERROR * _nominal_period;
+}
+
+double SequenceClock::period() const
+{
+    return _period;
+}
+
+double SequenceClock::offset() const
+{
+    return _epoch + _offset;
+}
@@ -2,157 +2,364 @@
 #include "std_msgs/Bool.h"
 #include "sensor_msgs/Imu.h"
 #include "ros/ros.h"
-#include "wiringPi.h"
-#include "serial/serial.h"
 #include "bill_drivers/constant_definition.hpp"
+#include "bill_drivers/arduino_protocol.hpp"
+#include "bill_drivers/byte_source.hpp"
+#include "bill_drivers/sequence_clock.hpp"
+#include "bill_drivers/spsc_queue.hpp"
+#include "bill_drivers/driver_nodes.hpp"
+#include "bill_drivers/trace.hpp"
 #include <bitset>
-#include <stdexcept>
+#include <stdio.h>
 #include "tf/transform_datatypes.h"
 #include <cmath>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
-const std::string port = "/dev/ttyACM0";
-const int baud = 9600;
-const std::string delimiter = " ";
-const int msg_length = 13;
+namespace serial_driver
+{
+const size_t RX_CHUNK = 256;
+const int READ_TIMEOUT_MS = 100;
+const size_t PACKET_QUEUE_SIZE = 64;
+const double BITS_PER_BYTE = 10;  // 8N1 framing
+
+struct StampedPacket
+{
+    ArduinoPacket packet;
+    ros::Time arrival;
+    uint64_t read_ns;  // Monotonic time the chunk was read, for tracing
+};
+
+// Frames go from the reader thread to the publishing thread without locks, the eventfd only wakes the publisher
+SpscQueue<StampedPacket, PACKET_QUEUE_SIZE> packet_queue;
+int packet_event_fd = -1;
+std::atomic<bool> reader_done(false);
+std::atomic<bool> running(false);
+
+std::unique_ptr<ByteSource> source;
+std::unique_ptr<ArduinoFrameParser> parser;
+std::unique_ptr<SequenceClock> sequence_clock;
+FILE* record_file = NULL;
+std::thread reader_thread;
+std::thread publisher_thread;
 
 float starting_theta = M_PI_2;
 bool first_msg = true;
 tf::Quaternion transformation;
-char sensorData[msg_length];
 
-int main(int argc, char** argv)
-{
-    ros::init(argc, argv, "serial_driver");
-    ros::NodeHandle nh;
-    ros::Rate loop_rate(LOOP_RATE_SERIAL);
-    float temp_theta;
-    nh.getParam("/bill/starting_params/theta", temp_theta);
-    starting_theta = (temp_theta)*M_PI/180.0;
+ros::Publisher survivor_pub;
+ros::Publisher fire_pub;
+ros::Publisher fire_left_pub;
+ros::Publisher fire_right_pub;
+ros::Publisher imu_pub;
 
+const std::bitset<8> fire_bitmap = 0x01;
+const std::bitset<8> survivor_bitmap = 0x0C;
+const std::bitset<8> fire_left_bitmap = 0x10;
+const std::bitset<8> fire_right_bitmap = 0x20;
 
-    ros::Publisher survivor_pub = nh.advertise<bill_msgs::Survivor>("survivors", 100);
-    ros::Publisher fire_pub = nh.advertise<std_msgs::Bool>("fire", 100);
-    ros::Publisher fire_left_pub = nh.advertise<std_msgs::Bool>("fire_left", 100);
-    ros::Publisher fire_right_pub = nh.advertise<std_msgs::Bool>("fire_right", 100);
-    ros::Publisher imu_pub = nh.advertise<sensor_msgs::Imu>("imu", 100);
+void publishSensorData(const uint8_t* bytes, const ros::Time& stamp)
+{
+    // Messages are published as shared pointers so subscribers in the same nodelet manager get them without a copy
+    bill_msgs::SurvivorPtr survivor_msg(new bill_msgs::Survivor());
+    std_msgs::BoolPtr fire_msg(new std_msgs::Bool());
+    std_msgs::BoolPtr fire_left_msg(new std_msgs::Bool());
+    std_msgs::BoolPtr fire_right_msg(new std_msgs::Bool());
 
-    std::bitset<8> fire_bitmap = 0x01;
-    std::bitset<8> survivor_bitmap = 0x0C;
-    std::bitset<8> fire_left_bitmap = 0x10;
-    std::bitset<8> fire_right_bitmap = 0x20;
+    // Convert IMU Quaternion data
+    double quatW = (double)((signed short)(bytes[1] << 8 | bytes[0])) / 16384.0;
+    double quatX = (double)((signed short)(bytes[3] << 8 | bytes[2])) / 16384.0;
+    double quatY = (double)((signed short)(bytes[5] << 8 | bytes[4])) / 16384.0;
+    double quatZ = (double)((signed short)(bytes[7] << 8 | bytes[6])) / 16384.0;
 
-    serial::Serial my_serial(port, baud, serial::Timeout::simpleTimeout(1000));
-    if (my_serial.isOpen())
-    {
-        ROS_INFO("Serial port is open!");
-    }
-    else
+    // Convert linear acceleration and angular velocity
+    double xaccel = (double)(((signed short)(bytes[9] << 8 | bytes[8])) / 100.0);
+    double zgyro = (double)(((signed short)(bytes[11] << 8 | bytes[10])) / 16.0);
+
+    if (first_msg)
     {
-        ROS_ERROR("Serial port not open!!!");
+        // Save the initial orientation so that the imu is aligned to the courses axis and not the earth's field
+        tf::Quaternion temp(quatX, quatY, quatZ, quatW);
+        transformation.setRPY(0,0,-tf::getYaw(temp)+starting_theta);
+        ROS_INFO("First Yaw: %f", tf::getYaw(temp));
+        ROS_INFO("Transformation: %f", -tf::getYaw(temp)+starting_theta);
+        first_msg = false;
     }
 
-    while (ros::ok())
+    sensor_msgs::ImuPtr imu_msg(new sensor_msgs::Imu());
+    imu_msg->header.frame_id = "base_link";
+    imu_msg->header.stamp = stamp;
+
+    // Rotate current rotation into new frame
+    tf::Quaternion quat(quatX, quatY, quatZ, quatW);
+    ROS_DEBUG("Non corrected Yaw: %f", tf::getYaw(quat));
+    quat = (transformation * quat).normalize();
+    ROS_DEBUG("Yaw: %f", tf::getYaw(quat));
+
+    imu_msg->orientation.x = quat.x();
+    imu_msg->orientation.y = quat.y();
+    imu_msg->orientation.z = quat.z();
+    imu_msg->orientation.w = quat.w();
+    imu_msg->orientation_covariance = {0.001, 0, 0,
+                                      0, 0.001, 0,
+                                      0, 0, 0.001};
+
+    imu_msg->angular_velocity.z = zgyro;
+    imu_msg->angular_velocity_covariance = {-1, 0, 0,
+                                           0, -1, 0,
+                                           0, 0, 0.05};
+    imu_msg->linear_acceleration.x = xaccel;
+    imu_msg->angular_velocity_covariance = {0.1, 0, 0,
+                                           0, -1, 0,
+                                           0, 0, -1};
+
+    // Print out what the Arduino is sending...
+    std::bitset<8> data_received(bytes[12]);
+
+    // ROS_INFO("Received arduino data: %i", (int)data_received.to_ulong());
+    // Parse the byte, bits 3 and 2 are survivor data, 1 is food and 0 is fire
+    survivor_msg->data = (int)((data_received & survivor_bitmap) >> 2).to_ulong();
+    fire_msg->data = (bool)(data_received & fire_bitmap).to_ulong();
+    fire_left_msg->data = (bool)(data_received & fire_left_bitmap).to_ulong();
+    fire_right_msg->data = (bool)(data_received & fire_right_bitmap).to_ulong();
+
+    // Publish message, and spin thread
+    imu_pub.publish(imu_msg);
+    survivor_pub.publish(survivor_msg);
+    fire_pub.publish(fire_msg);
+    fire_left_pub.publish(fire_left_msg);
+    fire_right_pub.publish(fire_right_msg);
+}
+
+// Only reads, stamps and parses so that the arrival stamp doesn't depend on how long publishing takes
+void readerThread(double byte_time)
+{
+    ArduinoPacket packet;
+    uint8_t rx[RX_CHUNK];
+    uint32_t dropped_reported = 0;
+    uint32_t errors_reported = 0;
+    uint32_t overflows = 0;
+
+    while (running.load() && ros::ok())
     {
-        bill_msgs::Survivor survivor_msg;
-        std_msgs::Bool food_msg;
-        std_msgs::Bool fire_msg;
-        std_msgs::Bool fire_left_msg;
-        std_msgs::Bool fire_right_msg;
+        int n = source->read(rx, RX_CHUNK, READ_TIMEOUT_MS);
+        ros::Time now = ros::Time::now();
+        uint64_t read_ns = traceNowNs();
+        if (n < 0)
+        {
+            ROS_WARN("Serial byte source closed");
+            break;
+        }
+        if (record_file != NULL && n > 0)
+        {
+            fwrite(rx, 1, n, record_file);
+        }
 
-        std::string data = my_serial.readline(65536, "\r\n");
-        size_t pos = 0;
-        int i = 0;
-        std::string token;
-        while ((pos = data.find(delimiter)) != std::string::npos)
+        size_t offset = 0;
+        while (offset < (size_t)n)
         {
-            if (i >= msg_length)
+            bool complete;
+            offset += parser->parse(rx + offset, n - offset, packet, complete);
+            if (!complete)
             {
-                i++;  // Increment i so the check later recognizes the message as invalid
-                break;
+                continue;
             }
-            token = data.substr(0, pos);
-            try
+
+            // The bytes after this frame in the chunk arrived after it, and the Arduino sampled the data just before it
+            // started sending the frame
+            StampedPacket item;
+            item.packet = packet;
+            item.arrival = now - ros::Duration((n - offset + packet.length) * byte_time);
+            item.read_ns = read_ns;
+            if (packet_queue.push(item))
             {
-                sensorData[i] = (char)std::stoi(token);
+                uint64_t one = 1;
+                if (write(packet_event_fd, &one, sizeof(one)) < 0)
+                {
+                    ROS_ERROR("Could not wake the publisher thread");
+                }
             }
-            catch (const std::invalid_argument& ia)
+            else
             {
-                ROS_ERROR("Read a broken imu string: %s, bailing this read", ia.what());
-                break;
+                ROS_WARN("Packet queue full, %u packets lost", ++overflows);
             }
-            data.erase(0, pos + delimiter.length());
-            i++;
         }
 
-        // Unless message read was the appropriate length, then toss it
-        if (i == msg_length)
+        if (parser->droppedFrames() != dropped_reported || parser->errors() != errors_reported)
         {
-            // Convert IMU Quaternion data
-            double quatW = (double)((signed short)(sensorData[1] << 8 | sensorData[0])) / 16384.0;
-            double quatX = (double)((signed short)(sensorData[3] << 8 | sensorData[2])) / 16384.0;
-            double quatY = (double)((signed short)(sensorData[5] << 8 | sensorData[4])) / 16384.0;
-            double quatZ = (double)((signed short)(sensorData[7] << 8 | sensorData[6])) / 16384.0;
+            ROS_WARN("Arduino link: %u frames, %u dropped, %u %s", parser->frames(), parser->droppedFrames(),
+                     parser->errors(), parser->protocol() == PROTOCOL_BINARY ? "crc errors" : "resyncs");
+            dropped_reported = parser->droppedFrames();
+            errors_reported = parser->errors();
+        }
+    }
+    reader_done.store(true);
+}
 
-            // Convert linear acceleration and angular velocity
-            double xaccel = (double)(((signed short)(sensorData[9] << 8 | sensorData[8])) / 100.0);
-            double zgyro = (double)(((signed short)(sensorData[11] << 8 | sensorData[10])) / 16.0);
+// Blocks until the reader queues packets, then stamps and publishes them
+void publishLoop()
+{
+    struct pollfd pfd;
+    pfd.fd = packet_event_fd;
+    pfd.events = POLLIN;
+
+    while (running.load() && ros::ok() && !reader_done.load())
+    {
+        pfd.revents = 0;
+        if (poll(&pfd, 1, READ_TIMEOUT_MS) > 0)
+        {
+            uint64_t events;
+            if (read(packet_event_fd, &events, sizeof(events)) < 0)
+            {
+                ROS_ERROR("Could not read the packet event");
+            }
+        }
 
-            if (first_msg)
+        StampedPacket item;
+        while (packet_queue.pop(item))
+        {
+            ros::Time stamp = item.arrival;
+            if (sequence_clock)
             {
-                // Save the initial orientation so that the imu is aligned to the courses axis and not the earth's field
-                tf::Quaternion temp(quatX, quatY, quatZ, quatW);
-                transformation.setRPY(0,0,-tf::getYaw(temp)+starting_theta);
-                ROS_INFO("First Yaw: %f", tf::getYaw(temp));
-                ROS_INFO("Transformation: %f", -tf::getYaw(temp)+starting_theta);
-                first_msg = false;
+                stamp.fromSec(sequence_clock->update(item.packet.seq, item.arrival.toSec()));
             }
 
-            sensor_msgs::Imu imu_msg;
-            imu_msg.header.frame_id = "base_link";
-            imu_msg.header.stamp =  ros::Time::now();
-
-            // Rotate current rotation into new frame
-            tf::Quaternion quat(quatX, quatY, quatZ, quatW);
-            ROS_INFO("Non corrected Yaw: %f", tf::getYaw(quat));
-            quat = (transformation * quat).normalize();
-            ROS_INFO("Yaw: %f", tf::getYaw(quat));
-
-            imu_msg.orientation.x = quat.x();
-            imu_msg.orientation.y = quat.y();
-            imu_msg.orientation.z = quat.z();
-            imu_msg.orientation.w = quat.w();
-            imu_msg.orientation_covariance = {0.001, 0, 0,
-                                              0, 0.001, 0,
-                                              0, 0, 0.001};
-
-            imu_msg.angular_velocity.z = zgyro;
-            imu_msg.angular_velocity_covariance = {-1, 0, 0,
-                                                   0, -1, 0,
-                                                   0, 0, 0.05};
-            imu_msg.linear_acceleration.x = xaccel;
-            imu_msg.angular_velocity_covariance = {0.1, 0, 0,
-                                                   0, -1, 0,
-                                                   0, 0, -1};
-
-            // Print out what the Arduino is sending...
-            std::bitset<8> data_received(sensorData[12]);
-
-            // ROS_INFO("Received arduino data: %i", (int)data_received.to_ulong());
-            // Parse the byte, bits 3 and 2 are survivor data, 1 is food and 0 is fire
-            survivor_msg.data = (int)((data_received & survivor_bitmap) >> 2).to_ulong();
-            fire_msg.data = (bool)(data_received & fire_bitmap).to_ulong();
-            fire_left_msg.data = (bool)(data_received & fire_left_bitmap).to_ulong();
-            fire_right_msg.data = (bool)(data_received & fire_right_bitmap).to_ulong();
-
-            // Publish message, and spin thread
-            imu_pub.publish(imu_msg);
-            survivor_pub.publish(survivor_msg);
-            fire_pub.publish(fire_msg);
-            fire_left_pub.publish(fire_left_msg);
-            fire_right_pub.publish(fire_right_msg);
-            ros::spinOnce();
+            // Imu has no trace id field, its stamp is used instead
+            uint64_t trace_id = stamp.toNSec();
+            traceRecord(TRACE_INSTANT, "serial_frame_read", trace_id, item.read_ns);
+            TraceScope scope("serial_publish", trace_id);
+            tracePublish("imu", trace_id);
+            publishSensorData(item.packet.data, stamp);
         }
-        loop_rate.sleep();
     }
-    return 0;
 }
+
+bool start(ros::NodeHandle& nh, ros::NodeHandle& private_nh)
+{
+    float temp_theta;
+    nh.getParam("/bill/starting_params/theta", temp_theta);
+    starting_theta = (temp_theta)*M_PI/180.0;
+
+    std::string source_type = "serial";
+    std::string port = "/dev/ttyACM0";
+    std::string protocol = "binary";
+    std::string replay_file;
+    std::string record_path;
+    private_nh.getParam("source", source_type);
+    private_nh.getParam("port", port);
+    private_nh.getParam("protocol", protocol);
+    private_nh.getParam("replay_file", replay_file);
+    private_nh.getParam("record_file", record_path);
+    bool binary = (protocol == "binary");
+    if (!binary && protocol != "text")
+    {
+        ROS_ERROR("Unknown serial protocol %s, expected text or binary", protocol.c_str());
+        return false;
+    }
+    int baud = binary ? BINARY_BAUD : TEXT_BAUD;
+    private_nh.getParam("baud", baud);
+
+    // Stamps from the sequence counter need the Arduino to send at a fixed period, only the binary sketch does
+    bool clock_estimation = false;
+    double arduino_period = 0.01;
+    private_nh.getParam("clock_estimation", clock_estimation);
+    private_nh.getParam("arduino_period", arduino_period);
+    if (clock_estimation && !binary)
+    {
+        ROS_WARN("Clock estimation needs the binary protocol, stamping on arrival");
+        clock_estimation = false;
+    }
+
+    std::string trace_dir;
+    if (nh.getParam("/trace_dir", trace_dir) && !traceOpen(trace_dir, ros::this_node::getName()))
+    {
+        ROS_WARN("Could not open a trace file in %s", trace_dir.c_str());
+    }
+
+    survivor_pub = nh.advertise<bill_msgs::Survivor>("survivors", 100);
+    fire_pub = nh.advertise<std_msgs::Bool>("fire", 100);
+    fire_left_pub = nh.advertise<std_msgs::Bool>("fire_left", 100);
+    fire_right_pub = nh.advertise<std_msgs::Bool>("fire_right", 100);
+    imu_pub = nh.advertise<sensor_msgs::Imu>("imu", 100);
+
+    PtyByteSource* pty = NULL;
+    if (source_type == "pty")
+    {
+        pty = new PtyByteSource();
+        source.reset(pty);
+    }
+    else if (source_type == "replay")
+    {
+        source.reset(new FdByteSource(replay_file));
+    }
+    else
+    {
+        source.reset(new SerialByteSource(port, baud));
+    }
+
+    if (source->open())
+    {
+        ROS_INFO("Serial port is open! Using the %s protocol from %s", protocol.c_str(), source_type.c_str());
+        if (pty != NULL)
+        {
+            ROS_INFO("Write Arduino data to %s", pty->slaveName().c_str());
+        }
+    }
+    else
+    {
+        ROS_ERROR("Serial port not open!!!");
+        return false;
+    }
+
+    if (!record_path.empty() && (record_file = fopen(record_path.c_str(), "wb")) == NULL)
+    {
+        ROS_ERROR("Could not open serial record file %s", record_path.c_str());
+    }
+
+    packet_event_fd = eventfd(0, EFD_CLOEXEC);
+    if (packet_event_fd < 0)
+    {
+        ROS_ERROR("Could not create the packet eventfd");
+        return false;
+    }
+
+    parser.reset(new ArduinoFrameParser(binary ? PROTOCOL_BINARY : PROTOCOL_TEXT));
+    if (clock_estimation)
+    {
+        sequence_clock.reset(new SequenceClock(arduino_period));
+    }
+
+    running.store(true);
+    reader_thread = std::thread(readerThread, BITS_PER_BYTE / baud);
+    publisher_thread = std::thread(publishLoop);
+    return true;
+}
+
+void stop()
+{
+    running.store(false);
+    if (reader_thread.joinable())
+    {
+        reader_thread.join();
+    }
+    if (publisher_thread.joinable())
+    {
+        publisher_thread.join();
+    }
+    if (packet_event_fd >= 0)
+    {
+        close(packet_event_fd);
+        packet_event_fd = -1;
+    }
+    if (record_file != NULL)
+    {
+        fclose(record_file);
+        record_file = NULL;
+    }
+    traceDump();
+}
+}  // namespace serial_driver
@@ -0,0 +1,17 @@
+#include "ros/ros.h"
+#include "bill_drivers/driver_nodes.hpp"
+
+int main(int argc, char** argv)
+{
+    ros::init(argc, argv, "serial_driver");
+    ros::NodeHandle nh;
+    ros::NodeHandle private_nh("~");
+
+    if (!serial_driver::start(nh, private_nh))
+    {
+        return 1;
+    }
+    ros::spin();
+    serial_driver::stop();
+    return 0;
+}
@@ -0,0 +1,144 @@
+// Measures ArduinoFrameParser throughput without the robot.
+// Usage: serial_parser_bench <text|binary> [recording] [frames] [chunk_bytes]
+// Without a recording, frames are synthesized. The recording (e.g. from serial_driver _record_file:=...) is pushed
+// through the parser repeatedly until the requested number of frames has been parsed
+#include "bill_drivers/arduino_protocol.hpp"
+#include "bill_drivers/byte_source.hpp"
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+const size_t DEFAULT_FRAMES = 5000000;
+const size_t DEFAULT_CHUNK = 64;
+const int SYNTHETIC_FRAMES = 1024;
+
+void appendFrame(std::vector<uint8_t>& stream, ArduinoProtocol protocol, const uint8_t* payload, uint8_t seq)
+{
+    if (protocol == PROTOCOL_BINARY)
+    {
+        uint8_t frame[ARDUINO_PAYLOAD_LENGTH + 6];
+        frame[0] = FRAME_SYNC_1;
+        frame[1] = FRAME_SYNC_2;
+        frame[2] = ARDUINO_PAYLOAD_LENGTH;
+        frame[3] = seq;
+        memcpy(&frame[4], payload, ARDUINO_PAYLOAD_LENGTH);
+        uint16_t crc = crc16Ccitt(&frame[2], ARDUINO_PAYLOAD_LENGTH + 2);
+        frame[ARDUINO_PAYLOAD_LENGTH + 4] = crc & 0xFF;
+        frame[ARDUINO_PAYLOAD_LENGTH + 5] = crc >> 8;
+        stream.insert(stream.end(), frame, frame + sizeof(frame));
+    }
+    else
+    {
+        char line[ARDUINO_PAYLOAD_LENGTH * 4 + 3];
+        int length = 0;
+        for (int i = 0; i < ARDUINO_PAYLOAD_LENGTH; i++)
+        {
+            length += sprintf(line + length, "%u ", payload[i]);
+        }
+        length += sprintf(line + length, "\r\n");
+        stream.insert(stream.end(), line, line + length);
+    }
+}
+
+void synthesize(std::vector<uint8_t>& stream, ArduinoProtocol protocol)
+{
+    srand(1);
+    uint8_t payload[ARDUINO_PAYLOAD_LENGTH];
+    for (int frame = 0; frame < SYNTHETIC_FRAMES; frame++)
+    {
+        for (int i = 0; i < ARDUINO_PAYLOAD_LENGTH; i++)
+        {
+            payload[i] = rand() & 0xFF;
+        }
+        appendFrame(stream, protocol, payload, (uint8_t)frame);
+    }
+}
+
+bool load(std::vector<uint8_t>& stream, const std::string& path)
+{
+    FdByteSource source(path);
+    if (!source.open())
+    {
+        return false;
+    }
+
+    uint8_t buffer[4096];
+    int n;
+    while ((n = source.read(buffer, sizeof(buffer), 0)) >= 0)
+    {
+        stream.insert(stream.end(), buffer, buffer + n);
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || (strcmp(argv[1], "text") != 0 && strcmp(argv[1], "binary") != 0))
+    {
+        fprintf(stderr, "Usage: %s <text|binary> [recording] [frames] [chunk_bytes]\n", argv[0]);
+        return 1;
+    }
+    ArduinoProtocol protocol = strcmp(argv[1], "binary") == 0 ? PROTOCOL_BINARY : PROTOCOL_TEXT;
+    size_t target_frames = argc > 3 ? strtoul(argv[3], NULL, 10) : DEFAULT_FRAMES;
+    size_t chunk = argc > 4 ? strtoul(argv[4], NULL, 10) : DEFAULT_CHUNK;
+    if (chunk == 0)
+    {
+        chunk = DEFAULT_CHUNK;
+    }
+
+    std::vector<uint8_t> stream;
+    if (argc > 2 && strcmp(argv[2], "-") != 0)
+    {
+        if (!load(stream, argv[2]))
+        {
+            fprintf(stderr, "Could not read %s\n", argv[2]);
+            return 1;
+        }
+    }
+    else
+    {
+        synthesize(stream, protocol);
+    }
+
+    ArduinoFrameParser parser(protocol);
+    ArduinoPacket packet;
+    uint32_t checksum = 0;
+    size_t bytes = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while (parser.frames() < target_frames)
+    {
+        uint32_t frames_before = parser.frames();
+        for (size_t offset = 0; offset < stream.size(); offset += chunk)
+        {
+            size_t length = std::min(chunk, stream.size() - offset);
+            size_t consumed = 0;
+            while (consumed < length)
+            {
+                bool complete;
+                consumed += parser.parse(&stream[offset + consumed], length - consumed, packet, complete);
+                if (complete)
+                {
+                    checksum += packet.data[0] + packet.data[ARDUINO_PAYLOAD_LENGTH - 1];
+                }
+            }
+        }
+        bytes += stream.size();
+        if (parser.frames() == frames_before)
+        {
+            fprintf(stderr, "No frames found in the input\n");
+            return 1;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%s: %u frames, %zu bytes in %.3f s\n", argv[1], parser.frames(), bytes, seconds);
+    printf("%.1f ns/frame, %.1f MB/s, %.0f frames/s\n", seconds * 1e9 / parser.frames(), bytes / seconds / 1e6,
+           parser.frames() / seconds);
+    printf("dropped %u, errors %u, checksum %u\n", parser.droppedFrames(), parser.errors(), checksum);
+    return 0;
+}
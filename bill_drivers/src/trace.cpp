@@ -0,0 +1,217 @@
+#include "bill_drivers/trace.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <inttypes.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+struct TraceEvent
+{
+    uint64_t timestamp_ns;
+    uint64_t id;
+    const char* name;
+    char phase;
+};
+
+// Written only by its own thread. The count is published after the event, so the dump never sees a half written one
+struct TraceBuffer
+{
+    int tid;
+    size_t capacity;
+    std::unique_ptr<TraceEvent[]> events;
+    std::atomic<size_t> count;
+    std::atomic<uint64_t> dropped;
+};
+
+struct TraceState
+{
+    std::mutex mutex;  // Only taken when a thread records its first event and when dumping
+    std::vector<TraceBuffer*> buffers;
+    std::string path;
+    std::string process_name;
+    size_t events_per_thread;
+};
+
+static std::atomic<bool> trace_enabled(false);
+static std::atomic<uint64_t> last_trace_id(0);
+// Never freed, threads can still be recording while static objects are destroyed at exit
+static TraceState* trace_state = new TraceState();
+static thread_local TraceBuffer* thread_buffer = NULL;
+
+static TraceBuffer* registerThread()
+{
+    std::lock_guard<std::mutex> guard(trace_state->mutex);
+    TraceBuffer* buffer = new TraceBuffer();
+    buffer->tid = (int)syscall(SYS_gettid);
+    buffer->capacity = trace_state->events_per_thread;
+    buffer->events.reset(new TraceEvent[buffer->capacity]);
+    buffer->count.store(0);
+    buffer->dropped.store(0);
+    trace_state->buffers.push_back(buffer);
+    return buffer;
+}
+
+bool traceOpen(const std::string& directory, const std::string& process_name, size_t events_per_thread)
+{
+    std::lock_guard<std::mutex> guard(trace_state->mutex);
+    if (trace_enabled.load())
+    {
+        return true;
+    }
+
+    // Node names start with a slash and may contain namespaces
+    std::string file_name = process_name;
+    for (size_t i = 0; i < file_name.size(); i++)
+    {
+        if (file_name[i] == '/')
+        {
+            file_name[i] = '_';
+        }
+    }
+    if (!file_name.empty() && file_name[0] == '_')
+    {
+        file_name.erase(0, 1);
+    }
+
+    trace_state->path = directory + "/" + file_name + ".json";
+    trace_state->process_name = process_name;
+    trace_state->events_per_thread = events_per_thread;
+
+    // Check the file can be written now rather than finding out at shutdown
+    FILE* file = fopen(trace_state->path.c_str(), "w");
+    if (file == NULL)
+    {
+        return false;
+    }
+    fclose(file);
+
+    trace_enabled.store(true);
+    return true;
+}
+
+bool traceEnabled()
+{
+    return trace_enabled.load(std::memory_order_relaxed);
+}
+
+uint64_t traceNowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// The monotonic time of creation, bumped to stay unique within the process
+uint64_t traceNewId()
+{
+    uint64_t id = traceNowNs();
+    uint64_t last = last_trace_id.load(std::memory_order_relaxed);
+    do
+    {
+        if (id <= last)
+        {
+            id = last + 1;
+        }
+    } while (!last_trace_id.compare_exchange_weak(last, id, std::memory_order_relaxed));
+    return id;
+}
+
+void traceRecord(TracePhase phase, const char* name, uint64_t id, uint64_t timestamp_ns)
+{
+    if (!trace_enabled.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    TraceBuffer* buffer = thread_buffer;
+    if (buffer == NULL)
+    {
+        buffer = thread_buffer = registerThread();
+    }
+
+    size_t index = buffer->count.load(std::memory_order_relaxed);
+    if (index >= buffer->capacity)
+    {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    TraceEvent& event = buffer->events[index];
+    event.timestamp_ns = timestamp_ns != 0 ? timestamp_ns : traceNowNs();
+    event.id = id;
+    event.name = name;
+    event.phase = (char)phase;
+    buffer->count.store(index + 1, std::memory_order_release);
+}
+
+static void writeEvent(FILE* file, const TraceEvent& event, int pid, int tid)
+{
+    fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%" PRIu64 ".%03u,\"pid\":%i,\"tid\":%i", event.name,
+            event.phase, event.timestamp_ns / 1000, (unsigned)(event.timestamp_ns % 1000), pid, tid);
+    switch (event.phase)
+    {
+        case TRACE_FLOW_START:
+            fprintf(file, ",\"cat\":\"message\",\"id\":\"0x%" PRIx64 "\"}", event.id);
+            break;
+        case TRACE_FLOW_END:
+            // Binds to the slice the message is received in
+            fprintf(file, ",\"cat\":\"message\",\"id\":\"0x%" PRIx64 "\",\"bp\":\"e\"}", event.id);
+            break;
+        case TRACE_INSTANT:
+            fprintf(file, ",\"cat\":\"bill\",\"s\":\"t\",\"args\":{\"trace_id\":\"0x%" PRIx64 "\"}}", event.id);
+            break;
+        default:
+            fprintf(file, ",\"cat\":\"bill\",\"args\":{\"trace_id\":\"0x%" PRIx64 "\"}}", event.id);
+            break;
+    }
+}
+
+bool traceDump()
+{
+    if (!trace_enabled.load())
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(trace_state->mutex);
+    FILE* file = fopen(trace_state->path.c_str(), "w");
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    int pid = (int)getpid();
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%i,\"tid\":0,\"args\":{\"name\":\"%s\"}}", pid,
+            trace_state->process_name.c_str());
+    for (size_t b = 0; b < trace_state->buffers.size(); b++)
+    {
+        const TraceBuffer* buffer = trace_state->buffers[b];
+        size_t count = buffer->count.load(std::memory_order_acquire);
+        fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%i,\"tid\":%i,"
+                "\"args\":{\"name\":\"thread %i\",\"dropped_events\":%" PRIu64 "}}",
+                pid, buffer->tid, buffer->tid, buffer->dropped.load());
+        for (size_t i = 0; i < count; i++)
+        {
+            writeEvent(file, buffer->events[i], pid, buffer->tid);
+        }
+    }
+    fprintf(file, "\n]}\n");
+    return fclose(file) == 0;
+}
+
+TraceScope::TraceScope(const char* name, uint64_t id)
+{
+    _name = name;
+    _id = id;
+    traceRecord(TRACE_BEGIN, _name, _id);
+}
+
+TraceScope::~TraceScope()
+{
+    traceRecord(TRACE_END, _name, _id);
+}
@@ -0,0 +1,124 @@
+#include "bill_drivers/wheel_ticks.hpp"
+
+// Below this many edges inside the estimation window the wheel is slow enough that the last edge period is a better
+// velocity estimate than counting edges
+const uint32_t MIN_EDGES_FOR_COUNTING = 4;
+// With no edge for this long the wheel is considered stopped
+const uint64_t STOPPED_TIMEOUT_NS = 250000000ull;
+
+WheelTicks::WheelTicks()
+{
+    _count.store(0);
+    _direction.store(1);
+    _head.store(0);
+    for (uint32_t i = 0; i < HISTORY; i++)
+    {
+        _stamps[i].store(0);
+    }
+    _count_prev = 0;
+}
+
+void WheelTicks::addEdge(uint64_t timestamp_ns)
+{
+    // Only the edge thread writes, so plain loads and stores are enough and no read-modify-write is needed
+    _count.store(_count.load(std::memory_order_relaxed) + _direction.load(std::memory_order_relaxed),
+                 std::memory_order_release);
+
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    _stamps[head & (HISTORY - 1)].store(timestamp_ns, std::memory_order_relaxed);
+    _head.store(head + 1, std::memory_order_release);
+}
+
+void WheelTicks::setDirection(int direction)
+{
+    _direction.store(direction, std::memory_order_relaxed);
+}
+
+int WheelTicks::getDirection() const
+{
+    return _direction.load(std::memory_order_relaxed);
+}
+
+int32_t WheelTicks::count() const
+{
+    return _count.load(std::memory_order_acquire);
+}
+
+uint64_t WheelTicks::lastEdgeNs() const
+{
+    uint32_t head = _head.load(std::memory_order_acquire);
+    return head == 0 ? 0 : _stamps[(head - 1) & (HISTORY - 1)].load(std::memory_order_relaxed);
+}
+
+int32_t WheelTicks::takeDelta()
+{
+    int32_t current = count();
+    int32_t delta = current - _count_prev;
+    _count_prev = current;
+    return delta;
+}
+
+// Copies up to max_edges of the most recent edge stamps, newest first, and returns how many are valid
+uint32_t WheelTicks::recentEdges(uint64_t* stamps, uint32_t max_edges) const
+{
+    uint32_t head = _head.load(std::memory_order_acquire);
+    uint32_t n = head < max_edges ? head : max_edges;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        stamps[i] = _stamps[(head - 1 - i) & (HISTORY - 1)].load(std::memory_order_relaxed);
+    }
+
+    // The writer may have lapped us while copying, drop any slot that could have been overwritten
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint32_t head_after = _head.load(std::memory_order_relaxed);
+    uint32_t overwritten = head_after - head;
+    if (overwritten >= HISTORY - n)
+    {
+        uint32_t lost = overwritten - (HISTORY - n) + 1;
+        n = lost >= n ? 0 : n - lost;
+    }
+    return n;
+}
+
+// Count/dt over the edges inside the window at speed, 1/T from the last edge period when slow
+float WheelTicks::ticksPerSecond(uint64_t now_ns, uint64_t window_ns) const
+{
+    uint64_t stamps[HISTORY - 1];
+    uint32_t n = recentEdges(stamps, HISTORY - 1);
+    if (n < 2)
+    {
+        return 0;
+    }
+
+    uint64_t newest = stamps[0];
+    uint64_t age = now_ns > newest ? now_ns - newest : 0;
+    if (age > STOPPED_TIMEOUT_NS)
+    {
+        return 0;
+    }
+
+    // A stamp ahead of now counts as now rather than wrapping around to a huge age
+    uint32_t in_window = 0;
+    while (in_window < n && (stamps[in_window] >= now_ns || now_ns - stamps[in_window] <= window_ns))
+    {
+        in_window++;
+    }
+
+    float rate;
+    if (in_window >= MIN_EDGES_FOR_COUNTING && newest > stamps[in_window - 1])
+    {
+        rate = (in_window - 1) * 1e9f / (float)(newest - stamps[in_window - 1]);
+    }
+    else
+    {
+        // If it has been longer than the last period since the last edge, the wheel is at least that slow by now
+        uint64_t period = newest - stamps[1];
+        if (age > period)
+        {
+            period = age;
+        }
+        rate = period > 0 ? 1e9f / (float)period : 0;
+    }
+
+    return getDirection() * rate;
+}
@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+#include "bill_drivers/magnet_detector.hpp"
+
+static const float SAMPLE_RATE = 200;
+static const float RISE = 2500;
+static const float RELEASE = 1500;
+static const float AMBIENT = 500;
+
+class MagnetDetectorTest : public ::testing::Test
+{
+protected:
+    MagnetDetectorTest() : _detector(SAMPLE_RATE, RISE, RELEASE) {}
+
+    void SetUp()
+    {
+        feed(AMBIENT, 400);
+    }
+
+    // Returns the sample on which the state changed, -1 if it didn't
+    int feed(float magnitude, int samples)
+    {
+        int changed = -1;
+        for (int i = 0; i < samples; i++)
+        {
+            if (_detector.update(magnitude) && changed < 0)
+            {
+                changed = i;
+            }
+        }
+        return changed;
+    }
+
+    MagnetDetector _detector;
+};
+
+TEST_F(MagnetDetectorTest, IgnoresASingleSpike)
+{
+    EXPECT_EQ(-1, feed(20000, 1));
+    EXPECT_EQ(-1, feed(AMBIENT, 10));
+    EXPECT_FALSE(_detector.present());
+    EXPECT_NEAR(AMBIENT, _detector.baseline(), 1);
+}
+
+TEST_F(MagnetDetectorTest, IgnoresTwoSpikesInAWindow)
+{
+    feed(20000, 1);
+    feed(AMBIENT, 1);
+    EXPECT_EQ(-1, feed(20000, 1));
+    EXPECT_EQ(-1, feed(AMBIENT, 10));
+    EXPECT_FALSE(_detector.present());
+}
+
+TEST_F(MagnetDetectorTest, DetectsAStepWithinThreeSamples)
+{
+    EXPECT_EQ(2, feed(AMBIENT + 4000, 20));
+    EXPECT_TRUE(_detector.present());
+    EXPECT_NEAR(AMBIENT, _detector.baseline(), 1);
+}
+
+TEST_F(MagnetDetectorTest, HoldsBetweenReleaseAndRise)
+{
+    feed(AMBIENT + 4000, 20);
+    EXPECT_EQ(-1, feed(AMBIENT + 2000, 20));
+    EXPECT_TRUE(_detector.present());
+    EXPECT_EQ(2, feed(AMBIENT, 20));
+    EXPECT_FALSE(_detector.present());
+}
+
+TEST(MagnetDetector, SlowRatesStillRejectSpikes)
+{
+    MagnetDetector detector(10, RISE, RELEASE);
+    for (int i = 0; i < 100; i++)
+    {
+        detector.update(AMBIENT);
+    }
+    EXPECT_FALSE(detector.update(20000));
+    EXPECT_FALSE(detector.update(AMBIENT));
+    EXPECT_FALSE(detector.present());
+}
+
+int main(int argc, char** argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
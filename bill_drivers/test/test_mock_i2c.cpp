@@ -0,0 +1,171 @@
+#include <gtest/gtest.h>
+#include "bill_drivers/CrossPlatformI2C.h"
+#include "bill_drivers/MPU.h"
+#include "bill_drivers/i2c_bus.hpp"
+#include <vector>
+
+#if !defined(ARDUINO) && !defined(__arm__)
+// wiringPi has it on the Pi. MPU.cpp only calls it while calibrating, which these tests don't
+void delay(uint32_t msec)
+{
+    (void)msec;
+}
+#endif
+
+// The register logic shared by every MPU, on the mock cpi2c_ backend
+class MockMPU : public MPUIMU
+{
+public:
+    static const uint8_t ADDRESS = 0x68;
+    using MPUIMU::ACCEL_XOUT_H;
+    using MPUIMU::CONFIG;
+    using MPUIMU::FIFO_COUNTH;
+    using MPUIMU::FIFO_R_W;
+    using MPUIMU::SMPLRT_DIV;
+
+    explicit MockMPU(uint16_t fifoBytes = 512) : MPUIMU(AFS_2G, GFS_250DPS, 0)
+    {
+        _accelBias[0] = _accelBias[1] = _accelBias[2] = 0;
+        _handle = cpi2c_open(ADDRESS, 1);
+        _fifoBytes = fifoBytes;
+    }
+
+protected:
+    uint16_t fifoSize(void) override
+    {
+        return _fifoBytes;
+    }
+
+    void writeMPURegister(uint8_t subAddress, uint8_t data) override
+    {
+        cpi2c_writeRegister(_handle, subAddress, data);
+    }
+
+    void readMPURegisters(uint8_t subAddress, uint8_t count, uint8_t * dest) override
+    {
+        cpi2c_readRegisters(_handle, subAddress, count, dest);
+    }
+
+private:
+    uint8_t _handle;
+    uint16_t _fifoBytes;
+};
+
+// Reads a register per byte, as the WiringPi backend does
+class BytewiseMPU : public MockMPU
+{
+protected:
+    bool burstReadsFifo(void) override
+    {
+        return false;
+    }
+};
+
+// Streams at 1 kHz and queues the packets, reporting their bytes in FIFO_COUNT
+static void queuePackets(MockMPU& mpu, int packets)
+{
+    const uint8_t config = 0x01;
+    const uint8_t divisor = 0;
+    cpi2c_mockWrite(MockMPU::ADDRESS, MockMPU::CONFIG, &config, 1);
+    cpi2c_mockWrite(MockMPU::ADDRESS, MockMPU::SMPLRT_DIV, &divisor, 1);
+    mpu.startStreaming();
+
+    std::vector<uint8_t> fifo(packets * 12, 0);
+    for (int i = 0; i < packets; i++)
+    {
+        fifo[i * 12 + 1] = i + 1;   // ax LSB
+        fifo[i * 12 + 7] = i + 10;  // gx LSB
+    }
+    cpi2c_mockPushFifo(MockMPU::ADDRESS, MockMPU::FIFO_R_W, fifo.data(), fifo.size());
+    const uint8_t count[2] = {(uint8_t)(fifo.size() >> 8), (uint8_t)fifo.size()};
+    cpi2c_mockWrite(MockMPU::ADDRESS, MockMPU::FIFO_COUNTH, count, 2);
+}
+
+class MockI2CTest : public ::testing::Test
+{
+protected:
+    void SetUp()
+    {
+        cpi2c_mockReset();
+    }
+
+    MockMPU _mpu;
+};
+
+TEST_F(MockI2CTest, AccelReadIsOneTransaction)
+{
+    // 1 g on z at +-2 g is 16384 counts, -0.5 g on x
+    const uint8_t raw[6] = {0xE0, 0x00, 0x00, 0x00, 0x40, 0x00};
+    cpi2c_mockWrite(MockMPU::ADDRESS, MockMPU::ACCEL_XOUT_H, raw, sizeof(raw));
+    cpi2c_resetTransactions();
+
+    float ax, ay, az;
+    _mpu.readAccelerometer(ax, ay, az);
+
+    EXPECT_EQ(1u, cpi2c_transactions());
+    EXPECT_FLOAT_EQ(-0.5f, ax);
+    EXPECT_FLOAT_EQ(0.0f, ay);
+    EXPECT_FLOAT_EQ(1.0f, az);
+}
+
+TEST_F(MockI2CTest, BurstReadPopsTheFifo)
+{
+    const int packets = 3;
+    queuePackets(_mpu, packets);
+    cpi2c_resetTransactions();
+
+    ImuSampleBatch batch;
+    ASSERT_EQ(packets, _mpu.readBatch(batch, 1000000000ull));
+
+    // The count, then every packet in one burst
+    EXPECT_EQ(2u, cpi2c_transactions());
+    for (int i = 0; i < packets; i++)
+    {
+        EXPECT_FLOAT_EQ((i + 1) * 2.0f / 32768, batch.ax[i]);
+        EXPECT_FLOAT_EQ((i + 10) * 250.0f / 32768, batch.gx[i]);
+    }
+    EXPECT_EQ(1000000000ull, batch.timestamp_ns[packets - 1]);
+
+    uint8_t left = 0xFF;
+    cpi2c_mockRead(MockMPU::ADDRESS, MockMPU::FIFO_R_W, &left, 1);
+    EXPECT_EQ(0, left);
+}
+
+TEST_F(MockI2CTest, FullFifoIsAnOverflow)
+{
+    // 600 bytes can't be queued in a 512 byte FIFO without overwriting
+    queuePackets(_mpu, 50);
+
+    ImuSampleBatch batch;
+    EXPECT_EQ(0, _mpu.readBatch(batch, 1000000000ull));
+    EXPECT_EQ(1u, _mpu.fifoOverflows());
+}
+
+TEST_F(MockI2CTest, LargerFifoDrainsInOneBatch)
+{
+    MockMPU mpu(1024);
+    queuePackets(mpu, 80);
+
+    ImuSampleBatch batch;
+    ASSERT_EQ(80, mpu.readBatch(batch, 1000000000ull));
+    EXPECT_EQ(0u, mpu.fifoOverflows());
+    EXPECT_FLOAT_EQ(80 * 2.0f / 32768, batch.ax[79]);
+}
+
+TEST_F(MockI2CTest, StreamingNeedsBurstReads)
+{
+    BytewiseMPU mpu;
+    cpi2c_resetTransactions();
+
+    EXPECT_FALSE(mpu.startStreaming());
+    EXPECT_EQ(0u, cpi2c_transactions());
+
+    ImuSampleBatch batch;
+    EXPECT_EQ(0, mpu.readBatch(batch, 1000000000ull));
+}
+
+int main(int argc, char** argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
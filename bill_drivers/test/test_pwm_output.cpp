@@ -0,0 +1,45 @@
+#include <gtest/gtest.h>
+#include <memory>
+#include "bill_drivers/pwm_output.hpp"
+
+TEST(PwmOutput, AutoPicksHardwareOnlyWhenEveryPinHasIt)
+{
+    EXPECT_EQ("sysfs", resolvePwmBackend("auto", {12, 13}));
+    EXPECT_EQ("sysfs", resolvePwmBackend("auto", {18, 19}));
+    // Motor B's GPIO10 keeps motor A off the hardware channel too
+    EXPECT_EQ("soft", resolvePwmBackend("auto", {12, 10}));
+    EXPECT_EQ("soft", resolvePwmBackend("auto", {10, 12}));
+}
+
+TEST(PwmOutput, ForcedBackendsPassThrough)
+{
+    EXPECT_EQ("sysfs", resolvePwmBackend("sysfs", {12, 10}));
+    EXPECT_EQ("soft", resolvePwmBackend("soft", {12, 13}));
+    EXPECT_EQ("sim", resolvePwmBackend("sim", {12, 10}));
+}
+
+TEST(PwmOutput, CreatesTheResolvedBackend)
+{
+    std::unique_ptr<PwmOutput> hardware(createPwmOutput("auto", 12, 20000, 100));
+    std::unique_ptr<PwmOutput> soft(createPwmOutput("auto", 10, 20000, 100));
+    std::unique_ptr<PwmOutput> sim(createPwmOutput("sim", 12, 20000, 100));
+    EXPECT_TRUE(dynamic_cast<SysfsPwmOutput*>(hardware.get()) != NULL);
+    EXPECT_TRUE(dynamic_cast<SoftPwmOutput*>(soft.get()) != NULL);
+    EXPECT_TRUE(dynamic_cast<SimPwmOutput*>(sim.get()) != NULL);
+}
+
+TEST(PwmOutput, SimClampsTheDuty)
+{
+    SimPwmOutput pwm;
+    ASSERT_TRUE(pwm.start());
+    pwm.write(1.5f);
+    EXPECT_FLOAT_EQ(1.0f, pwm.duty());
+    pwm.write(-0.2f);
+    EXPECT_FLOAT_EQ(0.0f, pwm.duty());
+}
+
+int main(int argc, char** argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+#include "bill_drivers/wheel_ticks.hpp"
+
+static const uint64_t MS = 1000000ull;
+
+// Edges every period_ms, the last one at last_ns
+static void feedEdges(WheelTicks& ticks, int edges, uint64_t period_ms, uint64_t last_ns)
+{
+    for (int i = edges - 1; i >= 0; i--)
+    {
+        ticks.addEdge(last_ns - i * period_ms * MS);
+    }
+}
+
+TEST(WheelTicks, CountsEdgesInTheWindow)
+{
+    WheelTicks ticks;
+    feedEdges(ticks, 20, 10, 1000 * MS);
+    EXPECT_NEAR(100, ticks.ticksPerSecond(1005 * MS, 100 * MS), 1);
+}
+
+TEST(WheelTicks, DecaysToZeroOnceStopped)
+{
+    WheelTicks ticks;
+    feedEdges(ticks, 20, 10, 1000 * MS);
+    EXPECT_LT(ticks.ticksPerSecond(1100 * MS, 100 * MS), 100);
+    EXPECT_EQ(0, ticks.ticksPerSecond(1300 * MS, 100 * MS));
+}
+
+TEST(WheelTicks, StampsAheadOfNowCountAsNow)
+{
+    // The last edge was stamped slightly after now was read. Counting the 10 edges from 900 to 1000 ms gives 90/s,
+    // the last 20 ms period alone would give 50/s
+    WheelTicks ticks;
+    feedEdges(ticks, 20, 10, 980 * MS);
+    ticks.addEdge(1000 * MS);
+    EXPECT_NEAR(90, ticks.ticksPerSecond(995 * MS, 100 * MS), 1);
+
+    // Once now catches up and passes the timeout the wheel is stopped
+    EXPECT_EQ(0, ticks.ticksPerSecond(1300 * MS, 100 * MS));
+}
+
+TEST(WheelTicks, DirectionSetsTheSign)
+{
+    WheelTicks ticks;
+    ticks.setDirection(-1);
+    feedEdges(ticks, 20, 10, 1000 * MS);
+    EXPECT_NEAR(-100, ticks.ticksPerSecond(1000 * MS, 100 * MS), 1);
+    EXPECT_EQ(-20, ticks.takeDelta());
+}
+
+int main(int argc, char** argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,71 @@
+#ifndef BILL_PLANNING_DSTAR_LITE_HPP
+#define BILL_PLANNING_DSTAR_LITE_HPP
+
+#include <stdint.h>
+#include <vector>
+#include "bill_planning/path_costs.hpp"
+#include "bill_drivers/arena_map.hpp"
+
+// D* Lite (Koenig and Likhachev, 2002) over the same (tile, heading) states as GraphPath's A*.
+// The search runs backwards from the goal and keeps its costs between queries. When an edge opens or closes, or the
+// robot moves along the path, only the states whose cost changed are expanded again
+class DStarLite
+{
+    public:
+        DStarLite();
+        // Takes a copy of the course, the next plan searches from scratch
+        void setMap(const ArenaMap& map);
+        void setCosts(const PathCosts& costs);
+        // Opens or closes driving from tile towards heading. Repairs the search if there is one
+        void setEdge(int tile, int heading, bool open);
+
+        // Fills path with the tiles from start to goal, turns in place are not repeated. Returns the number of tiles,
+        // 0 if the goal can't be reached
+        int plan(int startTile, int startHeading, int goalTile, int* path, int maxLength);
+        float pathCost() const;
+        int expansions() const;  // States expanded by the last plan
+
+    private:
+        struct Key
+        {
+            float k1;
+            float k2;
+            bool operator<(const Key& other) const { return k1 < other.k1 || (k1 == other.k1 && k2 < other.k2); }
+            bool operator==(const Key& other) const { return k1 == other.k1 && k2 == other.k2; }
+        };
+
+        struct QueueEntry
+        {
+            Key key;
+            int state;
+            bool operator>(const QueueEntry& other) const { return other.key < key; }
+        };
+
+        void reset(int goalTile);
+        float heuristic(int from, int to) const;
+        Key calculateKey(int state) const;
+        int forwardTile(int tile, int heading) const;
+        int successors(int state, int* next, float* cost) const;
+        int predecessors(int state, int* prev, float* cost) const;
+        void updateState(int state);
+        void push(int state, const Key& key);
+        bool top(QueueEntry& entry);
+        void computeShortestPath();
+
+        PathCosts _costs;
+        ArenaMap _map;
+        int _goal;
+        int _start;
+        float _km;
+        int _expansions;
+
+        int _states;
+        std::vector<float> _g;
+        std::vector<float> _rhs;
+        std::vector<bool> _queued;
+        std::vector<Key> _queued_key;
+        // Binary heap with lazy deletion, entries that no longer match _queued_key are skipped
+        std::vector<QueueEntry> _queue;
+};
+
+#endif //BILL_PLANNING_DSTAR_LITE_HPP
@@ -0,0 +1,32 @@
+#ifndef BILL_PLANNING_EVENT_SIGNAL_HPP
+#define BILL_PLANNING_EVENT_SIGNAL_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+// Tells the mission when a callback changes something it may be waiting on, instead of it polling.
+// Whoever changes the state notifies after the change, the listener and any waiters recheck on every notify
+class EventSignal
+{
+    public:
+        void notify();
+        // Also called on every notify, on the notifying thread. Set it before anything notifies
+        void setListener(std::function<void()> listener);
+
+        // Returns the condition, false if it still didn't hold when the timeout ran out
+        template <typename Condition>
+        bool waitFor(Condition condition, std::chrono::milliseconds timeout)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            return _changed.wait_for(lock, timeout, condition);
+        }
+
+    private:
+        std::mutex _mutex;
+        std::condition_variable _changed;
+        std::function<void()> _listener;
+};
+
+#endif //BILL_PLANNING_EVENT_SIGNAL_HPP
@@ -3,22 +3,82 @@
 
 #include <bits/stdc++.h>
 #include "bill_planning/position.hpp"
+#include "bill_planning/path_costs.hpp"
+#include "bill_planning/dstar_lite.hpp"
+#include "bill_planning/path_table.hpp"
+#include "bill_planning/tile_bitboard.hpp"
+#include "bill_planning/tour_planner.hpp"
+#include "bill_drivers/arena_map.hpp"
 #include "ros/ros.h"
 #include <math.h>
 #include <algorithm>
 using namespace std;
 
+enum PathSearch
+{
+    SEARCH_BFS,    // Fewest tiles
+    SEARCH_ASTAR,  // Least drive time, counting the turn at every corner
+    SEARCH_DSTAR,  // Same costs as A*, but repairs the previous search when edges change or the robot moves
+    SEARCH_TABLE   // Same costs as A*, legs are looked up in a table built from the map
+};
+
 class GraphPath
 {
     public:
         GraphPath();
+        // Replaces the course, dropping any obstacles found on the old one
+        void setMap(const ArenaMap& map);
+        const ArenaMap& map() const;
         void add_edge(int src, int dest);
         bool remove_edge(int src, int dest);
-        void getShortestPath(std::list<TilePosition> &drivePoints, TilePosition start, TilePosition dest, bool scanOnReach);
+        // Puts back an edge of the original course that was removed for an obstacle
+        bool restore_edge(int src, int dest);
+        void setSearch(PathSearch search);
+        void setCosts(const PathCosts& costs);
+        // The start heading in degrees lets A* count the first turn, -1 if unknown
+        void getShortestPath(std::list<TilePosition> &drivePoints, TilePosition start, TilePosition dest, bool scanOnReach,
+                             int startHeading = -1);
+        // End of the first straight run from start to dest in constant time, (-1, -1) if dest can't be reached
+        TilePosition nextLeg(TilePosition start, TilePosition dest, int startHeading = -1);
+        // Reorders the stops to visit them in the least time, dropping unreachable ones. Returns the estimated seconds
+        float orderTour(TilePosition start, int startHeading, std::vector<TilePosition>& stops);
+        bool isReachable(TilePosition start, TilePosition dest);
+        // Tiles from start to every tile, in map index order, -1 where it can't be reached
+        int distancesFrom(TilePosition start, std::vector<int>& dist);
 
     private:
-        bool BFS(int src, int dest, int v, int pred[], int dist[]);
+        struct OpenEntry
+        {
+            float priority;
+            int state;
+            bool operator>(const OpenEntry& other) const { return priority > other.priority; }
+        };
+
+        bool BFS(int src, int dest);
+        bool AStar(int src, int dest, int startHeading);
+        float heuristic(int tile, int heading, int dest) const;
+        void appendLegs(std::list<TilePosition> &drivePoints, const int* path, int length, bool scanOnReach) const;
+
+        bool setEdge(int src, int dest, bool open);
+
+        ArenaMap _map;
+        ArenaMap _course;  // The map before any obstacles were found
+        DStarLite _dstar;
+        PathTable _table;
+        TileBitboard _reach;
+        TourPlanner _tour;
+        PathSearch _search = SEARCH_ASTAR;
+        PathCosts _costs;
 
-        vector<int> adj[36];
+        // Search scratch space, sized with the map so planning doesn't allocate
+        std::vector<int> _pred;
+        std::vector<int> _dist;
+        std::vector<int> _queue;
+        std::vector<float> _state_cost;
+        std::vector<int> _state_pred;
+        std::vector<bool> _state_closed;
+        std::vector<int> _path;
+        std::vector<OpenEntry> _open;
+        int _goal_state;
 };
 #endif //BILL_PLANNING_GRAPH_PATH_HPP
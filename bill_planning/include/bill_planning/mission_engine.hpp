@@ -0,0 +1,162 @@
+#ifndef BILL_PLANNING_MISSION_ENGINE_HPP
+#define BILL_PLANNING_MISSION_ENGINE_HPP
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "ros/ros.h"
+#include "bill_planning/planner.hpp"
+#include "bill_planning/sensor_readings.hpp"
+
+enum TaskStatus
+{
+    TASK_RUNNING = 0,
+    TASK_DONE = 1,
+    TASK_FAILED = 2
+};
+
+// Stackless resumable task. resume() runs from where it last waited up to its next wait and returns TASK_RUNNING,
+// so a whole mission runs on the ROS callback thread without blocking it. Locals don't survive a wait, anything
+// needed afterwards has to be a member. Written between TASK_BEGIN() and TASK_END() with the TASK_ macros:
+//
+//     TaskStatus resume()
+//     {
+//         TASK_BEGIN();
+//         _drive.reset(new DriveTo(_context, TilePosition(3, 5)));
+//         TASK_AWAIT_TASK(*_drive);
+//         TASK_END();
+//     }
+class MissionTask
+{
+    public:
+        virtual ~MissionTask() {}
+        virtual TaskStatus resume() = 0;
+        // Called instead of resuming again when a parallel task no longer needs this one
+        virtual void cancel() {}
+
+    protected:
+        // Resumes the child once, true when it has finished and left its result in _child_status
+        bool finished(MissionTask& child);
+
+        int _resume_line = 0;
+        TaskStatus _child_status = TASK_RUNNING;
+};
+
+#define TASK_BEGIN() switch (_resume_line) { case 0:
+#define TASK_AWAIT(condition) do { _resume_line = __LINE__; case __LINE__: if (!(condition)) return TASK_RUNNING; } while (0)
+#define TASK_AWAIT_TASK(child) TASK_AWAIT(finished(child))
+#define TASK_FAIL() do { _resume_line = 0; return TASK_FAILED; } while (0)
+#define TASK_END() } _resume_line = 0; return TASK_DONE
+
+// What the primitives drive and watch
+struct MissionContext
+{
+    MissionContext(Planner& p, SensorReadings& s) : planner(p), sensors(s) {}
+    Planner& planner;
+    SensorReadings& sensors;
+};
+
+// Plans and drives to a tile, done once stopped on it. Fails if the planner gives up on the way, or if it takes
+// longer than the distance allows
+class DriveTo : public MissionTask
+{
+    public:
+        DriveTo(MissionContext& context, TilePosition tile, float speed = 0.3);
+        TaskStatus resume();
+        void cancel();
+
+    private:
+        MissionContext& _context;
+        TilePosition _tile;
+        float _speed;
+        ros::Time _deadline;
+};
+
+// Turns on the spot, done once the heading has settled and the motors are stopped. A turn that something else stops
+// short of the heading is started again, until the turn times out and fails
+class TurnTo : public MissionTask
+{
+    public:
+        TurnTo(MissionContext& context, int heading);
+        TaskStatus resume();
+        void cancel();
+
+    private:
+        MissionContext& _context;
+        int _heading;
+        ros::Time _deadline;
+        ros::Time _settled;
+};
+
+class Delay : public MissionTask
+{
+    public:
+        explicit Delay(double seconds);
+        TaskStatus resume();
+
+    private:
+        double _seconds;
+        ros::Time _end;
+};
+
+// Done as soon as the condition holds, e.g. a flame or the hall sensor
+class SensorEvent : public MissionTask
+{
+    public:
+        explicit SensorEvent(std::function<bool()> condition);
+        TaskStatus resume();
+
+    private:
+        std::function<bool()> _condition;
+};
+
+// Runs its tasks side by side. WAIT_ANY finishes with the first one and cancels the rest, e.g. drive while watching for
+// fire. WAIT_ALL finishes when they all have, failing if any of them did
+class Parallel : public MissionTask
+{
+    public:
+        enum Mode
+        {
+            WAIT_ANY = 0,
+            WAIT_ALL = 1
+        };
+
+        explicit Parallel(Mode mode);
+        // Takes ownership of the task
+        Parallel& add(MissionTask* task);
+        // Shorthand for a WAIT_ANY of the two
+        static Parallel* any(MissionTask* first, MissionTask* second);
+        TaskStatus resume();
+        void cancel();
+        // Index of the task that finished a WAIT_ANY, -1 before then
+        int winner() const;
+
+    private:
+        Mode _mode;
+        std::vector<std::unique_ptr<MissionTask>> _tasks;
+        std::vector<bool> _running;
+        int _winner = -1;
+};
+
+// Owns the running mission and resumes it on the ROS callback queue after every event signal, and on a slow timer for
+// delays. Resumes are queued rather than run inside the callback that signalled, so a task never runs halfway through
+// another callback's work
+class MissionEngine
+{
+    public:
+        void start(MissionTask* mission, EventSignal& events);
+        // Queues a resume, from any thread. Signals that come in before it runs share it
+        void schedule();
+        void poll();
+        bool isRunning() const;
+
+    private:
+        void timerCallback(const ros::TimerEvent& event);
+
+        std::unique_ptr<MissionTask> _mission;
+        ros::Timer _timer;
+        std::atomic<bool> _scheduled{false};
+};
+
+#endif //BILL_PLANNING_MISSION_ENGINE_HPP
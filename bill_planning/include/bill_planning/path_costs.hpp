@@ -0,0 +1,13 @@
+#ifndef BILL_PLANNING_PATH_COSTS_HPP
+#define BILL_PLANNING_PATH_COSTS_HPP
+
+// Rough seconds for each manoeuvre. A turn includes stopping, turning and settling before the next drive
+struct PathCosts
+{
+    PathCosts() : straight(1.5), turn(2.5), reverse(3.5) {}
+    float straight;  // One tile forward
+    float turn;      // 90 degrees
+    float reverse;   // 180 degrees
+};
+
+#endif //BILL_PLANNING_PATH_COSTS_HPP
@@ -0,0 +1,63 @@
+#ifndef BILL_PLANNING_PATH_TABLE_HPP
+#define BILL_PLANNING_PATH_TABLE_HPP
+
+#include <stdint.h>
+#include <vector>
+#include "bill_planning/path_costs.hpp"
+#include "bill_drivers/arena_map.hpp"
+
+// All pairs table of the next leg, over the same (tile, heading) states and costs as GraphPath's A*.
+// Each goal has a row holding, for every start state, the cost to the goal and the tile at the end of the first
+// straight run. Rows are built with one backwards Dijkstra from the goal. Closing an edge only marks the rows whose
+// paths drive across it, opening one marks every row, and marked rows are rebuilt the next time they are looked up
+class PathTable
+{
+    public:
+        PathTable();
+        // Takes a copy of the course, every row has to be rebuilt
+        void setMap(const ArenaMap& map);
+        void setCosts(const PathCosts& costs);
+        void setEdge(int tile, int heading, bool open);
+        // Rebuilds every row that is out of date, so the lookups after it don't search
+        void build();
+
+        // Tile at the end of the first leg from start to goal, goalTile if already there and -1 if the goal can't
+        // be reached. With an unknown heading (-1) the cheapest one is assumed
+        int nextLeg(int startTile, int startHeading, int goalTile);
+        float cost(int startTile, int startHeading, int goalTile);
+        // Heading the robot arrives at the goal in, -1 if it can't be reached. Follows the legs, so not constant time
+        int arrivalHeading(int startTile, int startHeading, int goalTile);
+        int rowsBuilt() const;  // Rows built since the map was set, for checking how much a change cost
+
+    private:
+        struct OpenEntry
+        {
+            float cost;
+            int state;
+            bool operator>(const OpenEntry& other) const { return cost > other.cost; }
+        };
+
+        static const uint16_t NO_LEG = 0xFFFF;  // Also limits the arena to 65535 tiles
+
+        void buildRow(int goalTile);
+        int bestState(int startTile, int startHeading, int goalTile);
+        bool drivesForward(int goalTile, int state) const;
+
+        ArenaMap _map;
+        PathCosts _costs;
+        int _states;
+        int _rows_built;
+
+        // Indexed by goal tile * _states + state
+        std::vector<float> _cost;
+        std::vector<uint16_t> _leg_end;
+        std::vector<bool> _stale;
+
+        // Row build scratch space
+        std::vector<int> _order;
+        std::vector<bool> _closed;
+        std::vector<bool> _forward;
+        std::vector<OpenEntry> _open;
+};
+
+#endif //BILL_PLANNING_PATH_TABLE_HPP
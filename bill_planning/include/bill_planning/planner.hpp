@@ -10,25 +10,46 @@
 #include "bill_planning/position.hpp"
 #include "bill_planning/sensor_readings.hpp"
 #include "bill_planning/graph_path.hpp"
+#include "bill_planning/event_signal.hpp"
 #include <list>
+#include <atomic>
+#include <functional>
 
 class Planner
 {
   public:
     Planner();
     void setPubs(ros::Publisher mp, ros::Publisher fp, ros::Publisher lp);
+    // Trace id of the latest position, copied into the motor commands decided on it
+    void setTraceId(uint64_t id);
+    // Replaces the course, dropping any obstacles found so far
+    void setMap(const ArenaMap& map);
+    void setPathSearch(PathSearch search, const PathCosts& costs);
+    // Called whenever a turn or drive starts or is cancelled, so anything pending for the old one can be dropped
+    void setActionListener(std::function<void()> listener);
     void publishStop();
     void publishDrive(int heading, float speed);
     void publishTurn(int heading);
+    // Both return straight away, timers switch the fan and LED off again so callbacks aren't held up
     void putOutFire();
     void signalComplete();
+    bool isFanOn();
+    bool isSignalling();
 
     void publishDriveToTile(SensorReadings &sensorReadings, int x, int y, float speed, bool scanOnReach = false);
+    // Reorders the stops to visit them in the least time, for mission code that has work to do at each one
+    float orderTour(SensorReadings &sensorReadings, std::vector<TilePosition>& stops);
     void cancelDriveToTile(SensorReadings &sensorReadings);
 
     void driveAroundObstacle(SensorReadings &sensorReadings);
+    // Reopens the edges closed around an obstacle tile once it has moved
+    void clearObstacle(int x, int y);
+    // Tiles from x, y to every tile in map index order around the obstacles found so far, -1 where unreachable
+    int distancesFrom(int x, int y, std::vector<int>& dist);
 
-    bool is_moving = false;
+    std::atomic<bool> is_moving{false};
+    // Notified when moving or scanning changes, and by the sensor callbacks after every reading
+    EventSignal events;
 
     void setIsScanning(bool val);
     bool getIsScanning();
@@ -39,18 +60,33 @@ class Planner
 
   private:
     std::mutex _is_scanning_mutex;
+    // Timers can be started from any spinner thread, guards the handles and what the callbacks switch off
+    std::mutex _timer_mutex;
     bool _is_scanning = false;
 
     void scanTimerCallback(const ros::TimerEvent& event);
+    void fanTimerCallback(const ros::TimerEvent& event);
+    void ledTimerCallback(const ros::TimerEvent& event);
+    // Starts or restarts a one shot timer, the handle has to outlive it
+    void startTimer(ros::Timer& timer, double seconds, void (Planner::*callback)(const ros::TimerEvent&));
+    void actionStarted();
+    void setObstacleEdges(int obstacleIndex, bool blocked);
     bill_msgs::MotorCommands _command_msg;
     ros::Publisher _motor_pub;
     ros::Publisher _fan_pub;
     ros::Publisher _led_pub;
+    ros::Timer _scan_timer;
+    ros::Timer _fan_timer;
+    ros::Timer _led_timer;
+    std::atomic<bool> _fan_on{false};
+    std::atomic<bool> _led_on{false};
     std::list<TilePosition> drivePoints;
+    std::function<void()> _action_listener;
 
     GraphPath graphPath;
 
     float driveSpeed = 0;
+    std::atomic<uint64_t> _trace_id{0};
 };
 
 #endif
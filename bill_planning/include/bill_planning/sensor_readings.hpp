@@ -11,6 +11,7 @@
 #include <utility>  
 #include <vector>
 #include "ros/ros.h"
+#include "bill_drivers/seqlock.hpp"
 
 enum STATE
 {
@@ -23,6 +24,22 @@ enum STATE
     INTERMEDIATE_STAGE = 6
 };
 
+// Everything the sensors tell us, updated together so a reader never mixes fields from different messages
+struct WorldState
+{
+    int heading = 90;          // Degrees
+    float x = 0;               // cm
+    float y = 0;               // cm
+    int tile_x = -1;
+    int tile_y = -1;
+    float ultra_fwd = -500;    // cm
+    float ultra_left = -500;   // cm
+    float ultra_right = -500;  // cm
+    bool fire_fwd = false;
+    bool fire_left = false;
+    bool fire_right = false;
+};
+
 class SensorReadings
 {
     public:
@@ -54,12 +71,21 @@ class SensorReadings
         void setCurrentTileY(int val);
         int getCurrentTileX();
         int getCurrentTileY();
+        void setCurrentTile(int x, int y);
+        TilePosition getCurrentTile();
+
+        // Writes a position message in one go
+        void setPose(int heading, float x, float y, int tile_x, int tile_y);
+        // A consistent copy of the sensor state, never blocks
+        WorldState getWorldState();
 
         void setCurrentPositionX(float val);
         void setCurrentPositionY(float val);
         float getCurrentPositionX();
         float getCurrentPositionY();
 
+        // Tiles along x and y, target tiles outside it are invalid
+        void setArenaSize(int width, int height);
         void setTargetPoint(int x, int y);
         int getTargetTileX();
         int getTargetTileY();
@@ -94,21 +120,19 @@ class SensorReadings
         unsigned char detection_bit;
 
     private:
+        // Setters update _world_next and store all of it, the getters read _world without locking
+        std::mutex _world_write_mutex;
+        WorldState _world_next;
+        SeqLock<WorldState> _world;
+
         std::mutex _target_tile_mutex;
-        std::mutex _current_tile_mutex;
-        std::mutex _current_position_mutex;
         std::mutex _flame_tile_mutex;
         std::mutex _home_tile_mutex;
         std::mutex _points_of_interest_mutex;
         std::mutex _start_robot_performance_thread_mutex;
         std::mutex _current_state_mutex;
-        std::mutex _ultra_fwd_mutex;
-        std::mutex _ultra_left_mutex;
-        std::mutex _ultra_right_mutex;
-        std::mutex _current_heading_mutex;
         std::mutex _target_heading_mutex;
         std::mutex _detection_bit_mutex;
-        std::mutex _detected_fire_mutex;
 
         // Stored y,x for future use
         std::vector<int> _y_Objects = {0,1,2,3,4,5};
@@ -118,22 +142,15 @@ class SensorReadings
 
 
         bool _start_robot_performance_thread = false;
-        bool _detected_fire_fwd = false;
-        bool _detected_fire_left = false;
-        bool _detected_fire_right = false;
-
-        float _ultra_fwd = -500;
-        float _ultra_left = -500;
-        float _ultra_right = -500;
-        int _current_heading = 90;
+
         int _target_heading = 90;
         unsigned char _detection_bit = 0x00;
 
-        Position _current_position = Position(0,0);
         TilePosition _home_tile = TilePosition(-1,-1);
         TilePosition _flame_tile = TilePosition(-1, -1);
-        TilePosition _current_tile = TilePosition(-1, -1);
         TilePosition _current_target_tile = TilePosition(-1, -1);
+        int _arena_width = 6;
+        int _arena_height = 6;
 };
 
 #endif
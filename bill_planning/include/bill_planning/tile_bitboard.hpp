@@ -0,0 +1,41 @@
+#ifndef BILL_PLANNING_TILE_BITBOARD_HPP
+#define BILL_PLANNING_TILE_BITBOARD_HPP
+
+#include <stdint.h>
+#include <vector>
+#include "bill_drivers/arena_map.hpp"
+
+// The arena as bitboards, one bit per tile in ArenaMap index order. Arenas up to 8x8 fit in one 64 bit word, larger
+// ones use an array of words. For each heading there is a mask of the tiles that can be driven out of that way, so a
+// breadth first search step is a shift, AND and OR of whole words instead of a queue of tiles
+class TileBitboard
+{
+    public:
+        TileBitboard();
+        void setMap(const ArenaMap& map);
+        void setOpen(int tile, int heading, bool open);
+
+        bool reachable(int src, int dest);
+        // Tiles from src to every tile, -1 where it can't be reached. Returns the number of reachable tiles
+        int distanceField(int src, std::vector<int>& dist);
+
+    private:
+        // One wavefront step from _frontier into _next
+        void expand();
+        // Drops tiles already visited from _next and adds the rest to _visited. False once nothing new was reached
+        bool mergeFrontier();
+        void shiftUp(const uint64_t* src, uint64_t* dst, int bits) const;
+        void shiftDown(const uint64_t* src, uint64_t* dst, int bits) const;
+
+        int _width;
+        int _tiles;
+        int _words;
+        std::vector<uint64_t> _open[ARENA_HEADINGS];  // Tiles with an open side towards each heading
+
+        std::vector<uint64_t> _frontier;
+        std::vector<uint64_t> _next;
+        std::vector<uint64_t> _shifted;
+        std::vector<uint64_t> _visited;
+};
+
+#endif //BILL_PLANNING_TILE_BITBOARD_HPP
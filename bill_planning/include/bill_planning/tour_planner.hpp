@@ -0,0 +1,36 @@
+#ifndef BILL_PLANNING_TOUR_PLANNER_HPP
+#define BILL_PLANNING_TOUR_PLANNER_HPP
+
+#include <vector>
+#include "bill_planning/path_table.hpp"
+
+// Orders the stops of a mission so driving to all of them takes the least time. Each hop is costed from the path
+// table, starting in the heading the previous hop arrived in, so the turns between stops count as well.
+// Up to EXACT_STOPS stops are solved exactly with Held-Karp dynamic programming, more start from the nearest stop
+// order and are improved with 2-opt and Or-opt moves until neither helps
+class TourPlanner
+{
+    public:
+        static const int EXACT_STOPS = 10;
+
+        // Reorders the stop tiles in place, dropping the ones that can't be reached. Returns the estimated seconds to
+        // drive the whole tour, ending at the last stop
+        float order(PathTable& table, int startTile, int startHeading, std::vector<int>& stops);
+
+    private:
+        // Node 0 is the start, node i + 1 is stop i
+        void fillCosts(PathTable& table, int startTile, int startHeading, const std::vector<int>& stops);
+        float hopCost(int from, int heading, int to) const;
+        int hopHeading(int from, int heading, int to) const;
+        float tourCost(const std::vector<int>& tour) const;
+        float exact(std::vector<int>& tour);
+        float improve(std::vector<int>& tour);
+
+        int _stops;
+        int _start_heading;
+        // Indexed by (from node * ARENA_HEADINGS + heading) * stops + to stop
+        std::vector<float> _cost;
+        std::vector<int> _arrival;
+};
+
+#endif //BILL_PLANNING_TOUR_PLANNER_HPP
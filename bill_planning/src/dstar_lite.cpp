@@ -0,0 +1,296 @@
+#include "bill_planning/dstar_lite.hpp"
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <stdlib.h>
+
+static const float INF = std::numeric_limits<float>::infinity();
+
+DStarLite::DStarLite()
+{
+    _start = -1;
+    _km = 0;
+    _expansions = 0;
+    setMap(ArenaMap());
+}
+
+void DStarLite::setMap(const ArenaMap& map)
+{
+    _map = map;
+    _states = _map.tiles() * ARENA_HEADINGS;
+    _g.resize(_states);
+    _rhs.resize(_states);
+    _queued.resize(_states);
+    _queued_key.resize(_states);
+    _queue.reserve(_states * 4);
+    _goal = -1;
+}
+
+void DStarLite::setCosts(const PathCosts& costs)
+{
+    _costs = costs;
+    _goal = -1;  // Every stored cost is stale, search from scratch next time
+}
+
+void DStarLite::reset(int goalTile)
+{
+    for (int i = 0; i < _states; i++)
+    {
+        _g[i] = INF;
+        _rhs[i] = INF;
+        _queued[i] = false;
+    }
+    _queue.clear();
+    _km = 0;
+    _start = -1;
+    _goal = goalTile;
+
+    // Arriving in any heading reaches the goal
+    for (int h = 0; h < ARENA_HEADINGS; h++)
+    {
+        int state = goalTile * ARENA_HEADINGS + h;
+        _rhs[state] = 0;
+        push(state, calculateKey(state));
+    }
+}
+
+// Straight tiles only, so it stays consistent however the turns are weighted
+float DStarLite::heuristic(int from, int to) const
+{
+    int fromTile = from / ARENA_HEADINGS;
+    int toTile = to / ARENA_HEADINGS;
+    int dx = abs(_map.tileX(fromTile) - _map.tileX(toTile));
+    int dy = abs(_map.tileY(fromTile) - _map.tileY(toTile));
+    return (dx + dy) * _costs.straight;
+}
+
+DStarLite::Key DStarLite::calculateKey(int state) const
+{
+    float best = std::min(_g[state], _rhs[state]);
+    Key key;
+    key.k1 = best + (_start >= 0 ? heuristic(_start, state) : 0) + _km;
+    key.k2 = best;
+    return key;
+}
+
+int DStarLite::forwardTile(int tile, int heading) const
+{
+    return _map.neighbour(tile, heading);
+}
+
+int DStarLite::successors(int state, int* next, float* cost) const
+{
+    int tile = state / ARENA_HEADINGS;
+    int heading = state % ARENA_HEADINGS;
+    int n = 0;
+
+    int forward = forwardTile(tile, heading);
+    if (forward >= 0)
+    {
+        next[n] = forward * ARENA_HEADINGS + heading;
+        cost[n++] = _costs.straight;
+    }
+    next[n] = tile * ARENA_HEADINGS + (heading + 1) % ARENA_HEADINGS;
+    cost[n++] = _costs.turn;
+    next[n] = tile * ARENA_HEADINGS + (heading + 3) % ARENA_HEADINGS;
+    cost[n++] = _costs.turn;
+    next[n] = tile * ARENA_HEADINGS + (heading + 2) % ARENA_HEADINGS;
+    cost[n++] = _costs.reverse;
+    return n;
+}
+
+// Turns are symmetric, only the forward move has to be looked up from the tile behind
+int DStarLite::predecessors(int state, int* prev, float* cost) const
+{
+    int tile = state / ARENA_HEADINGS;
+    int heading = state % ARENA_HEADINGS;
+    int n = 0;
+
+    int behind = forwardTile(tile, (heading + 2) % ARENA_HEADINGS);
+    if (behind >= 0 && forwardTile(behind, heading) == tile)
+    {
+        prev[n] = behind * ARENA_HEADINGS + heading;
+        cost[n++] = _costs.straight;
+    }
+    prev[n] = tile * ARENA_HEADINGS + (heading + 1) % ARENA_HEADINGS;
+    cost[n++] = _costs.turn;
+    prev[n] = tile * ARENA_HEADINGS + (heading + 3) % ARENA_HEADINGS;
+    cost[n++] = _costs.turn;
+    prev[n] = tile * ARENA_HEADINGS + (heading + 2) % ARENA_HEADINGS;
+    cost[n++] = _costs.reverse;
+    return n;
+}
+
+void DStarLite::updateState(int state)
+{
+    if (state / ARENA_HEADINGS != _goal)
+    {
+        int next[4];
+        float cost[4];
+        int n = successors(state, next, cost);
+        float best = INF;
+        for (int i = 0; i < n; i++)
+        {
+            best = std::min(best, cost[i] + _g[next[i]]);
+        }
+        _rhs[state] = best;
+    }
+
+    if (_g[state] != _rhs[state])
+    {
+        push(state, calculateKey(state));
+    }
+    else
+    {
+        _queued[state] = false;
+    }
+}
+
+void DStarLite::push(int state, const Key& key)
+{
+    _queued[state] = true;
+    _queued_key[state] = key;
+    QueueEntry entry = {key, state};
+    _queue.push_back(entry);
+    std::push_heap(_queue.begin(), _queue.end(), std::greater<QueueEntry>());
+}
+
+// Drops stale entries and returns the lowest live one without removing it
+bool DStarLite::top(QueueEntry& entry)
+{
+    while (!_queue.empty())
+    {
+        const QueueEntry& front = _queue.front();
+        if (_queued[front.state] && _queued_key[front.state] == front.key)
+        {
+            entry = front;
+            return true;
+        }
+        std::pop_heap(_queue.begin(), _queue.end(), std::greater<QueueEntry>());
+        _queue.pop_back();
+    }
+    return false;
+}
+
+void DStarLite::computeShortestPath()
+{
+    QueueEntry entry;
+    while (top(entry) && (entry.key < calculateKey(_start) || _rhs[_start] != _g[_start]))
+    {
+        std::pop_heap(_queue.begin(), _queue.end(), std::greater<QueueEntry>());
+        _queue.pop_back();
+        int u = entry.state;
+        _queued[u] = false;
+        _expansions++;
+
+        Key newKey = calculateKey(u);
+        if (entry.key < newKey)
+        {
+            // Queued before the robot moved, its key only needs raising
+            push(u, newKey);
+            continue;
+        }
+
+        int prev[4];
+        float cost[4];
+        int n = predecessors(u, prev, cost);
+        if (_g[u] > _rhs[u])
+        {
+            _g[u] = _rhs[u];
+        }
+        else
+        {
+            _g[u] = INF;
+            updateState(u);
+        }
+        for (int i = 0; i < n; i++)
+        {
+            updateState(prev[i]);
+        }
+    }
+}
+
+void DStarLite::setEdge(int tile, int heading, bool open)
+{
+    int other = _map.adjacent(tile, heading);
+    if (other < 0 || _map.isOpen(tile, heading) == open)
+    {
+        return;
+    }
+    _map.setOpen(tile, heading, open);
+
+    // Only the states driving across the edge, one from each side, change their successors
+    if (_goal >= 0)
+    {
+        updateState(tile * ARENA_HEADINGS + heading);
+        updateState(other * ARENA_HEADINGS + (heading + 2) % ARENA_HEADINGS);
+    }
+}
+
+int DStarLite::plan(int startTile, int startHeading, int goalTile, int* path, int maxLength)
+{
+    _expansions = 0;
+    if (goalTile != _goal)
+    {
+        reset(goalTile);
+    }
+
+    int start = startTile * ARENA_HEADINGS + startHeading;
+    if (_start >= 0 && _start != start)
+    {
+        _km += heuristic(_start, start);
+    }
+    _start = start;
+    computeShortestPath();
+
+    if (_g[start] == INF)
+    {
+        return 0;
+    }
+
+    // Follow the cheapest successor down to the goal
+    int length = 0;
+    int state = start;
+    path[length++] = startTile;
+    for (int steps = 0; state / ARENA_HEADINGS != goalTile && steps < _states; steps++)
+    {
+        int next[4];
+        float cost[4];
+        int n = successors(state, next, cost);
+        int best = -1;
+        float bestCost = INF;
+        for (int i = 0; i < n; i++)
+        {
+            if (cost[i] + _g[next[i]] < bestCost)
+            {
+                bestCost = cost[i] + _g[next[i]];
+                best = next[i];
+            }
+        }
+        if (best < 0)
+        {
+            return 0;
+        }
+        state = best;
+        int tile = state / ARENA_HEADINGS;
+        if (tile != path[length - 1])
+        {
+            if (length == maxLength)
+            {
+                return 0;
+            }
+            path[length++] = tile;
+        }
+    }
+    return state / ARENA_HEADINGS == goalTile ? length : 0;
+}
+
+float DStarLite::pathCost() const
+{
+    return _start >= 0 ? _g[_start] : INF;
+}
+
+int DStarLite::expansions() const
+{
+    return _expansions;
+}
@@ -0,0 +1,19 @@
+#include "bill_planning/event_signal.hpp"
+
+void EventSignal::notify()
+{
+    // Taking the lock orders the change before a waiter's check, so a waiter can't miss it and sleep
+    {
+        std::lock_guard<std::mutex> guard(_mutex);
+    }
+    _changed.notify_all();
+    if (_listener)
+    {
+        _listener();
+    }
+}
+
+void EventSignal::setListener(std::function<void()> listener)
+{
+    _listener = listener;
+}
@@ -7,12 +7,15 @@
 #include <cstddef>
 #include <iostream>
 #include <utility>
-#include <thread>
-#include <chrono>
+#include <atomic>
+#include <mutex>
 #include <bill_planning/planner.hpp>
 #include <cmath>
 #include <vector>
 #include "bill_msgs/Survivor.h"
+#include "bill_drivers/trace.hpp"
+#include "bill_drivers/arena_map.hpp"
+#include "bill_planning/mission_engine.hpp"
 
 // CALLBACKS
 void positionCallback(const bill_msgs::Position::ConstPtr& msg);
@@ -24,25 +27,17 @@ void fireCallbackLeft(const std_msgs::Bool::ConstPtr& msg);
 void fireCallbackRight(const std_msgs::Bool::ConstPtr& msg);
 void hallCallback(const std_msgs::Bool::ConstPtr& msg);
 void survivorsCallback(const bill_msgs::Survivor::ConstPtr& msg);
+void settleTimerCallback(const ros::TimerEvent& event);
+void cancelSettle();
 
 // HELPER FUNCTIONS
-void fireOut();
-void robotPerformanceThread(int n);
 TilePosition tileFromPoint(int x_pos, int y_pos);
-void waitToHitTile();
-void driveForwardXTiles(int numTiles);
-void waitToHitTileWithBuildingSearch(bool firstLeg);
-void driveToBuilding(bool isRight);
-void driveHome();
-void findAndExtinguishFire();
-void waitForPlannerScan();
-void runBuildingSearch();
-void startSearch();
-void completeSearch();
+TilePosition fireScanTile();
+TilePosition buildingTile(bool isRight);
 void emplacePoint(TilePosition tile_position);
-void preBuildingSearchSetup();
-void findMagnet();
-bool shouldKeepTurning();
+bool isPoorStartHeading();
+bool isAtHeading(int heading);
+bool isClearAhead();
 
 SensorReadings sensor_readings;
 
@@ -51,42 +46,67 @@ int buildings_found = 0;
 
 unsigned char start_course = 0x00;
 Planner planner;
+ArenaMap arena;
+MissionContext mission_context(planner, sensor_readings);
+MissionEngine mission_engine;
 
 // FLAGS
-bool _building_left = false;
-bool _building_right = false;
+std::atomic<bool> _building_left{false};
+std::atomic<bool> _building_right{false};
 bool _cleared_fwd = false;
 bool _driven_fwd = false;
 bool _extinguished_fire = false;
 bool _found_hall = false;
-bool KILL_SWITCH = false;
 bool FIND_BUILDINGS = true;
 bool FIND_FIRE = true;
 bool FIND_MAGNET = true;
 
 bool _fan_on_reached_heading = false;
+// Set while we let a finished turn settle before driving, so position updates keep flowing meanwhile
+std::atomic<bool> _settling{false};
+// Heading the pending settle was armed for. Armed by the position callback, cancelled by any action that starts
+std::atomic<int> _settle_heading{-1};
+std::mutex settle_mutex;
+ros::Timer settle_timer;
 
 float previous_ultra_left = 0;
 float previous_ultra_right = 0;
 
-// POSITION
-TilePosition desired_tile(0,0);
-
-int desired_heading = 90;
 int start_heading = 90;
 
 // CONSTANTS
 const float FULL_COURSE_DETECTION_LENGTH = 155.0;
-const float FULL_COURSE_SIDE_ULTRAS = 160.0;
 const int FIRE_SCAN_ANGLE = 25;
 const float DELTA = 7; //cm
-const float TILE_WIDTH = 0.3;
-const float TILE_HEIGHT = 0.3;
 const float POSITION_ACCURACY_BUFFER = 0.075;
 // There is a buffer in the robot response time so let's be a bit more generous here. In degrees
 const float HEADING_ACCURACY_BUFFER = 5.0;
 // There is a buffer in the robot response time so let's be a bit more generous here. In cm
 const float OBSTACLE_THRESHOLD = 3.0;
+const double TURN_SETTLE_TIME = 0.75; // Seconds
+const double FIRE_FACE_TIMEOUT = 3.0; // Seconds
+const double CLEAR_AHEAD_TIMEOUT = 0.5; // Seconds to watch the front ultrasonic for a clear run up the course
+const int BUILDINGS = 2;
+
+// The game day mission as resumable tasks, run by mission_engine on the ROS thread without a thread of its own or any
+// polling
+class GameDayMission : public MissionTask
+{
+    public:
+        explicit GameDayMission(MissionContext& context) : _context(context) {}
+        TaskStatus resume();
+
+    private:
+        MissionContext& _context;
+        std::unique_ptr<MissionTask> _step;
+        std::vector<TilePosition> _poi;
+        int _fire_heading = 0;
+        int _sweep = 0;
+        int _signals = 0;
+        int _search = 0;
+        TilePosition _search_from = TilePosition(-1, -1);
+        TilePosition _building = TilePosition(-1, -1);
+};
 
 int main(int argc, char** argv)
 {
@@ -98,6 +118,36 @@ int main(int argc, char** argv)
     ROS_INFO("Goals are Fire: %i Magnet: %i Buildings: %i", FIND_FIRE, FIND_MAGNET, FIND_BUILDINGS);  
     nh.getParam("/bill/starting_params/theta", start_heading);
 
+    if (!arena.load(nh))
+    {
+        arena = ArenaMap();
+        ROS_WARN("Falling back to the default %ix%i arena", arena.width(), arena.height());
+    }
+    planner.setMap(arena);
+    sensor_readings.setArenaSize(arena.width(), arena.height());
+
+    std::string path_search = "astar";
+    PathCosts path_costs;
+    nh.getParam("/planner/path_search", path_search);
+    nh.getParam("/planner/straight_cost", path_costs.straight);
+    nh.getParam("/planner/turn_cost", path_costs.turn);
+    nh.getParam("/planner/reverse_cost", path_costs.reverse);
+    PathSearch search = SEARCH_ASTAR;
+    if (path_search == "bfs")
+    {
+        search = SEARCH_BFS;
+    }
+    else if (path_search == "dstar")
+    {
+        search = SEARCH_DSTAR;
+    }
+    else if (path_search == "table")
+    {
+        search = SEARCH_TABLE;
+    }
+    planner.setPathSearch(search, path_costs);
+    ROS_INFO("Planning paths with %s", path_search.c_str());
+
     // Subscribing to Topics
     ros::Subscriber sub_odom = nh.subscribe("position", 1, positionCallback);
     ros::Subscriber sub_fire = nh.subscribe("fire", 3, fireCallbackFront);
@@ -109,105 +159,35 @@ int main(int argc, char** argv)
     ros::Subscriber sub_food = nh.subscribe("food", 1, hallCallback);
     ros::Subscriber sub_survivors = nh.subscribe("survivors", 1, survivorsCallback);
 
+    std::string trace_dir;
+    if (nh.getParam("/trace_dir", trace_dir) && !traceOpen(trace_dir, ros::this_node::getName()))
+    {
+        ROS_WARN("Could not open a trace file in %s", trace_dir.c_str());
+    }
+
     ros::Publisher motor_pub = nh.advertise<bill_msgs::MotorCommands>("motor_cmd", 100, true);
     ros::Publisher fan_pub = nh.advertise<std_msgs::Bool>("fan", 100);
     ros::Publisher led_pub = nh.advertise<std_msgs::Bool>("led", 100);
 
     planner.setPubs(motor_pub, fan_pub, led_pub);
+    planner.setActionListener(cancelSettle);
 
     sensor_readings.setCurrentState(STATE::FINDING_T_SEARCH_TILE);
-    std::thread robot_execution_thread(robotPerformanceThread, 1);
+    mission_engine.start(new GameDayMission(mission_context), planner.events);
     ros::spin();
-    KILL_SWITCH = true;
-    robot_execution_thread.join();
+    traceDump();
     return 0;
 }
 
-void robotPerformanceThread(int n)
-{
-    ROS_INFO("RUNNING SEPARATE THREAD: %i", n);
-    // WAIT ON DATA FROM EACH ULTRASONIC SENSOR
-    while (!sensor_readings.getStartRobotPerformanceThread() && !KILL_SWITCH)
-    {
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    }
-
-    std::this_thread::sleep_for(std::chrono::milliseconds(3000));
-
-    ROS_INFO("Current tile: (%i,%i)", sensor_readings.getCurrentTileX(), sensor_readings.getCurrentTileY());
-//    sensor_readings.setCurrentHeading(start_heading);
-
-    if ((sensor_readings.getCurrentTileX() == 0 && sensor_readings.getCurrentTileY() ==  2 && (std::abs(sensor_readings.getCurrentHeading() - 360) > HEADING_ACCURACY_BUFFER || std::abs(sensor_readings.getCurrentHeading()) > HEADING_ACCURACY_BUFFER))
-        || (sensor_readings.getCurrentTileX() == 5 && sensor_readings.getCurrentTileY() ==  3 && std::abs(sensor_readings.getCurrentHeading() - 180) > HEADING_ACCURACY_BUFFER)
-        || (sensor_readings.getCurrentTileX() == 3 && sensor_readings.getCurrentTileY() ==  0 && std::abs(sensor_readings.getCurrentHeading() - 90) > HEADING_ACCURACY_BUFFER)
-        || (sensor_readings.getCurrentTileX() == 2 && sensor_readings.getCurrentTileY() ==  5 && std::abs(sensor_readings.getCurrentHeading() - 270) > HEADING_ACCURACY_BUFFER))
-    {
-        ROS_WARN("POOR INITIAL HEADING RESTART LAUNCH FILE OR FAIL MISERABLY");
-    }
-    sensor_readings.setHomeTile(sensor_readings.getCurrentTileX(),sensor_readings.getCurrentTileY());
-
-    if (FIND_FIRE)
-    {
-    ROS_INFO("Running Flame Search");
-    sensor_readings.setCurrentState(STATE::FLAME_SEARCH);
-    findAndExtinguishFire();
-
-    // Wait until fire has been put out before moving on
-    while (!sensor_readings.getDetectedFireFwd() && !KILL_SWITCH)
-    {
-        if (sensor_readings.getDetectedFireLeft() && !planner.is_moving)
-        {
-            ROS_INFO("detected fire left, turning to heading %i", (sensor_readings.getCurrentHeading()+90)%360);
-            desired_heading = (sensor_readings.getCurrentHeading() + 90) % 360;
-            planner.publishTurn(desired_heading);
-        }
-        else if (sensor_readings.getDetectedFireRight() && !planner.is_moving)
-        {
-            ROS_INFO("Detected fire right, turning to heading %i",(sensor_readings.getCurrentHeading() - 90 + 360) % 360 );
-            desired_heading = (sensor_readings.getCurrentHeading() - 90 + 360) % 360;
-            planner.publishTurn(desired_heading);
-        }
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    }
-
-    fireOut();
-
-    planner.signalComplete();
-    }
-    if (FIND_MAGNET)
-    {
-    ROS_INFO("Finding Magnet");
-    sensor_readings.setCurrentState(STATE::HALL_SEARCH);
-    findMagnet();
-    }
-    if (FIND_BUILDINGS)
-    {
-    ROS_INFO("Running Building Search Setup");
-    preBuildingSearchSetup();
-    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-    ROS_INFO("Starting Building Search");
-    sensor_readings.setCurrentState(STATE::INTERMEDIATE_STAGE);
-    runBuildingSearch();
-    }
-    // Returning Home
-    ROS_INFO("driving home");
-    sensor_readings.setCurrentState(STATE::RETURN_HOME);
-    driveHome();
-    planner.signalComplete();
-    planner.signalComplete();
-}
-
 void positionCallback(const bill_msgs::Position::ConstPtr& msg)
 {
-    sensor_readings.setCurrentHeading(msg->heading);
-
-    // Convert stored units to CM
-    sensor_readings.setCurrentPositionX(msg->x * 100.0);
-    sensor_readings.setCurrentPositionY(msg->y * 100.0);
+    TraceScope scope("planner_position", msg->trace_id);
+    traceReceive("position", msg->trace_id);
+    planner.setTraceId(msg->trace_id);
 
     // Convert units to tiles instead of meters
-    float currentXTileCoordinate = msg->x / TILE_WIDTH;
-    float currentYTileCoordinate = msg->y / TILE_HEIGHT;
+    float currentXTileCoordinate = msg->x / arena.tileSize();
+    float currentYTileCoordinate = msg->y / arena.tileSize();
 
     float currentWholeX;
     float currentWholeY;
@@ -215,23 +195,29 @@ void positionCallback(const bill_msgs::Position::ConstPtr& msg)
     float localTileXCoverage = std::modf(currentXTileCoordinate, &currentWholeX);
     float localTileYCoverage = std::modf(currentYTileCoordinate, &currentWholeY);
 
-    bool isOnXTile = fabs(0.5 - fabs(localTileXCoverage)) < (POSITION_ACCURACY_BUFFER / TILE_WIDTH);
-    bool isOnYTile = fabs(0.5 - fabs(localTileYCoverage)) < (POSITION_ACCURACY_BUFFER / TILE_WIDTH);
+    bool isOnXTile = fabs(0.5 - fabs(localTileXCoverage)) < (POSITION_ACCURACY_BUFFER / arena.tileSize());
+    bool isOnYTile = fabs(0.5 - fabs(localTileYCoverage)) < (POSITION_ACCURACY_BUFFER / arena.tileSize());
 
+    // Keep the last tile on an axis until we are near the middle of the next one
+    WorldState world = sensor_readings.getWorldState();
+    world.heading = msg->heading;
+    world.x = msg->x * 100.0;  // Convert stored units to CM
+    world.y = msg->y * 100.0;
     if (isOnXTile)
     {
-      sensor_readings.setCurrentTileX((int)currentWholeX);
+        world.tile_x = (int)currentWholeX;
     }
-
     if (isOnYTile)
     {
-        sensor_readings.setCurrentTileY((int)currentWholeY);
+        world.tile_y = (int)currentWholeY;
     }
+    sensor_readings.setPose(world.heading, world.x, world.y, world.tile_x, world.tile_y);
+    planner.events.notify();
 
     // If there is a valid target heading that means we are turning
     if (sensor_readings.getTargetHeading() >= 0)
     {
-    	int heading_error = sensor_readings.getTargetHeading() - sensor_readings.getCurrentHeading();
+    	int heading_error = sensor_readings.getTargetHeading() - world.heading;
 
     	// Keep heading error centered at 0 between -180 and 180
     	if (heading_error > 180)
@@ -242,42 +228,26 @@ void positionCallback(const bill_msgs::Position::ConstPtr& msg)
     	{
             heading_error += 360;
     	}
-        if (fabs(heading_error) < HEADING_ACCURACY_BUFFER)
+        if (fabs(heading_error) < HEADING_ACCURACY_BUFFER && !_settling)
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(750));
-            //ROS_INFO("Arrived at target heading %i, publishing drive", sensor_readings.getTargetHeading());
-            planner.publishStop();
-
-            // If there is somewhere to actually drive to, then start a drive
-            if (!planner.isDrivePointsEmpty())
-            {
-                planner.publishDrive(sensor_readings.getTargetHeading(), 0.2);
-            }
-
-            // If we are turning to yeet the fire, yeet that fire boi
-            if (_fan_on_reached_heading)
-            {
-                // Buzz and put out fire
-                planner.signalComplete();
-                planner.putOutFire();
-                _extinguished_fire = true;
-            }
-
-            // publish an invalid target heading
-            sensor_readings.setTargetHeading(-1);
+            std::lock_guard<std::mutex> lock(settle_mutex);
+            _settling = true;
+            _settle_heading = sensor_readings.getTargetHeading();
+            ros::NodeHandle nh;
+            settle_timer = nh.createTimer(ros::Duration(TURN_SETTLE_TIME), settleTimerCallback, true);
         }
     }
     // Other wise we must be driving
     else
     {
         // Check for obstacles
-        if (sensor_readings.getUltraFwd() < OBSTACLE_THRESHOLD && (sensor_readings.getDetectionBit() != 0))
+        if (world.ultra_fwd < OBSTACLE_THRESHOLD && (sensor_readings.getDetectionBit() != 0))
         {
             // Brake immediately
             planner.publishStop();
 
             // Should move into obstacle avoidance
-            if (sensor_readings.getUltraLeft() < OBSTACLE_THRESHOLD)
+            if (world.ultra_left < OBSTACLE_THRESHOLD)
             {
                 planner.driveAroundObstacle(sensor_readings);
 
@@ -290,37 +260,79 @@ void positionCallback(const bill_msgs::Position::ConstPtr& msg)
 	else if (sensor_readings.isTargetTileValid())
 	{
 	    bool shouldStop = false;
-            int current_heading = sensor_readings.getCurrentHeading();
+            int current_heading = world.heading;
+            float tile_cm = arena.tileSize() * 100.0;
 
             if (45 < current_heading && current_heading <= 135) // Facing positive y
             {
-                shouldStop = (sensor_readings.getCurrentPositionY() / 30.0) >= (sensor_readings.getTargetTileY() + 0.5);
+                shouldStop = (world.y / tile_cm) >= (sensor_readings.getTargetTileY() + 0.5);
             }
             else if (135 < current_heading && current_heading <= 225) // Facing negative x
             {
-                shouldStop = (sensor_readings.getCurrentPositionX() / 30.0) <= (sensor_readings.getTargetTileX() + 0.5);
+                shouldStop = (world.x / tile_cm) <= (sensor_readings.getTargetTileX() + 0.5);
             }
             else if (225 < current_heading && current_heading <= 315) // Facing negative y
             {
-                shouldStop = (sensor_readings.getCurrentPositionY() / 30.0) <= (sensor_readings.getTargetTileY() + 0.5);
+                shouldStop = (world.y / tile_cm) <= (sensor_readings.getTargetTileY() + 0.5);
             }
             else // Facing positive x
             {
-                shouldStop = (sensor_readings.getCurrentPositionX() / 30.0) >= (sensor_readings.getTargetTileX() + 0.5);
+                shouldStop = (world.x / tile_cm) >= (sensor_readings.getTargetTileX() + 0.5);
             }
 
             //ROS_INFO("Arrived at target point: %i, %i", sensor_readings.getTargetTileX(), sensor_readings.getTargetTileY());
             // We have arrived at our current target point
             if (shouldStop)
             {
-		sensor_readings.setCurrentTileY((int)currentWholeY);
-		sensor_readings.setCurrentTileX((int)currentWholeX);
+                sensor_readings.setCurrentTile((int)currentWholeX, (int)currentWholeY);
+                planner.events.notify();
                 planner.ProcessNextDrivePoint(sensor_readings);
             }
 	}
     }       
 }
 
+void settleTimerCallback(const ros::TimerEvent& event)
+{
+    // Anything that started since the timer was armed owns the motors now, stopping would cut its turn short
+    int target_heading = sensor_readings.getTargetHeading();
+    if (target_heading < 0 || target_heading != _settle_heading)
+    {
+        _settling = false;
+        return;
+    }
+
+    //ROS_INFO("Arrived at target heading %i, publishing drive", sensor_readings.getTargetHeading());
+    planner.publishStop();
+
+    // If there is somewhere to actually drive to, then start a drive
+    if (!planner.isDrivePointsEmpty())
+    {
+        planner.publishDrive(sensor_readings.getTargetHeading(), 0.2);
+    }
+
+    // If we are turning to yeet the fire, yeet that fire boi
+    if (_fan_on_reached_heading)
+    {
+        // Buzz and put out fire
+        planner.signalComplete();
+        planner.putOutFire();
+        _extinguished_fire = true;
+    }
+
+    // publish an invalid target heading
+    sensor_readings.setTargetHeading(-1);
+    _settling = false;
+    planner.events.notify();
+}
+
+void cancelSettle()
+{
+    std::lock_guard<std::mutex> lock(settle_mutex);
+    settle_timer.stop();
+    _settling = false;
+}
+
 void frontUltrasonicCallback(const std_msgs::Float32::ConstPtr& msg)
 {
     sensor_readings.setUltraFwd(msg->data);
@@ -332,6 +344,7 @@ void frontUltrasonicCallback(const std_msgs::Float32::ConstPtr& msg)
     {
         sensor_readings.setStartRobotPerformanceThread(true);
     }
+    planner.events.notify();
 }
 
 void leftUltrasonicCallback(const std_msgs::Float32::ConstPtr& msg)
@@ -351,6 +364,7 @@ void leftUltrasonicCallback(const std_msgs::Float32::ConstPtr& msg)
     {
         sensor_readings.setStartRobotPerformanceThread(true);
     }
+    planner.events.notify();
 }
 
 void rightUltrasonicCallback(const std_msgs::Float32::ConstPtr& msg)
@@ -373,6 +387,7 @@ void rightUltrasonicCallback(const std_msgs::Float32::ConstPtr& msg)
     {
         sensor_readings.setStartRobotPerformanceThread(true);
     }
+    planner.events.notify();
 }
 
 void emplacePoint(TilePosition tile_position)
@@ -395,6 +410,7 @@ void fireCallbackFront(const std_msgs::Bool::ConstPtr& msg)
     else
     {
     }
+    planner.events.notify();
 }
 
 void fireCallbackLeft(const std_msgs::Bool::ConstPtr& msg)
@@ -410,6 +426,7 @@ void fireCallbackLeft(const std_msgs::Bool::ConstPtr& msg)
         planner.publishStop();
         sensor_readings.setDetectedFireLeft(true);
     }
+    planner.events.notify();
 }
 
 void fireCallbackRight(const std_msgs::Bool::ConstPtr& msg)
@@ -425,6 +442,7 @@ void fireCallbackRight(const std_msgs::Bool::ConstPtr& msg)
         planner.publishStop();
         sensor_readings.setDetectedFireRight(true);
     }
+    planner.events.notify();
 }
 
 void hallCallback(const std_msgs::Bool::ConstPtr& msg)
@@ -438,6 +456,7 @@ void hallCallback(const std_msgs::Bool::ConstPtr& msg)
         _found_hall = true;
         planner.signalComplete();
     }
+    planner.events.notify();
 }
 
 void survivorsCallback(const bill_msgs::Survivor::ConstPtr& msg)
@@ -468,11 +487,12 @@ void survivorsCallback(const bill_msgs::Survivor::ConstPtr& msg)
     {
         sensor_readings.setDetectionBit(0);
     }
+    planner.events.notify();
 }
 
-bool shouldKeepTurning()
+bool isAtHeading(int heading)
 {
-    int heading_error = desired_heading - sensor_readings.getCurrentHeading();
+    int heading_error = heading - sensor_readings.getCurrentHeading();
 
     // Keep heading error centered at 0 between -180 and 180
     if (heading_error > 180)
@@ -483,125 +503,13 @@ bool shouldKeepTurning()
     {
         heading_error += 360;
     }
-
-    if (fabs(heading_error) < HEADING_ACCURACY_BUFFER)
-    {
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-        planner.publishStop();
-        return false;
-    }
-    else
-    {
-        return true;
-    }
-}
-
-void fireOut()
-{
-    bool initialCall = true;
-    bool check_temp_heading = true;
-    bool set_desired_heading = false;
-    int temp_desired_heading = 0;
-
-    do
-    {
-        if (initialCall || sensor_readings.getDetectedFireFwd())
-        {
-            planner.putOutFire();
-            sensor_readings.setDetectedFireFwd(false);
-
-            desired_heading = (sensor_readings.getCurrentHeading() + 2 * FIRE_SCAN_ANGLE + 360) % 360;
-            temp_desired_heading = (sensor_readings.getCurrentHeading() - FIRE_SCAN_ANGLE + 360) % 360;
-
-            planner.publishTurn(temp_desired_heading);
-
-            initialCall = false;
-            check_temp_heading = true;
-            set_desired_heading = false;
-        }
-
-        while(check_temp_heading
-              && !(fabs(temp_desired_heading - sensor_readings.getCurrentHeading()) < HEADING_ACCURACY_BUFFER)
-              && !KILL_SWITCH)
-        {
-            if(sensor_readings.getDetectedFireFwd())
-            {
-                planner.putOutFire();
-                sensor_readings.setDetectedFireFwd(false);
-
-                desired_heading = (sensor_readings.getCurrentHeading() + 2 * FIRE_SCAN_ANGLE + 360) % 360;
-                temp_desired_heading = (sensor_readings.getCurrentHeading() - FIRE_SCAN_ANGLE + 360) % 360;
-                planner.publishTurn(temp_desired_heading);
-            }
-            set_desired_heading = false;
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        }
-
-        check_temp_heading = false; 
-        if (!set_desired_heading)
-        {
-            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-            planner.publishTurn(desired_heading);
-            set_desired_heading = true;
-        }
-
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    } while(shouldKeepTurning() && !KILL_SWITCH);
-
-    sensor_readings.setCurrentState(STATE::BUILDING_SEARCH);
+    return fabs(heading_error) < HEADING_ACCURACY_BUFFER;
 }
 
-void driveHome()
+// Where to drive to see the whole course for a flame, (-1, -1) if we aren't in a home tile
+TilePosition fireScanTile()
 {
-    desired_tile.x = sensor_readings.getHomeTileX();
-    desired_tile.y = sensor_readings.getHomeTileY();
-
-    planner.publishDriveToTile(sensor_readings,
-        desired_tile.x,
-        desired_tile.y, 0.3);
-    waitToHitTile();
-}
-void waitToHitTileWithBuildingSearch(bool firstLeg)
-{
-    if (firstLeg)
-    {
-        while((planner.is_moving 
-            || desired_tile.x != sensor_readings.getCurrentTileX() ||
-            5 != sensor_readings.getCurrentTileY()) 
-            && !KILL_SWITCH)
-        {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-
-            if(_building_left || _building_right)
-            {
-                sensor_readings.setCurrentState(STATE::INTERMEDIATE_STAGE);
-                driveToBuilding(_building_right);
-
-                desired_tile.y = 5;
-                planner.publishDriveToTile(sensor_readings, desired_tile.x, desired_tile.y, 0.3);
-                sensor_readings.setCurrentState(STATE::BUILDING_SEARCH);
-
-                _building_left = false;
-                _building_right = false;
-            }
-            if (buildings_found == 2)
-            {
-                ROS_INFO("FOUND 2 BUILDINGS");
-                break;
-            }
-        }
-        
-    }
-    else
-    {
-        /* code */
-        ROS_INFO("THIS IS A SUPER RARE CASE AND WE WON'T CODE THIS RIGHT NOW, IF WE TEST EVERYTHING ELSE WE CAN CONTINUE");
-    }
-}
-
-void findAndExtinguishFire()
-{
-    TilePosition fireScanTargetTile;
+    TilePosition fireScanTargetTile(-1, -1);
 
     // Switch based on which home tile we started in
     int homeX = sensor_readings.getHomeTileX();
@@ -610,7 +518,7 @@ void findAndExtinguishFire()
     if (sensor_readings.getCurrentTileX() != homeX || sensor_readings.getCurrentTileY() != homeY)
     {
         ROS_WARN("Starting fire search while not in a home tile, this is invalid. bailing");
-        return;
+        return fireScanTargetTile;
     }
 
     if (homeX == 3 && homeY == 0)
@@ -644,82 +552,42 @@ void findAndExtinguishFire()
     else
     {
         ROS_WARN("We are starting fire search when our home tile is not one of the possible starting tiles, bailing");
-        return;
     }
+    return fireScanTargetTile;
+}
 
-    // Drive to our target
-    planner.publishDriveToTile(sensor_readings, fireScanTargetTile.x, fireScanTargetTile.y, 0.2);
+// Nothing in front of us up to the far wall, so the side ultrasonics see every building on the way up
+bool isClearAhead()
+{
+    float fwd = sensor_readings.getUltraFwd();
+    return fwd >= FULL_COURSE_DETECTION_LENGTH && fwd <= 200;
 }
 
-void driveToBuilding(bool isRight)
+// Tile of the building the side ultrasonic just saw, (-1, -1) if it is off the course or is the flame's tile
+TilePosition buildingTile(bool isRight)
 {
-    int pre_x = sensor_readings.getCurrentTileX();
-    int pre_y = sensor_readings.getCurrentTileY();
     float x_pos = isRight ?
         sensor_readings.getCurrentPositionX() + sensor_readings.getUltraRight() :
         sensor_readings.getCurrentPositionX() - sensor_readings.getUltraLeft();
 
     TilePosition b = tileFromPoint(x_pos, sensor_readings.getCurrentPositionY());
-
     if (b.x == sensor_readings.getFlameTileX() && b.y == sensor_readings.getFlameTileY())
     {
         // Don't mistake as a flame tile
-        return;
-    }
-
-    desired_tile.x = b.x;
-    desired_tile.y = b.y;
-
-    planner.publishDriveToTile(sensor_readings, desired_tile.x, desired_tile.y, 0.3);
-    waitToHitTile();
-
-    desired_tile.x = pre_x;
-    desired_tile.y = pre_y;
-    planner.publishDriveToTile(sensor_readings, desired_tile.x, desired_tile.y, 0.3);
-    waitToHitTile();
-
-    desired_tile.x = pre_x;
-    
-    buildings_found++;
-}
-
-void waitToHitTile()
-{
-    while((planner.is_moving
-        || desired_tile.x != sensor_readings.getCurrentTileX() ||
-        desired_tile.y != sensor_readings.getCurrentTileY()) 
-        && !KILL_SWITCH)
-    {
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    }
-    std::this_thread::sleep_for(std::chrono::milliseconds(750));
-}
-
-void waitForPlannerScan()
-{
-    int i = 0;
-    while(!planner.getIsScanning() && i < 200)
-    {
-        i++;
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    }
-
-    i = 0;
-    while(planner.getIsScanning() && i < 200)
-    {
-        i++;
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        return TilePosition(-1, -1);
     }
+    return b;
 }
 
 // THIS SHOULD BE PROVIDED IN CM AND TRUNCATED
 TilePosition tileFromPoint(int x_pos, int y_pos)
 {
     //Truncated value should be the tile position
-    int x = x_pos/30;
-    int y = y_pos/30;
+    int tile_cm = (int)(arena.tileSize() * 100.0);
+    int x = x_pos/tile_cm;
+    int y = y_pos/tile_cm;
 
-    if (x < 0 || x > 6 || y < 0 || y > 6)
+    if (x_pos < 0 || y_pos < 0 || !arena.contains(x, y))
     {
         ROS_INFO("TRIED TO CONVERT A TILE OUT OF RANGE");
         return TilePosition(-1,-1);
@@ -730,244 +598,199 @@ TilePosition tileFromPoint(int x_pos, int y_pos)
     }
 }
 
-void findMagnet()
+// True if we are on one of the arena's home tiles but not facing the way it has to be started in
+bool isPoorStartHeading()
 {
-    ROS_INFO("Starting magnet search");
-    TilePosition poi[3] = {TilePosition(1,1), TilePosition(4,4), TilePosition(2,3)};
-
-    for(int i = 0; i < 3; i++)
+    for (const HomeTile& home : arena.homeTiles())
     {
-        desired_tile.x = poi[i].x;
-        desired_tile.y = poi[i].y;
-
-        if (_found_hall)
+        WorldState world = sensor_readings.getWorldState();
+        if (world.tile_x != home.x || world.tile_y != home.y)
         {
-            break;
-        }
-
-        if (desired_tile.x != sensor_readings.getCurrentTileX() || desired_tile.y != sensor_readings.getCurrentTileY())
-        {
-            ROS_INFO("LOOKING FOR MAGNET, DRIVING TO x = %i, y = %i ", desired_tile.x, desired_tile.y);
-            planner.publishDriveToTile(sensor_readings, desired_tile.x, desired_tile.y, 0.3);
-            waitToHitTile();
-        }
-
-        if (_found_hall)
-        {
-            break;
+            continue;
         }
+        int difference = std::abs(world.heading - home.heading) % 360;
+        difference = std::min(difference, 360 - difference);
+        return difference > HEADING_ACCURACY_BUFFER;
     }
-
-    if (!_found_hall)
-    {
-        ROS_INFO("Signalling magnet found");
-        _found_hall = true;
-        planner.signalComplete();
-    }
+    return false;
 }
 
-void preBuildingSearchSetup()
+TaskStatus GameDayMission::resume()
 {
-    desired_tile.x = 3;
-    desired_tile.y = 0;
-
-    ROS_INFO("Driving to tile x = %i, y = %i", desired_tile.x, desired_tile.y);
-    planner.publishDriveToTile(sensor_readings, desired_tile.x, desired_tile.y, 0.3);
-    waitToHitTile();
-}
-
-void runBuildingSearch()
-{
-    int x = sensor_readings.getCurrentTileX();
-    int y = sensor_readings.getCurrentTileY();
-    ROS_INFO("Current Before Running initial search tile: (%i, %i)", x, y);
-    if (x == 3 && y == 0)
-    {
-        startSearch();
-        // for now we should just say screw it and return home?
-        return;
+    TASK_BEGIN();
+    // WAIT ON DATA FROM EACH ULTRASONIC SENSOR
+    TASK_AWAIT(sensor_readings.getStartRobotPerformanceThread());
+    _step.reset(new Delay(3.0));
+    TASK_AWAIT_TASK(*_step);
 
-        // this wont run
-        if(buildings_found < 2)
-        {
-            sensor_readings.setCurrentState(STATE::INTERMEDIATE_STAGE);
-            completeSearch();
-        }
-    }
-    else
+    ROS_INFO("Current tile: (%i,%i)", sensor_readings.getCurrentTileX(), sensor_readings.getCurrentTileY());
+    if (isPoorStartHeading())
     {
-        ROS_INFO("AREN'T IN A CORRECT TILE TO DO BUILDING SEARCH");
-        ROS_WARN("OUR CURRENT POSITION IS WRONG AND WE CAN'T START");
+        ROS_WARN("POOR INITIAL HEADING RESTART LAUNCH FILE OR FAIL MISERABLY");
     }
-}
+    sensor_readings.setHomeTile(sensor_readings.getCurrentTileX(), sensor_readings.getCurrentTileY());
 
-void startSearch()
-{
-    ROS_INFO("Starting building ");
-    TilePosition poi[3] = {TilePosition(3,0), TilePosition(4,0), TilePosition(0,0)};
-    for(int i = 0; i < 3; i++)
+    if (FIND_FIRE && fireScanTile().x >= 0)
     {
-        desired_tile.x = poi[i].x;
-        desired_tile.y = poi[i].y;
+        ROS_INFO("Running Flame Search");
+        sensor_readings.setCurrentState(STATE::FLAME_SEARCH);
 
-        if (desired_tile.x != sensor_readings.getCurrentTileX() || desired_tile.y != sensor_readings.getCurrentTileY())
+        // Drive out while watching for a flame, the flame callbacks stop the drive as soon as one is seen
+        _step.reset(Parallel::any(new SensorEvent([]
         {
-            ROS_INFO("Driving to tile x = %i, y = %i", desired_tile.x, desired_tile.y);
-            planner.publishDriveToTile(sensor_readings, desired_tile.x, desired_tile.y, 0.3);
-            waitToHitTile();
-        }
-        else
+            return sensor_readings.getDetectedFireFwd() || sensor_readings.getDetectedFireLeft()
+                || sensor_readings.getDetectedFireRight();
+        }), new DriveTo(_context, fireScanTile(), 0.2)));
+        TASK_AWAIT_TASK(*_step);
+
+        // Face a flame seen to the side
+        if (!sensor_readings.getDetectedFireFwd()
+            && (sensor_readings.getDetectedFireLeft() || sensor_readings.getDetectedFireRight()))
         {
-            ROS_INFO("Already in initial building search tile, x = %i, y = %i, checking ultra fwd next", desired_tile.x, desired_tile.y);
+            _fire_heading = sensor_readings.getDetectedFireLeft() ?
+                (sensor_readings.getCurrentHeading() + 90) % 360 :
+                (sensor_readings.getCurrentHeading() - 90 + 360) % 360;
+            ROS_INFO("Detected fire to the side, turning to heading %i", _fire_heading);
+            _step.reset(new TurnTo(_context, _fire_heading));
+            TASK_AWAIT_TASK(*_step);
+
+            _step.reset(Parallel::any(new SensorEvent([] { return sensor_readings.getDetectedFireFwd(); }),
+                new Delay(FIRE_FACE_TIMEOUT)));
+            TASK_AWAIT_TASK(*_step);
         }
 
-        desired_heading = 90;
-
-        if (desired_heading != sensor_readings.getCurrentHeading())
+        // Blow, then sweep either side and blow again wherever the flame is still seen
+        _fire_heading = sensor_readings.getCurrentHeading();
+        for (_sweep = 0; _sweep < 3; _sweep++)
         {
-            planner.publishTurn(desired_heading);
-
-            while (shouldKeepTurning() && !KILL_SWITCH)
+            if (_sweep == 0 || sensor_readings.getDetectedFireFwd())
             {
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                planner.putOutFire();
+                sensor_readings.setDetectedFireFwd(false);
+                TASK_AWAIT(!planner.isFanOn());
+            }
+            if (_sweep < 2)
+            {
+                _step.reset(new TurnTo(_context,
+                    (_fire_heading + (_sweep == 0 ? -FIRE_SCAN_ANGLE : FIRE_SCAN_ANGLE) + 360) % 360));
+                TASK_AWAIT_TASK(*_step);
             }
         }
+        _extinguished_fire = true;
+        sensor_readings.setCurrentState(STATE::BUILDING_SEARCH);
 
-        float uf = sensor_readings.getUltraFwd();
-        ROS_INFO("Ultra fwd is %f", uf);
+        planner.signalComplete();
+        TASK_AWAIT(!planner.isSignalling());
+    }
 
-        int counter = 0;
-        bool set_flag = false;
-        while (counter < 25)
+    if (FIND_MAGNET)
+    {
+        ROS_INFO("Finding Magnet");
+        sensor_readings.setCurrentState(STATE::HALL_SEARCH);
+        _poi = {TilePosition(1,1), TilePosition(4,4), TilePosition(2,3)};
+        while (!_found_hall && !_poi.empty())
         {
-            counter++;
-
-            if(uf >= FULL_COURSE_DETECTION_LENGTH && uf <= 200)
+            // Ordered again from where we are each time, dropping the ones walled off by obstacles found so far
+            planner.orderTour(sensor_readings, _poi);
+            if (_poi.empty())
             {
-                ROS_INFO("Found a clear path fwd value =  %f", uf);
-                set_flag = true;
+                ROS_WARN("No magnet search tile left that can be reached");
                 break;
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(20));
-            uf = sensor_readings.getUltraFwd();
+            ROS_INFO("LOOKING FOR MAGNET, DRIVING TO x = %i, y = %i ", _poi.front().x, _poi.front().y);
+            _step.reset(Parallel::any(new SensorEvent([] { return _found_hall; }),
+                new DriveTo(_context, _poi.front())));
+            _poi.erase(_poi.begin());
+            TASK_AWAIT_TASK(*_step);
         }
 
-        if (set_flag)
+        if (!_found_hall)
         {
-            break;
+            ROS_INFO("Signalling magnet found");
+            _found_hall = true;
+            planner.signalComplete();
+            TASK_AWAIT(!planner.isSignalling());
         }
     }
 
-    ROS_INFO("Driving forward now");
-    ROS_INFO("Setting state to init search");
-    sensor_readings.setCurrentState(STATE::BUILDING_SEARCH);
-    
-    desired_tile.x = sensor_readings.getCurrentTileX();
-    desired_tile.y = 5;
-
-    sensor_readings.setCurrentState(STATE::BUILDING_SEARCH);
-
-    ROS_INFO("Driving to tile x = %i, y = %i", desired_tile.x, desired_tile.y);
-    planner.publishDriveToTile(sensor_readings, desired_tile.x, desired_tile.y, 0.3);
-    waitToHitTileWithBuildingSearch(true);
-    ROS_INFO("Finished straight line search");
-}
-
-void driveForwardXTiles(int numTiles)
-{
-    int curr_heading = sensor_readings.getCurrentHeading();
-
-    switch (curr_heading)
-    {
-        case 316 ... 359:
-        case 0 ... 45:
-            // right side
-            desired_tile.x = sensor_readings.getCurrentHeading() + numTiles;
-            desired_tile.y = sensor_readings.getCurrentHeading();
-            break;
-        case 46 ... 135:
-            // top side
-            desired_tile.x = sensor_readings.getCurrentHeading();
-            desired_tile.y = sensor_readings.getCurrentHeading() + numTiles;
-            break;
-        case 136 ... 225:
-            // left
-            desired_tile.x = sensor_readings.getCurrentHeading() - numTiles;
-            desired_tile.y = sensor_readings.getCurrentHeading();
-            break;
-        case 226 ... 315:
-            // bottom
-            desired_tile.x = sensor_readings.getCurrentHeading();
-            desired_tile.y = sensor_readings.getCurrentHeading() - numTiles;
-            break;
-        default:
-            desired_tile.x = sensor_readings.getCurrentHeading();
-            desired_tile.y = sensor_readings.getCurrentHeading();
-            ROS_WARN("Some weird crap just happened");
-            break;
-    }
-
-    planner.publishDriveToTile(sensor_readings, desired_tile.x, desired_tile.y, 0.2);
-    waitToHitTile();
-}
-
-void completeSearch()
-{
-    int x = sensor_readings.getCurrentTileX();
-    TilePosition poi[3] = {TilePosition(5,3), TilePosition(5,1), TilePosition(5,5)};
-    for(int i = 0; i < 3; i++)
+    if (FIND_BUILDINGS)
     {
-        desired_tile.x = poi[i].x;
-        desired_tile.y = poi[i].y;
+        ROS_INFO("Running Building Search Setup");
+        _step.reset(new DriveTo(_context, TilePosition(3, 0)));
+        TASK_AWAIT_TASK(*_step);
+        _step.reset(new Delay(1.0));
+        TASK_AWAIT_TASK(*_step);
 
-        if (desired_tile.x == sensor_readings.getCurrentTileX() &&
-            desired_tile.y == sensor_readings.getCurrentTileY())
+        ROS_INFO("Starting Building Search");
+        sensor_readings.setCurrentState(STATE::INTERMEDIATE_STAGE);
+        if (sensor_readings.getCurrentTileX() != 3 || sensor_readings.getCurrentTileY() != 0)
         {
-            continue;
+            ROS_WARN("AREN'T IN A CORRECT TILE TO DO BUILDING SEARCH");
         }
+        else
+        {
+            // Face up the course from each start in turn until nothing is in the way to the far wall
+            _poi = {TilePosition(3,0), TilePosition(4,0), TilePosition(0,0)};
+            for (_search = 0; _search < (int)_poi.size(); _search++)
+            {
+                _step.reset(new DriveTo(_context, _poi[_search]));
+                TASK_AWAIT_TASK(*_step);
+                if (!isAtHeading(90))
+                {
+                    _step.reset(new TurnTo(_context, 90));
+                    TASK_AWAIT_TASK(*_step);
+                }
+                _step.reset(Parallel::any(new SensorEvent(isClearAhead), new Delay(CLEAR_AHEAD_TIMEOUT)));
+                TASK_AWAIT_TASK(*_step);
+                if (isClearAhead())
+                {
+                    ROS_INFO("Found a clear path fwd value =  %f", sensor_readings.getUltraFwd());
+                    break;
+                }
+            }
 
-        planner.publishDriveToTile(sensor_readings, desired_tile.x, desired_tile.y, 0.3);
-        waitToHitTile();
+            // Drive up the course. The side ultrasonic callbacks stop us at each building, which we drive to and
+            // back from before carrying on
+            sensor_readings.setCurrentState(STATE::BUILDING_SEARCH);
+            _search_from = sensor_readings.getCurrentTile();
+            while (buildings_found < BUILDINGS)
+            {
+                _step.reset(Parallel::any(new SensorEvent([] { return _building_left || _building_right; }),
+                    new DriveTo(_context, TilePosition(_search_from.x, 5))));
+                TASK_AWAIT_TASK(*_step);
+                if (!_building_left && !_building_right)
+                {
+                    break;
+                }
 
-        if(sensor_readings.getUltraRight() + sensor_readings.getUltraLeft() >= FULL_COURSE_SIDE_ULTRAS)
-        {
-            break;
+                sensor_readings.setCurrentState(STATE::INTERMEDIATE_STAGE);
+                _search_from = sensor_readings.getCurrentTile();
+                _building = buildingTile(_building_right);
+                if (_building.x >= 0)
+                {
+                    _step.reset(new DriveTo(_context, _building));
+                    TASK_AWAIT_TASK(*_step);
+                    _step.reset(new DriveTo(_context, _search_from));
+                    TASK_AWAIT_TASK(*_step);
+                    buildings_found++;
+                }
+                _building_left = false;
+                _building_right = false;
+                sensor_readings.setCurrentState(STATE::BUILDING_SEARCH);
+            }
+            ROS_INFO("Finished straight line search, found %i buildings", buildings_found);
         }
     }
 
-    if ((std::abs(sensor_readings.getCurrentHeading() - 90) < HEADING_ACCURACY_BUFFER
-        && sensor_readings.getUltraRight() >= sensor_readings.getUltraLeft())
-        || (std::abs(sensor_readings.getCurrentHeading() - 270) < HEADING_ACCURACY_BUFFER
-        && sensor_readings.getUltraRight() <= sensor_readings.getUltraLeft()))
-    {
-        desired_tile.x = 5;
-        desired_tile.y = sensor_readings.getCurrentTileY();
-        planner.publishDriveToTile(sensor_readings, desired_tile.x, desired_tile.y, 0.3);
-        waitToHitTile();
-        
-
-        sensor_readings.setCurrentState(STATE::INIT_SEARCH);
-        desired_tile.x = 0;
-        planner.publishDriveToTile(sensor_readings, desired_tile.x, desired_tile.y, 0.3);
-        waitToHitTileWithBuildingSearch(false);
-    }
-    else if ((std::abs(sensor_readings.getCurrentHeading() - 90) < HEADING_ACCURACY_BUFFER
-        && sensor_readings.getUltraRight() <= sensor_readings.getUltraLeft())
-        || (std::abs(sensor_readings.getCurrentHeading() - 270) < HEADING_ACCURACY_BUFFER
-        && sensor_readings.getUltraRight() >= sensor_readings.getUltraLeft()))
-    {
-        desired_tile.x = 0;
-        desired_tile.y = sensor_readings.getCurrentTileY();
-        planner.publishDriveToTile(sensor_readings, desired_tile.x, desired_tile.y, 0.3);
-        waitToHitTile();
+    ROS_INFO("driving home");
+    sensor_readings.setCurrentState(STATE::RETURN_HOME);
+    _step.reset(new DriveTo(_context, TilePosition(sensor_readings.getHomeTileX(), sensor_readings.getHomeTileY())));
+    TASK_AWAIT_TASK(*_step);
 
-        sensor_readings.setCurrentState(STATE::INIT_SEARCH);
-        desired_tile.x = 5;
-        planner.publishDriveToTile(sensor_readings, desired_tile.x, desired_tile.y, 0.3);
-        waitToHitTileWithBuildingSearch(false);
-    }
-    else
+    for (_signals = 0; _signals < 2; _signals++)
     {
-        ROS_WARN("SOMETHING WENT SUPER WRONG COMPLETING T SEARCH");
+        planner.signalComplete();
+        TASK_AWAIT(!planner.isSignalling());
     }
+    TASK_END();
 }
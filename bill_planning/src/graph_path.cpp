@@ -2,126 +2,139 @@
 // NOTE THIS CODE WAS TAKEN FROM
 // https://www.geeksforgeeks.org/shortest-path-unweighted-graph/
 
-// FATHER FORGIVE ME FOR I HAVE SINNED IN THE FOLLOWING FUNCTIONS
-bool isValidVerticalLink(int i)
-{
-    return  (i != 2) &&
-//            (i != (7 - 6)) && (i != 7) &&
-//            (i != (10 - 6)) && (i != 10) &&
-            (i != (17 - 6)) && (i != 17) &&
-//            (i != (18 - 6)) && (i != 18) &&
-//            (i != (20 - 6)) && (i != 20) &&
-            (i != (25 - 6)) && (i != 25)/*&&*/
-//            (i != (28 - 6)) && (i != 28) &&
-//            (i != 27)
-            ;
-}
-
-bool isValidHorizontalLink(int i)
-{
-    return  (i != (2 - 1)) && (i != 2) &&
-//            (i != (7 - 1)) && (i != 7) &&
-//            (i != (10 - 1)) && (i != 10) &&
-            (i != (17 - 1)) &&
-//            (i != 18) &&
-//            (i != (20 - 1)) && (i != 20) &&
-            (i != (25 - 1)) && (i != 25) /*&&*/
-//            (i != (28 - 1)) && (i != 28)
-            ;
+GraphPath::GraphPath()
+{
+    setMap(ArenaMap());
 }
 
-GraphPath::GraphPath()
+void GraphPath::setMap(const ArenaMap& map)
 {
-    // Populate the edges of our graph
-    // THIS FOR LOOP POPULATES ROWS 0 TO 4
-    for (int i = 0; i < 30; ++i)
+    _map = map;
+    _course = map;
+    _dstar.setMap(map);
+    _table.setMap(map);
+    _reach.setMap(map);
+    if (_search == SEARCH_TABLE)
     {
-        // Link the current tile and the tile above it
-        if (isValidVerticalLink(i))
-        {
-            add_edge(i, i + 6);
-        }
-
-        // For tiles not on the far right edge, we should connect them with their right hand neighbors
-        if ((i%6 != 5) && isValidHorizontalLink(i))
-        {
-            add_edge(i, i+1);
-        }
+        _table.build();
     }
 
-    // THIS FOR LOOP POPULATES ROW 5
-    for (int i = 30; i < 35; ++i)
+    int states = _map.tiles() * ARENA_HEADINGS;
+    _pred.resize(_map.tiles());
+    _dist.resize(_map.tiles());
+    _queue.resize(_map.tiles());
+    _state_cost.resize(states);
+    _state_pred.resize(states);
+    _state_closed.resize(states);
+    _path.resize(states);
+    _open.reserve(states * 3);
+}
+
+const ArenaMap& GraphPath::map() const
+{
+    return _map;
+}
+
+// Opens or closes the edge in our map and in D* Lite's, which repairs its search
+bool GraphPath::setEdge(int src, int dest, bool open)
+{
+    int heading = _map.headingBetween(src, dest);
+    if (heading < 0 || _map.isOpen(src, heading) == open)
     {
-        add_edge(i, i+1);
+        return false;
     }
+    _map.setOpen(src, heading, open);
+    _dstar.setEdge(src, heading, open);
+    _table.setEdge(src, heading, open);
+    _reach.setOpen(src, heading, open);
+    _reach.setOpen(dest, (heading + 2) % ARENA_HEADINGS, open);
+    return true;
 }
 
 // utility function to form edge between two vertices source and dest
 void GraphPath::add_edge(int src, int dest)
 {
-    adj[src].push_back(dest);
-    adj[dest].push_back(src);
+    setEdge(src, dest, true);
 }
 
 // utility function for removing an edge between two vertices source and dest
 bool GraphPath::remove_edge(int src, int dest)
 {
-    if (src > 35 || dest > 35 || src < 0 || dest < 0)
+    if (src >= _map.tiles() || dest >= _map.tiles() || src < 0 || dest < 0)
     {
         ROS_WARN("Attempting to remove an invalid edge. Bailing");
         return false;
     }
+    return setEdge(src, dest, false);
+}
 
-    auto srcItr = std::find(adj[src].begin(), adj[src].end(), dest);
-    auto destItr = std::find(adj[dest].begin(), adj[dest].end(), src);
-
-    if ( srcItr != adj[src].end() && destItr != adj[dest].end())
+bool GraphPath::restore_edge(int src, int dest)
+{
+    int heading = _course.headingBetween(src, dest);
+    if (heading < 0)
     {
-        adj[src].erase(srcItr);
-        adj[dest].erase(destItr);
-        return true;
+        ROS_WARN("Attempting to restore an invalid edge. Bailing");
+        return false;
     }
-    else
+    if (!_course.isOpen(src, heading))
     {
         return false;
     }
+    return setEdge(src, dest, true);
 }
 
-// a modified version of BFS that stores predecessor of each vertex in array p and its distance from source in array d
-bool GraphPath::BFS(int src, int dest, int v, int pred[], int dist[])
+void GraphPath::setSearch(PathSearch search)
 {
-    // a queue to maintain queue of vertices whose adjacency list is to be scanned as per normal DFS algorithm
-    list<int> queue;
+    _search = search;
+    if (_search == SEARCH_TABLE)
+    {
+        _table.build();
+    }
+}
 
-    // boolean array visited[] which stores the information whether ith vertex is reached at least once in the Breadth first search
-    bool visited[v];
+void GraphPath::setCosts(const PathCosts& costs)
+{
+    _costs = costs;
+    _dstar.setCosts(costs);
+    _table.setCosts(costs);
+    if (_search == SEARCH_TABLE)
+    {
+        _table.build();
+    }
+}
 
-    // initially all vertices are unvisited so v[i] for all i is false and as no path is yet constructed dist[i] for all i set to infinity
-    for (int i = 0; i < v; i++) {
-        visited[i] = false;
-        dist[i] = INT_MAX;
-        pred[i] = -1;
+// Breadth first search storing the predecessor and distance of each tile, fewest tiles wins
+bool GraphPath::BFS(int src, int dest)
+{
+    for (int i = 0; i < _map.tiles(); i++)
+    {
+        _dist[i] = INT_MAX;
+        _pred[i] = -1;
     }
 
-    // now source is first to be visited and distance from source to itself should be 0
-    visited[src] = true;
-    dist[src] = 0;
-    queue.push_back(src);
+    // Every tile is queued at most once, so the queue never wraps
+    int head = 0;
+    int tail = 0;
+    _dist[src] = 0;
+    _queue[tail++] = src;
 
-    // standard BFS algorithm
-    while (!queue.empty()) {
-        int u = queue.front();
-        queue.pop_front();
-        for (int i = 0; i < adj[u].size(); i++) {
-            if (visited[adj[u][i]] == false) {
-                visited[adj[u][i]] = true;
-                dist[adj[u][i]] = dist[u] + 1;
-                pred[adj[u][i]] = u;
-                queue.push_back(adj[u][i]);
+    while (head < tail)
+    {
+        int u = _queue[head++];
+        for (int h = 0; h < ARENA_HEADINGS; h++)
+        {
+            int v = _map.neighbour(u, h);
+            if (v >= 0 && _dist[v] == INT_MAX)
+            {
+                _dist[v] = _dist[u] + 1;
+                _pred[v] = u;
+                _queue[tail++] = v;
 
                 // We stop BFS when we find destination.
-                if (adj[u][i] == dest)
+                if (v == dest)
+                {
                     return true;
+                }
             }
         }
     }
@@ -129,73 +142,289 @@ bool GraphPath::BFS(int src, int dest, int v, int pred[], int dist[])
     return false;
 }
 
-// utility function to print the shortest distance between source vertex and destination vertex
-void GraphPath::getShortestPath(std::list<TilePosition> &drivePoints, TilePosition startTile, TilePosition targetTile, bool scanOnReach)
+// Straight line tiles plus one turn if the destination isn't dead ahead, which never overestimates
+float GraphPath::heuristic(int tile, int heading, int dest) const
 {
-    int s = (startTile.y * 6) + startTile.x;
-    int dest = (targetTile.y * 6) + targetTile.x;
-
-    int v = 36;
-    // predecessor[i] array stores predecessor of i and distance array stores distance of i from s
-    int pred[v], dist[v];
+    int dx = _map.tileX(dest) - _map.tileX(tile);
+    int dy = _map.tileY(dest) - _map.tileY(tile);
+    float cost = (abs(dx) + abs(dy)) * _costs.straight;
 
-    if (BFS(s, dest, v, pred, dist) == false)
+    bool ahead = (dy == 0 && ((dx > 0 && heading == 0) || (dx < 0 && heading == 2))) ||
+                 (dx == 0 && ((dy > 0 && heading == 1) || (dy < 0 && heading == 3)));
+    if ((dx != 0 || dy != 0) && !ahead)
     {
-        ROS_WARN("Given target and destination are not connected");
-        drivePoints.clear();
-        return;
+        cost += std::min(_costs.turn, _costs.reverse);
     }
+    return cost;
+}
 
-    // vector path stores the shortest path
-    vector<int> path;
-    int crawl = dest;
-    path.push_back(crawl);
-
-    while (pred[crawl] != -1)
+// A* over (tile, heading) states. Driving forward a tile and turning on the spot are separate moves, so paths with
+// fewer corners win over paths with fewer tiles when the turns cost more
+bool GraphPath::AStar(int src, int dest, int startHeading)
+{
+    const int states = _map.tiles() * ARENA_HEADINGS;
+    for (int i = 0; i < states; i++)
     {
-        path.push_back(pred[crawl]);
-        crawl = pred[crawl];
+        _state_cost[i] = std::numeric_limits<float>::infinity();
+        _state_pred[i] = -1;
+        _state_closed[i] = false;
     }
+    _open.clear();
+    _goal_state = -1;
 
-    // Second point in the list is the first new point we must travel to
-    // Check to see whether we will be driving in X or Y to start with
-    int firstX = path[path.size() - 2] % 6;
-    int firstY = (int)floor(path[path.size() - 2]/6);
-
-    bool prevXDelta = startTile.x != firstX;
-    bool prevYDelta = startTile.y != firstY;
+    std::greater<OpenEntry> later;
+    for (int h = 0; h < ARENA_HEADINGS; h++)
+    {
+        // With an unknown heading every direction is a free start
+        if (startHeading >= 0 && h != ((startHeading + 45) / 90) % ARENA_HEADINGS)
+        {
+            continue;
+        }
+        int state = src * ARENA_HEADINGS + h;
+        _state_cost[state] = 0;
+        OpenEntry entry = {heuristic(src, h, dest), state};
+        _open.push_back(entry);
+        std::push_heap(_open.begin(), _open.end(), later);
+    }
 
-    // printing path from source to destination
-    for (int i = path.size() - 1; i >= 0; i--)
+    while (!_open.empty())
     {
-        int pointY = (int)floor(path[i]/6);
-        int pointX = path[i] % 6;
+        std::pop_heap(_open.begin(), _open.end(), later);
+        int state = _open.back().state;
+        _open.pop_back();
+        if (_state_closed[state])
+        {
+            continue;
+        }
+        _state_closed[state] = true;
 
-        if (i != 0)
+        int tile = state / ARENA_HEADINGS;
+        int heading = state % ARENA_HEADINGS;
+        if (tile == dest)
         {
-            int nextY = (int)floor(path[i - 1]/6);
-            int nextX = path[i - 1] % 6;
+            _goal_state = state;
+            return true;
+        }
 
-            if ((nextX != pointX) && (prevYDelta))
+        int next[4];
+        float step[4];
+        int forward = _map.neighbour(tile, heading);
+        next[0] = forward < 0 ? -1 : forward * ARENA_HEADINGS + heading;
+        step[0] = _costs.straight;
+        next[1] = tile * ARENA_HEADINGS + (heading + 1) % ARENA_HEADINGS;
+        step[1] = _costs.turn;
+        next[2] = tile * ARENA_HEADINGS + (heading + 3) % ARENA_HEADINGS;
+        step[2] = _costs.turn;
+        next[3] = tile * ARENA_HEADINGS + (heading + 2) % ARENA_HEADINGS;
+        step[3] = _costs.reverse;
+
+        for (int i = 0; i < 4; i++)
+        {
+            if (next[i] < 0 || _state_closed[next[i]])
             {
-                prevXDelta = true;
-                prevYDelta = false;
-                ROS_INFO("Graph path will take point: %i, %i", pointX, pointY);
-                drivePoints.emplace_back(pointX, pointY);
+                continue;
             }
-
-            if ((nextY != pointY) && (prevXDelta))
+            float cost = _state_cost[state] + step[i];
+            if (cost < _state_cost[next[i]])
             {
-                prevXDelta = false;
-                prevYDelta = true;
-                ROS_INFO("Graph path will take point: %i, %i", pointX, pointY);
-                drivePoints.emplace_back(pointX, pointY);
+                _state_cost[next[i]] = cost;
+                _state_pred[next[i]] = state;
+                OpenEntry entry = {cost + heuristic(next[i] / ARENA_HEADINGS, next[i] % ARENA_HEADINGS, dest), next[i]};
+                _open.push_back(entry);
+                std::push_heap(_open.begin(), _open.end(), later);
             }
         }
-        else
+    }
+
+    return false;
+}
+
+// Turns a tile by tile path into drive points, one at each corner and one at the destination
+void GraphPath::appendLegs(std::list<TilePosition> &drivePoints, const int* path, int length, bool scanOnReach) const
+{
+    for (int i = 1; i < length; i++)
+    {
+        int pointX = _map.tileX(path[i]);
+        int pointY = _map.tileY(path[i]);
+        if (i == length - 1)
         {
             ROS_INFO("Graph path will take point: %i, %i", pointX, pointY);
             drivePoints.emplace_back(pointX, pointY, scanOnReach);
         }
+        else if (path[i] - path[i - 1] != path[i + 1] - path[i])
+        {
+            ROS_INFO("Graph path will take point: %i, %i", pointX, pointY);
+            drivePoints.emplace_back(pointX, pointY);
+        }
+    }
+}
+
+void GraphPath::getShortestPath(std::list<TilePosition> &drivePoints, TilePosition startTile, TilePosition targetTile,
+                                bool scanOnReach, int startHeading)
+{
+    if (!_map.contains(startTile.x, startTile.y) || !_map.contains(targetTile.x, targetTile.y))
+    {
+        ROS_WARN("Path requested from or to a tile off the course");
+        drivePoints.clear();
+        return;
+    }
+    int s = _map.index(startTile.x, startTile.y);
+    int dest = _map.index(targetTile.x, targetTile.y);
+
+    // A few word operations, saves searching every state before finding out there is no path
+    if (!_reach.reachable(s, dest))
+    {
+        ROS_WARN("Given target and destination are not connected");
+        drivePoints.clear();
+        return;
+    }
+
+    // Tiles from the destination back to the start
+    int* path = _path.data();
+    int length = 0;
+    if (_search == SEARCH_BFS)
+    {
+        if (!BFS(s, dest))
+        {
+            ROS_WARN("Given target and destination are not connected");
+            drivePoints.clear();
+            return;
+        }
+        for (int crawl = dest; crawl != -1; crawl = _pred[crawl])
+        {
+            path[length++] = crawl;
+        }
+    }
+    else if (_search == SEARCH_DSTAR)
+    {
+        // D* Lite needs a single start state, face up the course if the heading is unknown
+        int heading = startHeading >= 0 ? ((startHeading + 45) / 90) % ARENA_HEADINGS : 1;
+        length = _dstar.plan(s, heading, dest, path, (int)_path.size());
+        if (length == 0)
+        {
+            ROS_WARN("Given target and destination are not connected");
+            drivePoints.clear();
+            return;
+        }
+        ROS_INFO("Planned path takes about %.1f s, %i states expanded", _dstar.pathCost(), _dstar.expansions());
+
+        // Already in driving order
+        appendLegs(drivePoints, path, length, scanOnReach);
+        return;
+    }
+    else if (_search == SEARCH_TABLE)
+    {
+        int heading = startHeading >= 0 ? ((startHeading + 45) / 90) % ARENA_HEADINGS : -1;
+        if (_table.nextLeg(s, heading, dest) < 0)
+        {
+            ROS_WARN("Given target and destination are not connected");
+            drivePoints.clear();
+            return;
+        }
+        ROS_INFO("Planned path takes about %.1f s, %i table rows built", _table.cost(s, heading, dest),
+                 _table.rowsBuilt());
+
+        // Every leg is a lookup, the heading after it is the way it was driven
+        int tile = s;
+        for (int legs = 0; tile != dest && legs < _map.tiles(); legs++)
+        {
+            int legEnd = _table.nextLeg(tile, heading, dest);
+            int dx = _map.tileX(legEnd) - _map.tileX(tile);
+            int dy = _map.tileY(legEnd) - _map.tileY(tile);
+            heading = dx > 0 ? 0 : dx < 0 ? 2 : dy > 0 ? 1 : 3;
+            tile = legEnd;
+
+            ROS_INFO("Graph path will take point: %i, %i", _map.tileX(tile), _map.tileY(tile));
+            drivePoints.emplace_back(_map.tileX(tile), _map.tileY(tile), tile == dest && scanOnReach);
+        }
+        return;
+    }
+    else
+    {
+        if (!AStar(s, dest, startHeading))
+        {
+            ROS_WARN("Given target and destination are not connected");
+            drivePoints.clear();
+            return;
+        }
+        ROS_INFO("Planned path takes about %.1f s", _state_cost[_goal_state]);
+        for (int state = _goal_state; state != -1; state = _state_pred[state])
+        {
+            // Turning in place repeats the tile
+            int tile = state / ARENA_HEADINGS;
+            if (length == 0 || path[length - 1] != tile)
+            {
+                path[length++] = tile;
+            }
+        }
+    }
+
+    std::reverse(path, path + length);
+    appendLegs(drivePoints, path, length, scanOnReach);
+}
+
+TilePosition GraphPath::nextLeg(TilePosition start, TilePosition dest, int startHeading)
+{
+    if (!_map.contains(start.x, start.y) || !_map.contains(dest.x, dest.y))
+    {
+        return TilePosition(-1, -1);
+    }
+
+    int heading = startHeading >= 0 ? ((startHeading + 45) / 90) % ARENA_HEADINGS : -1;
+    int legEnd = _table.nextLeg(_map.index(start.x, start.y), heading, _map.index(dest.x, dest.y));
+    if (legEnd < 0)
+    {
+        return TilePosition(-1, -1);
+    }
+    return TilePosition(_map.tileX(legEnd), _map.tileY(legEnd));
+}
+
+float GraphPath::orderTour(TilePosition start, int startHeading, std::vector<TilePosition>& stops)
+{
+    if (!_map.contains(start.x, start.y))
+    {
+        stops.clear();
+        return 0;
+    }
+
+    std::vector<int> tiles;
+    for (size_t i = 0; i < stops.size(); i++)
+    {
+        if (_map.contains(stops[i].x, stops[i].y))
+        {
+            tiles.push_back(_map.index(stops[i].x, stops[i].y));
+        }
+    }
+    int heading = startHeading >= 0 ? ((startHeading + 45) / 90) % ARENA_HEADINGS : -1;
+    float seconds = _tour.order(_table, _map.index(start.x, start.y), heading, tiles);
+    if (tiles.size() < stops.size())
+    {
+        ROS_WARN("Dropped %i stops that are off the course or can't be reached", (int)(stops.size() - tiles.size()));
+    }
+
+    stops.clear();
+    for (size_t i = 0; i < tiles.size(); i++)
+    {
+        stops.emplace_back(_map.tileX(tiles[i]), _map.tileY(tiles[i]));
+    }
+    return seconds;
+}
+
+bool GraphPath::isReachable(TilePosition start, TilePosition dest)
+{
+    if (!_map.contains(start.x, start.y) || !_map.contains(dest.x, dest.y))
+    {
+        return false;
+    }
+    return _reach.reachable(_map.index(start.x, start.y), _map.index(dest.x, dest.y));
+}
+
+int GraphPath::distancesFrom(TilePosition start, std::vector<int>& dist)
+{
+    if (!_map.contains(start.x, start.y))
+    {
+        dist.assign(_map.tiles(), -1);
+        return 0;
     }
+    return _reach.distanceField(_map.index(start.x, start.y), dist);
 }
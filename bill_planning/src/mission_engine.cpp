@@ -0,0 +1,264 @@
+#include "bill_planning/mission_engine.hpp"
+#include "ros/callback_queue.h"
+#include <boost/make_shared.hpp>
+#include <math.h>
+#include <stdlib.h>
+
+// Degrees either side of the target a turn counts as reached, as the position callback uses
+static const float HEADING_BUFFER = 5.0;
+// Seconds to let a turn settle before it is stopped
+static const double TURN_SETTLE_TIME = 1.0;
+// Seconds a turn may take, including any restarts, before it fails
+static const double TURN_TIMEOUT = 8.0;
+// Seconds a drive may take, on top of the time allowed per tile of straight line distance
+static const double DRIVE_TIMEOUT = 10.0;
+static const double DRIVE_TIMEOUT_PER_TILE = 4.0;
+// Seconds between resumes when nothing signals, only delays depend on it
+static const double RECHECK_PERIOD = 0.1;
+
+bool MissionTask::finished(MissionTask& child)
+{
+    _child_status = child.resume();
+    return _child_status != TASK_RUNNING;
+}
+
+DriveTo::DriveTo(MissionContext& context, TilePosition tile, float speed)
+    : _context(context), _tile(tile), _speed(speed)
+{
+}
+
+TaskStatus DriveTo::resume()
+{
+    TilePosition current = _context.sensors.getCurrentTile();
+    bool onTile = current.x == _tile.x && current.y == _tile.y;
+
+    TASK_BEGIN();
+    if (onTile)
+    {
+        return TASK_DONE;
+    }
+    _deadline = ros::Time::now() + ros::Duration(DRIVE_TIMEOUT + DRIVE_TIMEOUT_PER_TILE *
+                                                 (abs(_tile.x - current.x) + abs(_tile.y - current.y)));
+    _context.planner.publishDriveToTile(_context.sensors, _tile.x, _tile.y, _speed);
+
+    // Stopped with nothing left to drive means the planner found no path or dropped it
+    TASK_AWAIT((!_context.planner.is_moving && (onTile || _context.planner.isDrivePointsEmpty())) ||
+               ros::Time::now() >= _deadline);
+    if (!onTile && ros::Time::now() >= _deadline)
+    {
+        ROS_WARN("Drive to %i, %i timed out on %i, %i", _tile.x, _tile.y, current.x, current.y);
+        cancel();
+        TASK_FAIL();
+    }
+    if (!onTile)
+    {
+        ROS_WARN("Drive to %i, %i stopped on %i, %i", _tile.x, _tile.y, current.x, current.y);
+        TASK_FAIL();
+    }
+    TASK_END();
+}
+
+void DriveTo::cancel()
+{
+    _context.planner.cancelDriveToTile(_context.sensors);
+}
+
+TurnTo::TurnTo(MissionContext& context, int heading) : _context(context), _heading(heading)
+{
+}
+
+TaskStatus TurnTo::resume()
+{
+    int error = _heading - _context.sensors.getCurrentHeading();
+
+    // Keep heading error centered at 0 between -180 and 180
+    if (error > 180)
+    {
+        error -= 360;
+    }
+    else if (error < -180)
+    {
+        error += 360;
+    }
+
+    TASK_BEGIN();
+    _deadline = ros::Time::now() + ros::Duration(TURN_TIMEOUT);
+    _context.planner.publishTurn(_heading);
+    while (fabs(error) >= HEADING_BUFFER)
+    {
+        TASK_AWAIT(fabs(error) < HEADING_BUFFER || !_context.planner.is_moving || ros::Time::now() >= _deadline);
+        if (fabs(error) < HEADING_BUFFER)
+        {
+            break;
+        }
+        if (ros::Time::now() >= _deadline)
+        {
+            ROS_WARN("Turn to %i timed out at %i", _heading, _context.sensors.getCurrentHeading());
+            cancel();
+            TASK_FAIL();
+        }
+        // Something else stopped the motors short of the heading
+        ROS_WARN("Turn to %i stopped at %i, turning again", _heading, _context.sensors.getCurrentHeading());
+        _context.planner.publishTurn(_heading);
+    }
+    _settled = ros::Time::now() + ros::Duration(TURN_SETTLE_TIME);
+    TASK_AWAIT(ros::Time::now() >= _settled);
+    _context.planner.publishStop();
+    TASK_END();
+}
+
+void TurnTo::cancel()
+{
+    _context.planner.publishStop();
+}
+
+Delay::Delay(double seconds) : _seconds(seconds)
+{
+}
+
+TaskStatus Delay::resume()
+{
+    TASK_BEGIN();
+    _end = ros::Time::now() + ros::Duration(_seconds);
+    TASK_AWAIT(ros::Time::now() >= _end);
+    TASK_END();
+}
+
+SensorEvent::SensorEvent(std::function<bool()> condition) : _condition(condition)
+{
+}
+
+TaskStatus SensorEvent::resume()
+{
+    return _condition() ? TASK_DONE : TASK_RUNNING;
+}
+
+Parallel::Parallel(Mode mode) : _mode(mode)
+{
+}
+
+Parallel& Parallel::add(MissionTask* task)
+{
+    _tasks.emplace_back(task);
+    _running.push_back(true);
+    return *this;
+}
+
+Parallel* Parallel::any(MissionTask* first, MissionTask* second)
+{
+    Parallel* parallel = new Parallel(WAIT_ANY);
+    parallel->add(first).add(second);
+    return parallel;
+}
+
+TaskStatus Parallel::resume()
+{
+    bool anyRunning = false;
+    bool anyFailed = false;
+    for (size_t i = 0; i < _tasks.size(); i++)
+    {
+        if (!_running[i])
+        {
+            continue;
+        }
+        TaskStatus status = _tasks[i]->resume();
+        if (status == TASK_RUNNING)
+        {
+            anyRunning = true;
+            continue;
+        }
+        _running[i] = false;
+        anyFailed = anyFailed || status == TASK_FAILED;
+
+        if (_mode == WAIT_ANY)
+        {
+            _winner = i;
+            cancel();
+            return status;
+        }
+    }
+
+    if (anyRunning)
+    {
+        return TASK_RUNNING;
+    }
+    return anyFailed ? TASK_FAILED : TASK_DONE;
+}
+
+void Parallel::cancel()
+{
+    for (size_t i = 0; i < _tasks.size(); i++)
+    {
+        if (_running[i])
+        {
+            _tasks[i]->cancel();
+            _running[i] = false;
+        }
+    }
+}
+
+int Parallel::winner() const
+{
+    return _winner;
+}
+
+class ResumeCallback : public ros::CallbackInterface
+{
+    public:
+        explicit ResumeCallback(MissionEngine* engine) : _engine(engine) {}
+
+        CallResult call()
+        {
+            _engine->poll();
+            return Success;
+        }
+
+    private:
+        MissionEngine* _engine;
+};
+
+void MissionEngine::start(MissionTask* mission, EventSignal& events)
+{
+    _mission.reset(mission);
+    events.setListener(std::bind(&MissionEngine::schedule, this));
+
+    ros::NodeHandle nh;
+    _timer = nh.createTimer(ros::Duration(RECHECK_PERIOD), &MissionEngine::timerCallback, this);
+    schedule();
+}
+
+void MissionEngine::schedule()
+{
+    if (!_scheduled.exchange(true))
+    {
+        ros::getGlobalCallbackQueue()->addCallback(boost::make_shared<ResumeCallback>(this));
+    }
+}
+
+void MissionEngine::poll()
+{
+    // Cleared first, a signal from anything this resume publishes queues the next one
+    _scheduled = false;
+    if (!_mission)
+    {
+        return;
+    }
+    TaskStatus status = _mission->resume();
+
+    if (status != TASK_RUNNING)
+    {
+        ROS_INFO("Mission %s", status == TASK_DONE ? "complete" : "failed");
+        _mission.reset();
+        _timer.stop();
+    }
+}
+
+bool MissionEngine::isRunning() const
+{
+    return static_cast<bool>(_mission);
+}
+
+void MissionEngine::timerCallback(const ros::TimerEvent& event)
+{
+    poll();
+}
@@ -0,0 +1,254 @@
+#include "bill_planning/path_table.hpp"
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+static const float INF = std::numeric_limits<float>::infinity();
+
+const uint16_t PathTable::NO_LEG;
+
+PathTable::PathTable()
+{
+    setMap(ArenaMap());
+}
+
+void PathTable::setMap(const ArenaMap& map)
+{
+    _map = map;
+    _states = _map.tiles() * ARENA_HEADINGS;
+    _rows_built = 0;
+    _cost.assign(_map.tiles() * _states, INF);
+    _leg_end.assign(_map.tiles() * _states, NO_LEG);
+    _stale.assign(_map.tiles(), true);
+    _order.reserve(_states);
+    _closed.resize(_states);
+    _forward.resize(_states);
+    _open.reserve(_states * 3);
+}
+
+void PathTable::setCosts(const PathCosts& costs)
+{
+    _costs = costs;
+    _stale.assign(_map.tiles(), true);
+}
+
+void PathTable::setEdge(int tile, int heading, bool open)
+{
+    int other = _map.adjacent(tile, heading);
+    if (other < 0 || _map.isOpen(tile, heading) == open)
+    {
+        return;
+    }
+    _map.setOpen(tile, heading, open);
+
+    // A new edge can shorten the path to any goal
+    if (open)
+    {
+        _stale.assign(_map.tiles(), true);
+        return;
+    }
+
+    // A closed edge only matters to the goals whose paths drove across it, in either direction
+    int state = tile * ARENA_HEADINGS + heading;
+    int back = other * ARENA_HEADINGS + (heading + 2) % ARENA_HEADINGS;
+    for (int goal = 0; goal < _map.tiles(); goal++)
+    {
+        if (!_stale[goal] && (drivesForward(goal, state) || drivesForward(goal, back)))
+        {
+            _stale[goal] = true;
+        }
+    }
+}
+
+void PathTable::build()
+{
+    for (int goal = 0; goal < _map.tiles(); goal++)
+    {
+        if (_stale[goal])
+        {
+            buildRow(goal);
+        }
+    }
+}
+
+// True if the first move from the state towards the goal is a drive forward, i.e. the leg runs along its heading
+bool PathTable::drivesForward(int goalTile, int state) const
+{
+    int tile = state / ARENA_HEADINGS;
+    int heading = state % ARENA_HEADINGS;
+    int legEnd = _leg_end[goalTile * _states + state];
+    if (tile == goalTile || legEnd == NO_LEG)
+    {
+        return false;
+    }
+
+    int dx = _map.tileX(legEnd) - _map.tileX(tile);
+    int dy = _map.tileY(legEnd) - _map.tileY(tile);
+    return (heading == 0 && dx > 0) || (heading == 1 && dy > 0) || (heading == 2 && dx < 0) || (heading == 3 && dy < 0);
+}
+
+// Dijkstra backwards from the goal gives the cost of every state, then the legs are filled in cheapest first so the
+// state each one leads to is always done before it
+void PathTable::buildRow(int goalTile)
+{
+    float* cost = &_cost[goalTile * _states];
+    uint16_t* legEnd = &_leg_end[goalTile * _states];
+    for (int i = 0; i < _states; i++)
+    {
+        cost[i] = INF;
+        legEnd[i] = NO_LEG;
+        _closed[i] = false;
+        _forward[i] = false;
+    }
+    _order.clear();
+    _open.clear();
+
+    std::greater<OpenEntry> later;
+    for (int h = 0; h < ARENA_HEADINGS; h++)
+    {
+        // Arriving in any heading reaches the goal
+        int state = goalTile * ARENA_HEADINGS + h;
+        cost[state] = 0;
+        OpenEntry entry = {0, state};
+        _open.push_back(entry);
+        std::push_heap(_open.begin(), _open.end(), later);
+    }
+
+    while (!_open.empty())
+    {
+        std::pop_heap(_open.begin(), _open.end(), later);
+        int state = _open.back().state;
+        _open.pop_back();
+        if (_closed[state])
+        {
+            continue;
+        }
+        _closed[state] = true;
+        _order.push_back(state);
+
+        int tile = state / ARENA_HEADINGS;
+        int heading = state % ARENA_HEADINGS;
+
+        // Turns are symmetric, only the forward move has to be looked up from the tile behind
+        int prev[4];
+        float step[4];
+        int behind = _map.neighbour(tile, (heading + 2) % ARENA_HEADINGS);
+        prev[0] = behind < 0 ? -1 : behind * ARENA_HEADINGS + heading;
+        step[0] = _costs.straight;
+        prev[1] = tile * ARENA_HEADINGS + (heading + 1) % ARENA_HEADINGS;
+        step[1] = _costs.turn;
+        prev[2] = tile * ARENA_HEADINGS + (heading + 3) % ARENA_HEADINGS;
+        step[2] = _costs.turn;
+        prev[3] = tile * ARENA_HEADINGS + (heading + 2) % ARENA_HEADINGS;
+        step[3] = _costs.reverse;
+
+        for (int i = 0; i < 4; i++)
+        {
+            if (prev[i] < 0 || _closed[prev[i]] || cost[state] + step[i] >= cost[prev[i]])
+            {
+                continue;
+            }
+            cost[prev[i]] = cost[state] + step[i];
+            OpenEntry entry = {cost[prev[i]], prev[i]};
+            _open.push_back(entry);
+            std::push_heap(_open.begin(), _open.end(), later);
+        }
+    }
+
+    for (size_t i = 0; i < _order.size(); i++)
+    {
+        int state = _order[i];
+        int tile = state / ARENA_HEADINGS;
+        int heading = state % ARENA_HEADINGS;
+        if (tile == goalTile)
+        {
+            legEnd[state] = goalTile;
+            continue;
+        }
+
+        // Driving on wins ties, so legs are as long as they can be
+        int forward = _map.neighbour(tile, heading);
+        if (forward >= 0 && cost[forward * ARENA_HEADINGS + heading] + _costs.straight == cost[state])
+        {
+            int next = forward * ARENA_HEADINGS + heading;
+            _forward[state] = true;
+            legEnd[state] = _forward[next] ? legEnd[next] : forward;
+            continue;
+        }
+
+        int turns[3] = {(heading + 1) % ARENA_HEADINGS, (heading + 3) % ARENA_HEADINGS, (heading + 2) % ARENA_HEADINGS};
+        float steps[3] = {_costs.turn, _costs.turn, _costs.reverse};
+        for (int t = 0; t < 3; t++)
+        {
+            int next = tile * ARENA_HEADINGS + turns[t];
+            if (cost[next] + steps[t] == cost[state])
+            {
+                legEnd[state] = legEnd[next];
+                break;
+            }
+        }
+    }
+
+    _stale[goalTile] = false;
+    _rows_built++;
+}
+
+int PathTable::bestState(int startTile, int startHeading, int goalTile)
+{
+    if (_stale[goalTile])
+    {
+        buildRow(goalTile);
+    }
+
+    const float* cost = &_cost[goalTile * _states];
+    if (startHeading >= 0)
+    {
+        return startTile * ARENA_HEADINGS + startHeading;
+    }
+    int best = startTile * ARENA_HEADINGS;
+    for (int h = 1; h < ARENA_HEADINGS; h++)
+    {
+        if (cost[startTile * ARENA_HEADINGS + h] < cost[best])
+        {
+            best = startTile * ARENA_HEADINGS + h;
+        }
+    }
+    return best;
+}
+
+int PathTable::nextLeg(int startTile, int startHeading, int goalTile)
+{
+    int legEnd = _leg_end[goalTile * _states + bestState(startTile, startHeading, goalTile)];
+    return legEnd == NO_LEG ? -1 : legEnd;
+}
+
+float PathTable::cost(int startTile, int startHeading, int goalTile)
+{
+    return _cost[goalTile * _states + bestState(startTile, startHeading, goalTile)];
+}
+
+int PathTable::arrivalHeading(int startTile, int startHeading, int goalTile)
+{
+    int state = bestState(startTile, startHeading, goalTile);
+    const uint16_t* legEnd = &_leg_end[goalTile * _states];
+    int tile = startTile;
+    int heading = state % ARENA_HEADINGS;
+    for (int legs = 0; tile != goalTile; legs++)
+    {
+        int end = legEnd[tile * ARENA_HEADINGS + heading];
+        if (end == NO_LEG || legs == _map.tiles())
+        {
+            return -1;
+        }
+        int dx = _map.tileX(end) - _map.tileX(tile);
+        int dy = _map.tileY(end) - _map.tileY(tile);
+        heading = dx > 0 ? 0 : dx < 0 ? 2 : dy > 0 ? 1 : 3;
+        tile = end;
+    }
+    return heading;
+}
+
+int PathTable::rowsBuilt() const
+{
+    return _rows_built;
+}
@@ -1,4 +1,5 @@
 #include "bill_planning/planner.hpp"
+#include "bill_drivers/trace.hpp"
 
 Planner::Planner()
 {
@@ -15,14 +16,47 @@ void Planner::setPubs(const ros::Publisher mp, const ros::Publisher fp, const ro
     {}
 }
 
+void Planner::setTraceId(uint64_t id)
+{
+    _trace_id.store(id);
+}
+
+void Planner::setMap(const ArenaMap& map)
+{
+    graphPath.setMap(map);
+}
+
+void Planner::setPathSearch(PathSearch search, const PathCosts& costs)
+{
+    // Costs first, so a table search is only built once
+    graphPath.setCosts(costs);
+    graphPath.setSearch(search);
+}
+
+void Planner::setActionListener(std::function<void()> listener)
+{
+    _action_listener = listener;
+}
+
+void Planner::actionStarted()
+{
+    if (_action_listener)
+    {
+        _action_listener();
+    }
+}
+
 void Planner::publishStop()
 {
     ROS_INFO("Commanding stop");
     _command_msg.command = bill_msgs::MotorCommands::STOP;
     _command_msg.heading = 0;
     _command_msg.speed = 0;
+    _command_msg.trace_id = _trace_id.load();
+    tracePublish("motor_cmd", _command_msg.trace_id);
     _motor_pub.publish(_command_msg);
     is_moving = false;
+    events.notify();
 }
 
 void Planner::publishDrive(const int heading, const float speed)
@@ -31,18 +65,25 @@ void Planner::publishDrive(const int heading, const float speed)
     _command_msg.command = bill_msgs::MotorCommands::DRIVE;
     _command_msg.heading = heading;
     _command_msg.speed =  speed < 0.3 ? speed : 0.3;
+    _command_msg.trace_id = _trace_id.load();
+    tracePublish("motor_cmd", _command_msg.trace_id);
     _motor_pub.publish(_command_msg);
     is_moving = true;
+    events.notify();
 }
 
 void Planner::publishTurn(const int heading)
 {
     ROS_INFO("Commanding turn, heading: %i", heading);
+    actionStarted();
     _command_msg.command = bill_msgs::MotorCommands::TURN;
     _command_msg.heading = heading;
     _command_msg.speed = 0;  // Speed is hardcoded in the motor driver for turning
+    _command_msg.trace_id = _trace_id.load();
+    tracePublish("motor_cmd", _command_msg.trace_id);
     _motor_pub.publish(_command_msg);
     is_moving = true;
+    events.notify();
 }
 
 void Planner::putOutFire()
@@ -50,28 +91,79 @@ void Planner::putOutFire()
     publishStop();
 
     // Turn ON/OFF Fan
+    {
+        std::lock_guard<std::mutex> lock(_timer_mutex);
+        std_msgs::Bool cmd;
+        cmd.data = true;
+        _fan_pub.publish(cmd);  // Turn on fan
+        _fan_on = true;
+    }
+    startTimer(_fan_timer, 5.0, &Planner::fanTimerCallback);
+    events.notify();
+}
+
+void Planner::signalComplete()
+{
+    publishStop();
+    {
+        std::lock_guard<std::mutex> lock(_timer_mutex);
+        std_msgs::Bool msg;
+        msg.data = true;
+        _led_pub.publish(msg);
+        _led_on = true;
+    }
+    startTimer(_led_timer, 2.0, &Planner::ledTimerCallback);
+    events.notify();
+}
+
+bool Planner::isFanOn()
+{
+    return _fan_on;
+}
+
+bool Planner::isSignalling()
+{
+    return _led_on;
+}
+
+void Planner::fanTimerCallback(const ros::TimerEvent& event)
+{
+    std::lock_guard<std::mutex> lock(_timer_mutex);
     std_msgs::Bool cmd;
-    cmd.data = true;
-    _fan_pub.publish(cmd);  // Turn on fan
-    ros::Duration(5).sleep();
     cmd.data = false;
     _fan_pub.publish(cmd);  // Turn off fan
+    _fan_on = false;
+    events.notify();
 }
 
-void Planner::signalComplete()
+void Planner::ledTimerCallback(const ros::TimerEvent& event)
 {
-    publishStop();
+    std::lock_guard<std::mutex> lock(_timer_mutex);
     std_msgs::Bool msg;
-    msg.data = true;
-    _led_pub.publish(msg);
-    ros::Duration(2).sleep();
     msg.data = false;
     _led_pub.publish(msg);
+    _led_on = false;
+    events.notify();
+}
+
+void Planner::startTimer(ros::Timer& timer, double seconds, void (Planner::*callback)(const ros::TimerEvent&))
+{
+    // A repeat request while the timer runs restarts it, so the fan or LED stays on for the full time
+    ros::Timer previous;
+    {
+        std::lock_guard<std::mutex> lock(_timer_mutex);
+        previous = timer;
+        ros::NodeHandle nh;
+        timer = nh.createTimer(ros::Duration(seconds), callback, this, true);
+    }
+    // Outside the lock, stop() waits for a callback that is running and the callbacks take the lock
+    previous.stop();
 }
 
 void Planner::publishDriveToTile(SensorReadings &sensorReadings, const int x, const int y, const float speed, bool scanOnReach)
 {
     ROS_INFO("Driving to tile: %i, %i", x, y);
+    actionStarted();
     int heading;
     int currentX = sensorReadings.getCurrentTileX();
     int currentY = sensorReadings.getCurrentTileY();
@@ -85,7 +177,7 @@ void Planner::publishDriveToTile(SensorReadings &sensorReadings, const int x, co
     ROS_INFO("Using Graph to determine shortest path, starting at %i, %i", currentX, currentY);
     TilePosition start(currentX, currentY);
     TilePosition dest(x, y);
-    graphPath.getShortestPath(drivePoints, start, dest, scanOnReach);
+    graphPath.getShortestPath(drivePoints, start, dest, scanOnReach, sensorReadings.getCurrentHeading());
 
     // If we successfully found a path
     // If the list returns empty, that means the path could not be generated.
@@ -118,8 +210,16 @@ void Planner::publishDriveToTile(SensorReadings &sensorReadings, const int x, co
     }
 }
 
+float Planner::orderTour(SensorReadings &sensorReadings, std::vector<TilePosition>& stops)
+{
+    return graphPath.orderTour(TilePosition(sensorReadings.getCurrentTileX(), sensorReadings.getCurrentTileY()),
+                               sensorReadings.getCurrentHeading(), stops);
+}
+
 void Planner::cancelDriveToTile(SensorReadings &sensorReadings)
 {
+    actionStarted();
+
     // Reset all data structures and targets
     sensorReadings.setTargetHeading(-1);
     sensorReadings.invalidateTargetTile();
@@ -131,7 +231,8 @@ void Planner::cancelDriveToTile(SensorReadings &sensorReadings)
 
 void Planner::driveAroundObstacle(SensorReadings &sensorReadings) {
     int currentHeading = sensorReadings.getCurrentHeading();
-    int obstacleIndex;
+    int obstacleX;
+    int obstacleY;
 
     int currentX = sensorReadings.getCurrentTileX();
     int currentY = sensorReadings.getCurrentTileY();
@@ -141,38 +242,31 @@ void Planner::driveAroundObstacle(SensorReadings &sensorReadings) {
     // Remove the edges around the obstacle
     // Facing 0
     if (currentHeading >= 0 && currentHeading < 90) {
-        int obstacleX = currentX + 1;
-        int obstacleY = currentY;
-
-        obstacleIndex = (obstacleY * 6) + obstacleX;
+        obstacleX = currentX + 1;
+        obstacleY = currentY;
     }
         // Facing 90
     else if (currentHeading >= 90 && currentHeading < 180) {
-        int obstacleX = currentX;
-        int obstacleY = currentY + 1;
-
-        obstacleIndex = (obstacleY * 6) + obstacleX;
+        obstacleX = currentX;
+        obstacleY = currentY + 1;
     }
         // Facing 180
     else if (currentHeading >= 180 && currentHeading < 270) {
-        int obstacleX = currentX - 1;
-        int obstacleY = currentY;
-
-        obstacleIndex = (obstacleY * 6) + obstacleX;
+        obstacleX = currentX - 1;
+        obstacleY = currentY;
     }
         // Facing 270
     else {
-        int obstacleX = currentX;
-        int obstacleY = currentY - 1;
-
-        obstacleIndex = (obstacleY * 6) + obstacleX;
+        obstacleX = currentX;
+        obstacleY = currentY - 1;
     }
 
     // Remove the 4 connecting edges to the obstacle node
-    graphPath.remove_edge(obstacleIndex, obstacleIndex + 1);
-    graphPath.remove_edge(obstacleIndex, obstacleIndex - 1);
-    graphPath.remove_edge(obstacleIndex, obstacleIndex + 6);
-    graphPath.remove_edge(obstacleIndex, obstacleIndex - 6);
+    const ArenaMap& map = graphPath.map();
+    if (map.contains(obstacleX, obstacleY))
+    {
+        setObstacleEdges(map.index(obstacleX, obstacleY), true);
+    }
 
     // Get the original target
     TilePosition originalTarget = drivePoints.back();
@@ -180,8 +274,10 @@ void Planner::driveAroundObstacle(SensorReadings &sensorReadings) {
     // Lets empty the list
     drivePoints.clear();
 
-    // Find a new path with the obstacle taken into account
-    graphPath.getShortestPath(drivePoints, TilePosition(currentX, currentY), originalTarget, originalTarget.scanOnReach);
+    // Find a new path with the obstacle taken into account. D* Lite only repairs the part of its last search that
+    // went through the removed edges
+    graphPath.getShortestPath(drivePoints, TilePosition(currentX, currentY), originalTarget, originalTarget.scanOnReach,
+                              currentHeading);
 
     if (!drivePoints.empty())
     {
@@ -211,6 +307,41 @@ void Planner::driveAroundObstacle(SensorReadings &sensorReadings) {
     }
 }
 
+void Planner::setObstacleEdges(int obstacleIndex, bool blocked)
+{
+    for (int h = 0; h < ARENA_HEADINGS; h++)
+    {
+        int neighbour = graphPath.map().adjacent(obstacleIndex, h);
+        if (neighbour < 0)
+        {
+            continue;
+        }
+        if (blocked)
+        {
+            graphPath.remove_edge(obstacleIndex, neighbour);
+        }
+        else
+        {
+            graphPath.restore_edge(obstacleIndex, neighbour);
+        }
+    }
+}
+
+void Planner::clearObstacle(int x, int y)
+{
+    if (!graphPath.map().contains(x, y))
+    {
+        return;
+    }
+    ROS_INFO("Obstacle at %i, %i cleared", x, y);
+    setObstacleEdges(graphPath.map().index(x, y), false);
+}
+
+int Planner::distancesFrom(int x, int y, std::vector<int>& dist)
+{
+    return graphPath.distancesFrom(TilePosition(x, y), dist);
+}
+
 void Planner::scanTimerCallback(const ros::TimerEvent& event)
 {
     setIsScanning(false);
@@ -270,8 +401,7 @@ void Planner::ProcessNextDrivePoint(SensorReadings &sensorReadings)
                 setIsScanning(true);
 
                 // Timeout for scan
-                ros::NodeHandle nh;
-                ros::Timer scanTimeout = nh.createTimer(ros::Duration(2), &Planner::scanTimerCallback, this);
+                startTimer(_scan_timer, 2.0, &Planner::scanTimerCallback);
 
                 // Scan at quarter driving speed
                 publishDrive(sensorReadings.getCurrentHeading(), 0.16);
@@ -295,8 +425,11 @@ bool Planner::isDrivePointsEmpty()
 
 void Planner::setIsScanning(bool val)
 {
-    std::lock_guard<std::mutex> guard(_is_scanning_mutex);    
-    _is_scanning = val;
+    {
+        std::lock_guard<std::mutex> guard(_is_scanning_mutex);
+        _is_scanning = val;
+    }
+    events.notify();
 }
 bool Planner::getIsScanning()
 {
@@ -5,6 +5,8 @@ SensorReadings::SensorReadings()
     //TODO PREPOPULATE QUEUE WITH POSSIBLE MAGNET POINTS
     _points_of_interest = std::queue<TilePosition>();
 
+    _world.store(_world_next);
+
     // Start targets as invalid
     _target_heading = -1;
     _current_target_tile = TilePosition(-1,-1);
@@ -26,84 +28,84 @@ bool SensorReadings::getStartRobotPerformanceThread()
 
 void SensorReadings::setUltraFwd(float val)
 {
-    std::lock_guard<std::mutex> guard(_ultra_fwd_mutex);
-    _ultra_fwd = val;
+    std::lock_guard<std::mutex> guard(_world_write_mutex);
+    _world_next.ultra_fwd = val;
+    _world.store(_world_next);
 }
 
 float SensorReadings::getUltraFwd()
 {
-    std::lock_guard<std::mutex> guard(_ultra_fwd_mutex);
-    return _ultra_fwd;
+    return _world.load().ultra_fwd;
 }
 
 void SensorReadings::setUltraLeft(float val)
 {
-    std::lock_guard<std::mutex> guard(_ultra_left_mutex);
-    _ultra_left = val;
+    std::lock_guard<std::mutex> guard(_world_write_mutex);
+    _world_next.ultra_left = val;
+    _world.store(_world_next);
 }
 
 float SensorReadings::getUltraLeft()
 {
-    std::lock_guard<std::mutex> guard(_ultra_left_mutex);
-    return  _ultra_left;
+    return _world.load().ultra_left;
 }
 
 void SensorReadings::setUltraRight(float val)
 {
-    std::lock_guard<std::mutex> guard(_ultra_right_mutex);
-    _ultra_right = val;
+    std::lock_guard<std::mutex> guard(_world_write_mutex);
+    _world_next.ultra_right = val;
+    _world.store(_world_next);
 }
 
 float SensorReadings::getUltraRight()
 {
-    std::lock_guard<std::mutex> guard(_ultra_right_mutex);
-    return _ultra_right;
+    return _world.load().ultra_right;
 }
 
 void SensorReadings::setDetectedFireFwd(bool val)
 {
-    std::lock_guard<std::mutex> guard(_detected_fire_mutex);
-    _detected_fire_fwd = val;
+    std::lock_guard<std::mutex> guard(_world_write_mutex);
+    _world_next.fire_fwd = val;
+    _world.store(_world_next);
 }
 
 bool SensorReadings::getDetectedFireFwd()
 {
-    std::lock_guard<std::mutex> guard(_detected_fire_mutex);
-    return  _detected_fire_fwd;
+    return _world.load().fire_fwd;
 }
 void SensorReadings::setDetectedFireLeft(bool val)
 {
-    std::lock_guard<std::mutex> guard(_detected_fire_mutex);
-    _detected_fire_left = val;
+    std::lock_guard<std::mutex> guard(_world_write_mutex);
+    _world_next.fire_left = val;
+    _world.store(_world_next);
 }
 
 bool SensorReadings::getDetectedFireLeft()
 {
-    std::lock_guard<std::mutex> guard(_detected_fire_mutex);
-    return  _detected_fire_left;
+    return _world.load().fire_left;
 }
 void SensorReadings::setDetectedFireRight(bool val)
 {
-    std::lock_guard<std::mutex> guard(_detected_fire_mutex);
-    _detected_fire_right = val;
+    std::lock_guard<std::mutex> guard(_world_write_mutex);
+    _world_next.fire_right = val;
+    _world.store(_world_next);
 }
 
 bool SensorReadings::getDetectedFireRight()
 {
-    std::lock_guard<std::mutex> guard(_detected_fire_mutex);
-    return  _detected_fire_right;
+    return _world.load().fire_right;
 }
 
 void SensorReadings::setCurrentHeading(int val)
 {
-    std::lock_guard<std::mutex> guard(_current_heading_mutex);
-    _current_heading = val;
+    std::lock_guard<std::mutex> guard(_world_write_mutex);
+    _world_next.heading = val;
+    _world.store(_world_next);
 }
 
 int SensorReadings::getCurrentHeading()
 {
-    std::lock_guard<std::mutex> guard(_current_heading_mutex);
-    return _current_heading;
+    return _world.load().heading;
 }
 
 void SensorReadings::setTargetHeading(int val)
@@ -120,26 +122,56 @@ int SensorReadings::getTargetHeading()
 
 void SensorReadings::setCurrentTileX(int val)
 {
-    std::lock_guard<std::mutex> guard(_current_tile_mutex);
-    _current_tile.x = val;
+    std::lock_guard<std::mutex> guard(_world_write_mutex);
+    _world_next.tile_x = val;
+    _world.store(_world_next);
 }
 
 void SensorReadings::setCurrentTileY(int val)
 {
-    std::lock_guard<std::mutex> guard(_current_tile_mutex);
-    _current_tile.y = val;
+    std::lock_guard<std::mutex> guard(_world_write_mutex);
+    _world_next.tile_y = val;
+    _world.store(_world_next);
 }
 
 int SensorReadings::getCurrentTileX()
 {
-    std::lock_guard<std::mutex> guard(_current_tile_mutex);
-    return _current_tile.x;
+    return _world.load().tile_x;
 }
 
 int SensorReadings::getCurrentTileY()
 {
-    std::lock_guard<std::mutex> guard(_current_tile_mutex);
-    return _current_tile.y;
+    return _world.load().tile_y;
+}
+
+void SensorReadings::setCurrentTile(int x, int y)
+{
+    std::lock_guard<std::mutex> guard(_world_write_mutex);
+    _world_next.tile_x = x;
+    _world_next.tile_y = y;
+    _world.store(_world_next);
+}
+
+TilePosition SensorReadings::getCurrentTile()
+{
+    WorldState world = _world.load();
+    return TilePosition(world.tile_x, world.tile_y);
+}
+
+void SensorReadings::setPose(int heading, float x, float y, int tile_x, int tile_y)
+{
+    std::lock_guard<std::mutex> guard(_world_write_mutex);
+    _world_next.heading = heading;
+    _world_next.x = x;
+    _world_next.y = y;
+    _world_next.tile_x = tile_x;
+    _world_next.tile_y = tile_y;
+    _world.store(_world_next);
+}
+
+WorldState SensorReadings::getWorldState()
+{
+    return _world.load();
 }
 
 void SensorReadings::setTargetPoint(int x, int y)
@@ -160,9 +192,18 @@ int SensorReadings::getTargetTileY()
     return _current_target_tile.y;
 }
 
+void SensorReadings::setArenaSize(int width, int height)
+{
+    std::lock_guard<std::mutex> guard(_target_tile_mutex);
+    _arena_width = width;
+    _arena_height = height;
+}
+
 bool SensorReadings::isTargetTileValid()
 {
-    return _current_target_tile.x >= 0 && _current_target_tile.x <= 5 && _current_target_tile.y >=0 && _current_target_tile.y <= 5;
+    std::lock_guard<std::mutex> guard(_target_tile_mutex);
+    return _current_target_tile.x >= 0 && _current_target_tile.x < _arena_width && _current_target_tile.y >= 0 &&
+           _current_target_tile.y < _arena_height;
 }
 
 void SensorReadings::invalidateTargetTile()
@@ -196,26 +237,26 @@ unsigned char SensorReadings::getDetectionBit()
 
 void SensorReadings::setCurrentPositionX(float val)
 {
-    std::lock_guard<std::mutex> guard(_current_position_mutex);
-    _current_position.x = val;
+    std::lock_guard<std::mutex> guard(_world_write_mutex);
+    _world_next.x = val;
+    _world.store(_world_next);
 }
 
 void SensorReadings::setCurrentPositionY(float val)
 {
-    std::lock_guard<std::mutex> guard(_current_position_mutex);
-    _current_position.y = val;
+    std::lock_guard<std::mutex> guard(_world_write_mutex);
+    _world_next.y = val;
+    _world.store(_world_next);
 }
 
 float SensorReadings::getCurrentPositionX()
 {
-    std::lock_guard<std::mutex> guard(_current_position_mutex);
-    return _current_position.x;
+    return _world.load().x;
 }
 
 float SensorReadings::getCurrentPositionY()
 {
-    std::lock_guard<std::mutex> guard(_current_position_mutex);
-    return _current_position.y;
+    return _world.load().y;
 }
 
 bool SensorReadings::pointsOfInterestEmpty()
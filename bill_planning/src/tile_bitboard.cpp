@@ -0,0 +1,221 @@
+#include "bill_planning/tile_bitboard.hpp"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+TileBitboard::TileBitboard()
+{
+    setMap(ArenaMap());
+}
+
+void TileBitboard::setMap(const ArenaMap& map)
+{
+    _width = map.width();
+    _tiles = map.tiles();
+    _words = (_tiles + 63) / 64;
+    for (int h = 0; h < ARENA_HEADINGS; h++)
+    {
+        _open[h].assign(_words, 0);
+    }
+    for (int tile = 0; tile < _tiles; tile++)
+    {
+        for (int h = 0; h < ARENA_HEADINGS; h++)
+        {
+            if (map.neighbour(tile, h) >= 0)
+            {
+                _open[h][tile >> 6] |= 1ULL << (tile & 63);
+            }
+        }
+    }
+
+    _frontier.assign(_words, 0);
+    _next.assign(_words, 0);
+    _shifted.assign(_words, 0);
+    _visited.assign(_words, 0);
+}
+
+// Callers keep both sides of an edge in step, as ArenaMap::setOpen does
+void TileBitboard::setOpen(int tile, int heading, bool open)
+{
+    if (open)
+    {
+        _open[heading][tile >> 6] |= 1ULL << (tile & 63);
+    }
+    else
+    {
+        _open[heading][tile >> 6] &= ~(1ULL << (tile & 63));
+    }
+}
+
+// Towards higher tile indices, i.e. +x by 1 or +y by a row
+void TileBitboard::shiftUp(const uint64_t* src, uint64_t* dst, int bits) const
+{
+    int words = bits >> 6;
+    int rest = bits & 63;
+    for (int w = _words - 1; w >= 0; w--)
+    {
+        uint64_t value = 0;
+        if (w - words >= 0)
+        {
+            value = src[w - words] << rest;
+            if (rest != 0 && w - words - 1 >= 0)
+            {
+                value |= src[w - words - 1] >> (64 - rest);
+            }
+        }
+        dst[w] = value;
+    }
+}
+
+void TileBitboard::shiftDown(const uint64_t* src, uint64_t* dst, int bits) const
+{
+    int words = bits >> 6;
+    int rest = bits & 63;
+    for (int w = 0; w < _words; w++)
+    {
+        uint64_t value = 0;
+        if (w + words < _words)
+        {
+            value = src[w + words] >> rest;
+            if (rest != 0 && w + words + 1 < _words)
+            {
+                value |= src[w + words + 1] << (64 - rest);
+            }
+        }
+        dst[w] = value;
+    }
+}
+
+// Only tiles with an open side towards a heading are moved that way, so nothing wraps around a row or off the grid
+void TileBitboard::expand()
+{
+    for (int w = 0; w < _words; w++)
+    {
+        _next[w] = 0;
+    }
+    const int step[ARENA_HEADINGS] = {1, _width, 1, _width};
+    for (int h = 0; h < ARENA_HEADINGS; h++)
+    {
+        for (int w = 0; w < _words; w++)
+        {
+            _shifted[w] = _frontier[w] & _open[h][w];
+        }
+        if (h == 0 || h == 1)
+        {
+            shiftUp(_shifted.data(), _shifted.data(), step[h]);
+        }
+        else
+        {
+            shiftDown(_shifted.data(), _shifted.data(), step[h]);
+        }
+        for (int w = 0; w < _words; w++)
+        {
+            _next[w] |= _shifted[w];
+        }
+    }
+}
+
+bool TileBitboard::mergeFrontier()
+{
+    uint64_t any = 0;
+    int w = 0;
+#if defined(__SSE2__)
+    __m128i anyWide = _mm_setzero_si128();
+    for (; w + 2 <= _words; w += 2)
+    {
+        __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&_next[w]));
+        __m128i visited = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&_visited[w]));
+        next = _mm_andnot_si128(visited, next);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&_next[w]), next);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&_visited[w]), _mm_or_si128(visited, next));
+        anyWide = _mm_or_si128(anyWide, next);
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), anyWide);
+    any = lanes[0] | lanes[1];
+#elif defined(__ARM_NEON)
+    uint64x2_t anyWide = vdupq_n_u64(0);
+    for (; w + 2 <= _words; w += 2)
+    {
+        uint64x2_t next = vld1q_u64(&_next[w]);
+        uint64x2_t visited = vld1q_u64(&_visited[w]);
+        next = vbicq_u64(next, visited);
+        vst1q_u64(&_next[w], next);
+        vst1q_u64(&_visited[w], vorrq_u64(visited, next));
+        anyWide = vorrq_u64(anyWide, next);
+    }
+    any = vgetq_lane_u64(anyWide, 0) | vgetq_lane_u64(anyWide, 1);
+#endif
+    for (; w < _words; w++)
+    {
+        _next[w] &= ~_visited[w];
+        _visited[w] |= _next[w];
+        any |= _next[w];
+    }
+    return any != 0;
+}
+
+bool TileBitboard::reachable(int src, int dest)
+{
+    if (src < 0 || src >= _tiles || dest < 0 || dest >= _tiles)
+    {
+        return false;
+    }
+    for (int w = 0; w < _words; w++)
+    {
+        _frontier[w] = 0;
+        _visited[w] = 0;
+    }
+    _frontier[src >> 6] = 1ULL << (src & 63);
+    _visited[src >> 6] = _frontier[src >> 6];
+
+    uint64_t destBit = 1ULL << (dest & 63);
+    while ((_visited[dest >> 6] & destBit) == 0)
+    {
+        expand();
+        if (!mergeFrontier())
+        {
+            return false;
+        }
+        _frontier.swap(_next);
+    }
+    return true;
+}
+
+int TileBitboard::distanceField(int src, std::vector<int>& dist)
+{
+    dist.assign(_tiles, -1);
+    if (src < 0 || src >= _tiles)
+    {
+        return 0;
+    }
+    for (int w = 0; w < _words; w++)
+    {
+        _frontier[w] = 0;
+        _visited[w] = 0;
+    }
+    _frontier[src >> 6] = 1ULL << (src & 63);
+    _visited[src >> 6] = _frontier[src >> 6];
+
+    int reached = 0;
+    for (int d = 0; ; d++)
+    {
+        // Every tile in the wavefront is d tiles away
+        for (int w = 0; w < _words; w++)
+        {
+            for (uint64_t bits = _frontier[w]; bits != 0; bits &= bits - 1)
+            {
+                dist[(w << 6) + __builtin_ctzll(bits)] = d;
+                reached++;
+            }
+        }
+        expand();
+        if (!mergeFrontier())
+        {
+            return reached;
+        }
+        _frontier.swap(_next);
+    }
+}
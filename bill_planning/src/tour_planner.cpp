@@ -0,0 +1,269 @@
+#include "bill_planning/tour_planner.hpp"
+#include <algorithm>
+#include <limits>
+
+static const float INF = std::numeric_limits<float>::infinity();
+
+const int TourPlanner::EXACT_STOPS;
+
+float TourPlanner::order(PathTable& table, int startTile, int startHeading, std::vector<int>& stops)
+{
+    // The course is undirected, so a stop that can't be reached from the start can't be reached from anywhere
+    std::vector<int> reachable;
+    for (size_t i = 0; i < stops.size(); i++)
+    {
+        if (stops[i] == startTile || table.cost(startTile, -1, stops[i]) != INF)
+        {
+            reachable.push_back(stops[i]);
+        }
+    }
+    stops.swap(reachable);
+    fillCosts(table, startTile, startHeading, stops);
+    if (stops.empty())
+    {
+        return 0;
+    }
+
+    std::vector<int> tour;
+    float cost = _stops <= EXACT_STOPS ? exact(tour) : improve(tour);
+
+    std::vector<int> ordered(_stops);
+    for (int i = 0; i < _stops; i++)
+    {
+        ordered[i] = stops[tour[i]];
+    }
+    stops.swap(ordered);
+    return cost;
+}
+
+void TourPlanner::fillCosts(PathTable& table, int startTile, int startHeading, const std::vector<int>& stops)
+{
+    _stops = stops.size();
+    _start_heading = startHeading;
+    _cost.assign((_stops + 1) * ARENA_HEADINGS * _stops, INF);
+    _arrival.assign((_stops + 1) * ARENA_HEADINGS * _stops, -1);
+
+    for (int from = 0; from <= _stops; from++)
+    {
+        int fromTile = from == 0 ? startTile : stops[from - 1];
+        for (int h = 0; h < ARENA_HEADINGS; h++)
+        {
+            for (int to = 0; to < _stops; to++)
+            {
+                int index = (from * ARENA_HEADINGS + h) * _stops + to;
+                if (fromTile == stops[to])
+                {
+                    _cost[index] = 0;
+                    _arrival[index] = h;
+                }
+                else
+                {
+                    _cost[index] = table.cost(fromTile, h, stops[to]);
+                    _arrival[index] = table.arrivalHeading(fromTile, h, stops[to]);
+                }
+            }
+        }
+    }
+}
+
+float TourPlanner::hopCost(int from, int heading, int to) const
+{
+    return _cost[(from * ARENA_HEADINGS + heading) * _stops + to];
+}
+
+int TourPlanner::hopHeading(int from, int heading, int to) const
+{
+    return _arrival[(from * ARENA_HEADINGS + heading) * _stops + to];
+}
+
+// Stops in visiting order, with an unknown start heading the best one is taken
+float TourPlanner::tourCost(const std::vector<int>& tour) const
+{
+    float best = INF;
+    for (int startHeading = 0; startHeading < ARENA_HEADINGS; startHeading++)
+    {
+        if (_start_heading >= 0 && startHeading != _start_heading)
+        {
+            continue;
+        }
+        float cost = 0;
+        int node = 0;
+        int heading = startHeading;
+        for (size_t i = 0; i < tour.size() && cost < best; i++)
+        {
+            cost += hopCost(node, heading, tour[i]);
+            heading = hopHeading(node, heading, tour[i]);
+            node = tour[i] + 1;
+        }
+        best = std::min(best, cost);
+    }
+    return best;
+}
+
+// Held-Karp over (visited set, last stop, heading arrived in). 2^n * n * 4 states, fine up to EXACT_STOPS
+float TourPlanner::exact(std::vector<int>& tour)
+{
+    const int sets = 1 << _stops;
+    const int width = _stops * ARENA_HEADINGS;
+    std::vector<float> best(sets * width, INF);
+    std::vector<int> parent(sets * width, -1);
+
+    for (int startHeading = 0; startHeading < ARENA_HEADINGS; startHeading++)
+    {
+        if (_start_heading >= 0 && startHeading != _start_heading)
+        {
+            continue;
+        }
+        for (int to = 0; to < _stops; to++)
+        {
+            float cost = hopCost(0, startHeading, to);
+            int state = (1 << to) * width + to * ARENA_HEADINGS + hopHeading(0, startHeading, to);
+            if (cost < best[state])
+            {
+                best[state] = cost;
+            }
+        }
+    }
+
+    for (int set = 1; set < sets; set++)
+    {
+        for (int last = 0; last < _stops; last++)
+        {
+            if ((set & (1 << last)) == 0)
+            {
+                continue;
+            }
+            for (int h = 0; h < ARENA_HEADINGS; h++)
+            {
+                int state = set * width + last * ARENA_HEADINGS + h;
+                if (best[state] == INF)
+                {
+                    continue;
+                }
+                for (int to = 0; to < _stops; to++)
+                {
+                    if ((set & (1 << to)) != 0)
+                    {
+                        continue;
+                    }
+                    float cost = best[state] + hopCost(last + 1, h, to);
+                    int next = (set | (1 << to)) * width + to * ARENA_HEADINGS + hopHeading(last + 1, h, to);
+                    if (cost < best[next])
+                    {
+                        best[next] = cost;
+                        parent[next] = last * ARENA_HEADINGS + h;
+                    }
+                }
+            }
+        }
+    }
+
+    int full = sets - 1;
+    int end = -1;
+    for (int i = 0; i < width; i++)
+    {
+        if (end < 0 || best[full * width + i] < best[full * width + end])
+        {
+            end = i;
+        }
+    }
+
+    float total = best[full * width + end];
+
+    // Walk the parents back from the last stop
+    tour.assign(_stops, 0);
+    int set = full;
+    for (int i = _stops - 1; i >= 0; i--)
+    {
+        tour[i] = end / ARENA_HEADINGS;
+        int previous = parent[set * width + end];
+        set &= ~(1 << tour[i]);
+        end = previous;
+    }
+    return total;
+}
+
+// Nearest stop first, then 2-opt reversals and Or-opt moves of up to three stops, keeping any that lower the cost
+float TourPlanner::improve(std::vector<int>& tour)
+{
+    std::vector<bool> visited(_stops, false);
+    tour.clear();
+    int node = 0;
+    int heading = _start_heading;
+    for (int i = 0; i < _stops; i++)
+    {
+        int nearest = -1;
+        int nearestHeading = 0;
+        float nearestCost = INF;
+        for (int to = 0; to < _stops; to++)
+        {
+            for (int h = 0; h < ARENA_HEADINGS && !visited[to]; h++)
+            {
+                if (heading >= 0 && h != heading)
+                {
+                    continue;
+                }
+                if (nearest < 0 || hopCost(node, h, to) < nearestCost)
+                {
+                    nearest = to;
+                    nearestCost = hopCost(node, h, to);
+                    nearestHeading = hopHeading(node, h, to);
+                }
+            }
+        }
+        visited[nearest] = true;
+        tour.push_back(nearest);
+        node = nearest + 1;
+        heading = nearestHeading;
+    }
+
+    float cost = tourCost(tour);
+    bool improved = true;
+    while (improved)
+    {
+        improved = false;
+        for (int i = 0; i < _stops - 1; i++)
+        {
+            for (int j = i + 1; j < _stops; j++)
+            {
+                std::reverse(tour.begin() + i, tour.begin() + j + 1);
+                float candidate = tourCost(tour);
+                if (candidate < cost - 1e-3)
+                {
+                    cost = candidate;
+                    improved = true;
+                }
+                else
+                {
+                    std::reverse(tour.begin() + i, tour.begin() + j + 1);
+                }
+            }
+        }
+
+        for (int length = 1; length <= 3; length++)
+        {
+            for (int i = 0; i + length <= _stops; i++)
+            {
+                for (int to = 0; to + length <= _stops; to++)
+                {
+                    if (to == i)
+                    {
+                        continue;
+                    }
+                    std::vector<int> candidate(tour);
+                    std::vector<int> segment(candidate.begin() + i, candidate.begin() + i + length);
+                    candidate.erase(candidate.begin() + i, candidate.begin() + i + length);
+                    candidate.insert(candidate.begin() + to, segment.begin(), segment.end());
+                    float candidateCost = tourCost(candidate);
+                    if (candidateCost < cost - 1e-3)
+                    {
+                        tour.swap(candidate);
+                        cost = candidateCost;
+                        improved = true;
+                    }
+                }
+            }
+        }
+    }
+    return cost;
+}
@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <limits>
+#include <random>
+#include "bill_planning/tour_planner.hpp"
+
+static const float INF = std::numeric_limits<float>::infinity();
+
+// The 6x6 competition course, see config/arena_6x6.yaml
+static ArenaMap competitionCourse()
+{
+    ArenaMap map(6, 6, 0.3);
+    map.blockTile(map.index(2, 0));
+    map.blockTile(map.index(5, 2));
+    map.blockTile(map.index(1, 4));
+    return map;
+}
+
+// Seconds to drive the stops in this order, costed the same way as TourPlanner
+static float tourCost(PathTable& table, int startTile, int startHeading, const std::vector<int>& stops)
+{
+    float best = INF;
+    for (int h = 0; h < ARENA_HEADINGS; h++)
+    {
+        if (startHeading >= 0 && h != startHeading)
+        {
+            continue;
+        }
+        float cost = 0;
+        int tile = startTile;
+        int heading = h;
+        for (size_t i = 0; i < stops.size(); i++)
+        {
+            if (tile != stops[i])
+            {
+                cost += table.cost(tile, heading, stops[i]);
+                heading = table.arrivalHeading(tile, heading, stops[i]);
+            }
+            tile = stops[i];
+        }
+        best = std::min(best, cost);
+    }
+    return best;
+}
+
+static float bruteForce(PathTable& table, int startTile, int startHeading, std::vector<int> stops)
+{
+    std::sort(stops.begin(), stops.end());
+    float best = INF;
+    do
+    {
+        best = std::min(best, tourCost(table, startTile, startHeading, stops));
+    } while (std::next_permutation(stops.begin(), stops.end()));
+    return best;
+}
+
+class TourPlannerTest : public ::testing::Test
+{
+protected:
+    void SetUp()
+    {
+        _map = competitionCourse();
+        _table.setMap(_map);
+        _table.setCosts(PathCosts());
+        _table.build();
+        for (int tile = 0; tile < _map.tiles(); tile++)
+        {
+            if (_map.openSides(tile) != 0)
+            {
+                _open_tiles.push_back(tile);
+            }
+        }
+    }
+
+    ArenaMap _map;
+    PathTable _table;
+    TourPlanner _tour;
+    std::vector<int> _open_tiles;
+};
+
+TEST_F(TourPlannerTest, ExactOrderMatchesBruteForce)
+{
+    std::mt19937 random(42);
+    for (int count = 3; count <= 8; count++)
+    {
+        for (int trial = 0; trial < 5; trial++)
+        {
+            std::vector<int> tiles(_open_tiles);
+            std::shuffle(tiles.begin(), tiles.end(), random);
+            int start = tiles[0];
+            int heading = trial % 2 == 0 ? -1 : (int)(random() % ARENA_HEADINGS);
+            std::vector<int> stops(tiles.begin() + 1, tiles.begin() + 1 + count);
+
+            std::vector<int> ordered(stops);
+            float cost = _tour.order(_table, start, heading, ordered);
+
+            ASSERT_EQ(stops.size(), ordered.size());
+            EXPECT_TRUE(std::is_permutation(stops.begin(), stops.end(), ordered.begin()));
+            EXPECT_NEAR(bruteForce(_table, start, heading, stops), cost, 1e-3)
+                << count << " stops from tile " << start << " heading " << heading;
+            EXPECT_NEAR(tourCost(_table, start, heading, ordered), cost, 1e-3);
+        }
+    }
+}
+
+TEST_F(TourPlannerTest, LargeToursVisitEveryStop)
+{
+    std::mt19937 random(7);
+    std::vector<int> tiles(_open_tiles);
+    std::shuffle(tiles.begin(), tiles.end(), random);
+    std::vector<int> stops(tiles.begin() + 1, tiles.begin() + 1 + TourPlanner::EXACT_STOPS + 4);
+
+    std::vector<int> ordered(stops);
+    float cost = _tour.order(_table, tiles[0], 1, ordered);
+
+    ASSERT_EQ(stops.size(), ordered.size());
+    EXPECT_TRUE(std::is_permutation(stops.begin(), stops.end(), ordered.begin()));
+    EXPECT_NEAR(tourCost(_table, tiles[0], 1, ordered), cost, 1e-3);
+    EXPECT_LE(cost, tourCost(_table, tiles[0], 1, stops) + 1e-3);
+}
+
+TEST_F(TourPlannerTest, DropsUnreachableStops)
+{
+    std::vector<int> stops;
+    stops.push_back(_map.index(5, 5));
+    stops.push_back(_map.index(2, 0));  // Blocked
+    stops.push_back(_map.index(3, 3));
+
+    float cost = _tour.order(_table, _map.index(0, 0), -1, stops);
+
+    ASSERT_EQ(2u, stops.size());
+    EXPECT_EQ(stops.end(), std::find(stops.begin(), stops.end(), _map.index(2, 0)));
+    EXPECT_NEAR(tourCost(_table, _map.index(0, 0), -1, stops), cost, 1e-3);
+}
+
+int main(int argc, char** argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}